@@ -0,0 +1,209 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  ------------------------
+//  DepthBuffer.cpp
+//  ------------------------
+//
+//  A depth buffer holding 16 or 24 bit fixed point, or 32 bit float,
+//  depths.  Every format is kept in one 32 bit word per pixel, chosen
+//  so that nearer is always the smaller unsigned number - so the depth
+//  test is the same integer compare whatever the format.
+//
+//  The pixels are stored in square blocks of DEPTH_BLOCK_SIZE rows &
+//  columns rather than in rows, so the depths of one of the
+//  rasteriser's blocks are contiguous & can be tested together.
+//
+//  On top of the pixels sits a two level Hi-Z pyramid: the furthest
+//  depth of each block, and of each tile of DEPTH_TILE_BLOCKS square
+//  blocks.  These are never nearer than the pixels below them, so
+//  anything behind them is certainly hidden.  They are only kept up to
+//  date while depths get nearer (LESS & LEQUAL) - anything else marks
+//  them invalid until the next clear.
+//
+//  Clearing only sets the pyramid & marks every tile as waiting for the
+//  clear: the pixels of a tile are filled in by ResolveClear() when
+//  something is first drawn there, so tiles nothing is drawn in are
+//  never written.
+//
+///////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+
+#include "DepthBuffer.h"
+
+// the same limit as RGBAImage
+#define MAX_DEPTH_DIMENSION 4096
+
+// constructor - starts empty & 24 bit
+DepthBuffer::DepthBuffer()
+    :
+    block(NULL),
+    width(0),
+    height(0),
+    blockColumns(0),
+    blockRows(0),
+    format(DEPTH_FORMAT_24),
+    tileColumns(0),
+    tileRows(0),
+    hiZValid(true),
+    clearValue(0)
+    { // constructor
+    } // constructor
+
+// destructor
+DepthBuffer::~DepthBuffer()
+    { // destructor
+    free(block);
+    } // destructor
+
+// resizes the buffer, destroying any contents
+bool DepthBuffer::Resize(long Width, long Height)
+    { // Resize()
+    // check validity of dimensions
+    if ((Width < 0) || (Width > MAX_DEPTH_DIMENSION) || (Height < 0) || (Height > MAX_DEPTH_DIMENSION))
+        { // failure
+        std::cout << "Cannot handle depth buffer of size " << Width << " x " << Height << std::endl;
+        return false;
+        } // failure
+
+    free(block);
+    block = NULL;
+
+    blockColumns = (Width + DEPTH_BLOCK_SIZE - 1) / DEPTH_BLOCK_SIZE;
+    blockRows = (Height + DEPTH_BLOCK_SIZE - 1) / DEPTH_BLOCK_SIZE;
+    tileColumns = (blockColumns + DEPTH_TILE_BLOCKS - 1) / DEPTH_TILE_BLOCKS;
+    tileRows = (blockRows + DEPTH_TILE_BLOCKS - 1) / DEPTH_TILE_BLOCKS;
+    width = Width;
+    height = Height;
+    blockMax.resize(blockColumns * blockRows);
+    tileMax.resize(tileColumns * tileRows);
+    tileDirty.resize(tileColumns * tileRows);
+    tileClearPending.resize(tileColumns * tileRows);
+
+    // whole blocks, so the last ones can be tested like any other
+    size_t nPixels = (size_t) blockColumns * blockRows * DEPTH_BLOCK_PIXELS;
+    if (nPixels > 0)
+        { // allocate
+        block = (uint32_t *) malloc(nPixels * sizeof(uint32_t));
+        if (block == NULL)
+            { // out of memory
+            width = height = blockColumns = blockRows = tileColumns = tileRows = 0;
+            blockMax.clear();
+            tileMax.clear();
+            tileDirty.clear();
+            tileClearPending.clear();
+            return false;
+            } // out of memory
+        } // allocate
+
+    // a new buffer starts out at the far plane
+    Clear(Far());
+    return true;
+    } // Resize()
+
+// changes the format, destroying any contents
+void DepthBuffer::SetFormat(unsigned int newFormat)
+    { // SetFormat()
+    if (newFormat != DEPTH_FORMAT_16 && newFormat != DEPTH_FORMAT_24 && newFormat != DEPTH_FORMAT_32F)
+        return;
+    format = newFormat;
+    Clear(Far());
+    } // SetFormat()
+
+// sets every pixel to a stored depth - which only marks the tiles as waiting for it
+void DepthBuffer::Clear(uint32_t value)
+    { // Clear()
+    // the pixels are left until each tile is drawn in
+    clearValue = value;
+    std::fill(tileClearPending.begin(), tileClearPending.end(), 1);
+
+    // but the pyramid is exact straight away, so Hi-Z tests see the cleared depths
+    std::fill(blockMax.begin(), blockMax.end(), value);
+    std::fill(tileMax.begin(), tileMax.end(), value);
+    std::fill(tileDirty.begin(), tileDirty.end(), 0);
+    hiZValid = true;
+    } // Clear()
+
+// sets the pixels of a tile to clearValue
+void DepthBuffer::FillTile(long tileRow, long tileCol)
+    { // FillTile()
+    // each row of blocks in the tile is one straight run over the memory
+    long lastBlockRow = std::min(blockRows, (tileRow + 1) * DEPTH_TILE_BLOCKS);
+    long firstBlockCol = tileCol * DEPTH_TILE_BLOCKS;
+    long nBlocks = std::min(blockColumns, firstBlockCol + DEPTH_TILE_BLOCKS) - firstBlockCol;
+    for (long blockRow = tileRow * DEPTH_TILE_BLOCKS; blockRow < lastBlockRow; blockRow++)
+        std::fill_n(block + (size_t) (blockRow * blockColumns + firstBlockCol) * DEPTH_BLOCK_PIXELS, nBlocks * DEPTH_BLOCK_PIXELS, clearValue);
+    tileClearPending[tileRow * tileColumns + tileCol] = 0;
+    } // FillTile()
+
+// fills in every clear still waiting
+void DepthBuffer::ResolveClears()
+    { // ResolveClears()
+    if (std::all_of(tileClearPending.begin(), tileClearPending.end(), [](char pending) { return pending != 0; }))
+        { // whole buffer
+        // one straight run over the memory, which the compiler turns into wide stores
+        std::fill_n(block, (size_t) blockColumns * blockRows * DEPTH_BLOCK_PIXELS, clearValue);
+        std::fill(tileClearPending.begin(), tileClearPending.end(), 0);
+        return;
+        } // whole buffer
+
+    for (long tileRow = 0; tileRow < tileRows; tileRow++)
+        for (long tileCol = 0; tileCol < tileColumns; tileCol++)
+            ResolveClear(tileRow, tileCol);
+    } // ResolveClears()
+
+// works out the furthest depth of a block again from its pixels
+void DepthBuffer::UpdateBlockMax(long blockRow, long blockCol)
+    { // UpdateBlockMax()
+    const uint32_t *depths = block + (size_t) (blockRow * blockColumns + blockCol) * DEPTH_BLOCK_PIXELS;
+    // blocks on the right & bottom edges hang over the buffer, and their spare pixels are never drawn
+    int nRows = (int) std::min<long>(DEPTH_BLOCK_SIZE, height - blockRow * DEPTH_BLOCK_SIZE);
+    int nCols = (int) std::min<long>(DEPTH_BLOCK_SIZE, width - blockCol * DEPTH_BLOCK_SIZE);
+
+    uint32_t furthest = 0;
+    if (nCols == DEPTH_BLOCK_SIZE && nRows == DEPTH_BLOCK_SIZE)
+        { // whole block
+        // a plain loop over contiguous memory, which vectorises
+        for (int pixel = 0; pixel < DEPTH_BLOCK_PIXELS; pixel++)
+            furthest = std::max(furthest, depths[pixel]);
+        } // whole block
+    else
+        { // edge block
+        for (int row = 0; row < nRows; row++)
+            for (int col = 0; col < nCols; col++)
+                furthest = std::max(furthest, depths[row * DEPTH_BLOCK_SIZE + col]);
+        } // edge block
+
+    size_t blockIndex = blockRow * blockColumns + blockCol;
+    if (furthest != blockMax[blockIndex])
+        { // changed
+        blockMax[blockIndex] = furthest;
+        tileDirty[(blockRow / DEPTH_TILE_BLOCKS) * tileColumns + blockCol / DEPTH_TILE_BLOCKS] = 1;
+        } // changed
+    } // UpdateBlockMax()
+
+// the furthest depth of a tile, counted in tiles
+uint32_t DepthBuffer::TileMax(long tileRow, long tileCol)
+    { // TileMax()
+    size_t tileIndex = tileRow * tileColumns + tileCol;
+    if (tileDirty[tileIndex])
+        { // work it out again
+        long lastBlockRow = std::min(blockRows, (tileRow + 1) * DEPTH_TILE_BLOCKS);
+        long lastBlockCol = std::min(blockColumns, (tileCol + 1) * DEPTH_TILE_BLOCKS);
+        uint32_t furthest = 0;
+        for (long blockRow = tileRow * DEPTH_TILE_BLOCKS; blockRow < lastBlockRow; blockRow++)
+            for (long blockCol = tileCol * DEPTH_TILE_BLOCKS; blockCol < lastBlockCol; blockCol++)
+                furthest = std::max(furthest, blockMax[blockRow * blockColumns + blockCol]);
+        tileMax[tileIndex] = furthest;
+        tileDirty[tileIndex] = 0;
+        } // work it out again
+    return tileMax[tileIndex];
+    } // TileMax()
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  ------------------------
+//  DepthBuffer.h
+//  ------------------------
+//
+//  A depth buffer holding 16 or 24 bit fixed point, or 32 bit float,
+//  depths.  Every format is kept in one 32 bit word per pixel, chosen
+//  so that nearer is always the smaller unsigned number - so the depth
+//  test is the same integer compare whatever the format.
+//
+//  The pixels are stored in square blocks of DEPTH_BLOCK_SIZE rows &
+//  columns rather than in rows, so the depths of one of the
+//  rasteriser's blocks are contiguous & can be tested together.
+//
+//  On top of the pixels sits a two level Hi-Z pyramid: the furthest
+//  depth of each block, and of each tile of DEPTH_TILE_BLOCKS square
+//  blocks.  These are never nearer than the pixels below them, so
+//  anything behind them is certainly hidden.  They are only kept up to
+//  date while depths get nearer (LESS & LEQUAL) - anything else marks
+//  them invalid until the next clear.
+//
+//  Clearing only sets the pyramid & marks every tile as waiting for the
+//  clear: the pixels of a tile are filled in by ResolveClear() when
+//  something is first drawn there, so tiles nothing is drawn in are
+//  never written.  Callers must resolve a tile before touching its
+//  pixels.
+//
+///////////////////////////////////////////////////
+
+#ifndef DEPTHBUFFER_H
+#define DEPTHBUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// the side of the square blocks the pixels are stored in
+const int DEPTH_BLOCK_SIZE = 8;
+const int DEPTH_BLOCK_PIXELS = DEPTH_BLOCK_SIZE * DEPTH_BLOCK_SIZE;
+// the side of the coarser Hi-Z tiles, in blocks
+const int DEPTH_TILE_BLOCKS = 8;
+
+// the formats a depth buffer can hold
+const unsigned int DEPTH_FORMAT_16 = 16;
+const unsigned int DEPTH_FORMAT_24 = 24;
+const unsigned int DEPTH_FORMAT_32F = 32;
+
+class DepthBuffer
+    { // class DepthBuffer
+    public:
+    // the depths, DEPTH_BLOCK_PIXELS at a time, row by row within a block
+    uint32_t *block;
+
+    // dimensions in pixels
+    long width, height;
+
+    // dimensions in blocks, rounded up - the spare pixels of the last blocks are never drawn
+    long blockColumns, blockRows;
+
+    // one of the DEPTH_FORMAT_ values
+    unsigned int format;
+
+    // the Hi-Z pyramid: the furthest depth in each block, and in each tile
+    std::vector<uint32_t> blockMax;
+    std::vector<uint32_t> tileMax;
+    // tiles whose blocks have changed since tileMax was last worked out
+    std::vector<char> tileDirty;
+    long tileColumns, tileRows;
+    // false once depths have been written that might be further than before
+    bool hiZValid;
+
+    // tiles whose pixels are still waiting to be set to clearValue
+    std::vector<char> tileClearPending;
+    uint32_t clearValue;
+
+    // constructor - starts empty & 24 bit
+    DepthBuffer();
+
+    // destructor
+    ~DepthBuffer();
+
+    // resizes the buffer, destroying any contents
+    bool Resize(long Width, long Height);
+
+    // changes the format, destroying any contents
+    void SetFormat(unsigned int newFormat);
+
+    // sets every pixel to a stored depth - which only marks the tiles as waiting for it
+    void Clear(uint32_t value);
+
+    // fills in the pixels of a tile if a clear is still waiting there, counted in tiles
+    inline void ResolveClear(long tileRow, long tileCol)
+        { // ResolveClear()
+        if (tileRow < tileRows && tileCol < tileColumns && tileClearPending[tileRow * tileColumns + tileCol])
+            FillTile(tileRow, tileCol);
+        } // ResolveClear()
+
+    // fills in every clear still waiting
+    void ResolveClears();
+
+    // converts a depth in [0, 1] to what is stored for it in the current format
+    inline uint32_t Quantise(float depth) const
+        { // Quantise()
+        if (format == DEPTH_FORMAT_32F)
+            { // float
+            // non-negative floats sort in the same order as their bits
+            // (-0 is the one exception - adding 0 turns it into +0)
+            depth += 0.0f;
+            uint32_t bits;
+            memcpy(&bits, &depth, sizeof(bits));
+            return bits;
+            } // float
+        // fixed point, rounded to nearest like OpenGL
+        uint32_t maximum = (format == DEPTH_FORMAT_16) ? 0xFFFFu : 0xFFFFFFu;
+        return (uint32_t) (depth * (float) maximum + 0.5f);
+        } // Quantise()
+
+    // the stored depth of the far plane, which the buffer is normally cleared to
+    inline uint32_t Far() const
+        { return Quantise(1.0f); }
+
+    // the index of a pixel in the block array
+    inline size_t Index(long row, long col) const
+        { // Index()
+        size_t blockIndex = (size_t) (row / DEPTH_BLOCK_SIZE) * blockColumns + col / DEPTH_BLOCK_SIZE;
+        return blockIndex * DEPTH_BLOCK_PIXELS + (row % DEPTH_BLOCK_SIZE) * DEPTH_BLOCK_SIZE + col % DEPTH_BLOCK_SIZE;
+        } // Index()
+
+    // the stored depth of a pixel
+    inline uint32_t &At(long row, long col)
+        { return block[Index(row, col)]; }
+
+    // the depths of the block holding a pixel whose row & column are multiples of DEPTH_BLOCK_SIZE
+    inline uint32_t *Block(long row, long col)
+        { return block + Index(row, col); }
+
+    // the furthest depth of a block, counted in blocks
+    inline uint32_t BlockMax(long blockRow, long blockCol) const
+        { return blockMax[blockRow * blockColumns + blockCol]; }
+
+    // works out the furthest depth of a block again from its pixels
+    void UpdateBlockMax(long blockRow, long blockCol);
+
+    // lowers the furthest depth of a block to a bound known to hold for all its pixels
+    inline void LowerBlockMax(long blockRow, long blockCol, uint32_t bound)
+        { // LowerBlockMax()
+        uint32_t &furthest = blockMax[blockRow * blockColumns + blockCol];
+        if (bound < furthest)
+            { // nearer
+            furthest = bound;
+            tileDirty[(blockRow / DEPTH_TILE_BLOCKS) * tileColumns + blockCol / DEPTH_TILE_BLOCKS] = 1;
+            } // nearer
+        } // LowerBlockMax()
+
+    // the furthest depth of a tile, counted in tiles
+    uint32_t TileMax(long tileRow, long tileCol);
+
+    private:
+    // sets the pixels of a tile to clearValue
+    void FillTile(long tileRow, long tileCol);
+
+    // a depth buffer owns its memory, so is not copied
+    DepthBuffer(const DepthBuffer &other);
+    DepthBuffer &operator = (const DepthBuffer &other);
+    }; // class DepthBuffer
+
+#endif
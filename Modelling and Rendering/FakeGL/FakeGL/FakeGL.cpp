@@ -14,10 +14,77 @@
 //  
 ///////////////////////////////////////////////////
  
+#define _USE_MATH_DEFINES
 #include "FakeGL.h"
 #include <math.h>
+#include <cmath>
 #include <algorithm>
 
+// SSE2 is always there on x64, so the rasteriser tests blocks of pixels with it whenever it can
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FAKEGL_SSE2
+#include <emmintrin.h>
+#endif
+
+// display list opcodes, each followed in the stream by the arguments of its call
+// primitives, whether from Begin() & End() or a draw call: type, first vertex & number of vertices
+static const uint32_t FAKEGL_OP_DRAW = 1;
+// the attributes a primitive leaves current: the index of a vertex holding them
+static const uint32_t FAKEGL_OP_ATTRIBUTES = 2;
+static const uint32_t FAKEGL_OP_POINT_SIZE = 3;
+static const uint32_t FAKEGL_OP_LINE_WIDTH = 4;
+static const uint32_t FAKEGL_OP_MATRIX_MODE = 5;
+static const uint32_t FAKEGL_OP_PUSH_MATRIX = 6;
+static const uint32_t FAKEGL_OP_POP_MATRIX = 7;
+static const uint32_t FAKEGL_OP_LOAD_IDENTITY = 8;
+static const uint32_t FAKEGL_OP_MULT_MATRIX = 9;
+static const uint32_t FAKEGL_OP_FRUSTUM = 10;
+static const uint32_t FAKEGL_OP_ORTHO = 11;
+static const uint32_t FAKEGL_OP_ROTATE = 12;
+static const uint32_t FAKEGL_OP_SCALE = 13;
+static const uint32_t FAKEGL_OP_TRANSLATE = 14;
+static const uint32_t FAKEGL_OP_VIEWPORT = 15;
+static const uint32_t FAKEGL_OP_COLOR = 16;
+static const uint32_t FAKEGL_OP_MATERIAL = 17;
+static const uint32_t FAKEGL_OP_MATERIALV = 18;
+static const uint32_t FAKEGL_OP_NORMAL = 19;
+static const uint32_t FAKEGL_OP_TEX_COORD = 20;
+static const uint32_t FAKEGL_OP_DISABLE = 21;
+static const uint32_t FAKEGL_OP_ENABLE = 22;
+static const uint32_t FAKEGL_OP_LIGHT = 23;
+static const uint32_t FAKEGL_OP_COLOR_MATERIAL = 24;
+static const uint32_t FAKEGL_OP_TEX_ENV_MODE = 25;
+static const uint32_t FAKEGL_OP_TEX_IMAGE = 26;
+static const uint32_t FAKEGL_OP_CLEAR = 27;
+static const uint32_t FAKEGL_OP_CLEAR_COLOR = 28;
+static const uint32_t FAKEGL_OP_CLEAR_DEPTH = 29;
+static const uint32_t FAKEGL_OP_DEPTH_FUNC = 30;
+static const uint32_t FAKEGL_OP_CALL_LIST = 31;
+static const uint32_t FAKEGL_OP_CULL_FACE = 32;
+static const uint32_t FAKEGL_OP_FRONT_FACE = 33;
+
+// copies the material properties of a vertex
+static void CopyMaterial(const vertexWithAttributes &vert, vertexMaterial &material)
+    { // CopyMaterial()
+        for (size_t i = 0; i < 4; i++) {
+            material.spec[i] = vert.spec[i];
+            material.amb[i] = vert.amb[i];
+            material.diff[i] = vert.diff[i];
+            material.emiss[i] = vert.emiss[i];
+        }
+        material.shin = vert.shin;
+    } // CopyMaterial()
+
+// whether a vertex has a given material
+static bool HasMaterial(const vertexWithAttributes &vert, const vertexMaterial &material)
+    { // HasMaterial()
+        for (size_t i = 0; i < 4; i++)
+            if (vert.spec[i] != material.spec[i] or vert.amb[i] != material.amb[i]
+                or vert.diff[i] != material.diff[i] or vert.emiss[i] != material.emiss[i])
+                return false;
+        return vert.shin == material.shin;
+    } // HasMaterial()
+
 //-------------------------------------------------//
 //                                                 //
 // CONSTRUCTOR / DESTRUCTOR                        //
@@ -46,36 +113,176 @@ FakeGL::~FakeGL()
 // starts a sequence of geometric primitives
 void FakeGL::Begin(unsigned int PrimitiveType)
     { // Begin()
+        // a list records the whole primitive at End(), from the vertices it collects meanwhile
+        if (compilingList != 0) {
+            compilingPrimitive = true;
+            compilingPrimType = PrimitiveType;
+            compilingFirstVertex = displayLists[compilingList - 1].vertices.size();
+            if (!compileAndExecute)
+                return;
+        }
+        StartPrimitive(PrimitiveType);
+    } // Begin()
+
+// empties the queues for a new primitive, which Begin() & the draw calls share
+void FakeGL::StartPrimitive(unsigned int PrimitiveType)
+    { // StartPrimitive()
         primType = PrimitiveType;
         
         // Clear the queues incase too many vertices were listed in the previous Begin & End call pair
         vertexQueue.clear();
         rasterQueue.clear();
         fragmentQueue.clear();
-    } // Begin()
+        varyings.clear();
+        drawMaterials.clear();
+    } // StartPrimitive()
 
 // ends a sequence of geometric primitives
 void FakeGL::End()
     { // End()
-        // Tranform every vertex, TransformVertex() reduces the vertexQueue size by 1 each call
-        for (; vertexQueue.size() > 0;TransformVertex());
+        if (compilingPrimitive) {
+            compilingPrimitive = false;
+            displayList &list = displayLists[compilingList - 1];
+            size_t nVertices = list.vertices.size() - compilingFirstVertex;
+            // replaying the primitive should leave the attributes current that it did, so they are kept as one more vertex
+            vertexWithAttributes current;
+            CurrentVertex(current);
+            list.vertices.push_back(current);
+            bool onlyRecorded = Record(FAKEGL_OP_DRAW, compilingPrimType, (uint32_t) compilingFirstVertex, (uint32_t) nVertices);
+            Record(FAKEGL_OP_ATTRIBUTES, (uint32_t) list.vertices.size() - 1);
+            if (onlyRecorded)
+                return;
+        }
 
-        // Rasterise primitives until there are not enough vertices in the queue
-        while (RasterisePrimitive());
+        TransformVertices(vertexQueue.data(), vertexQueue.size());
+        vertexQueue.clear();
 
-        // Process each fragment one by one
-        for (; fragmentQueue.size() > 0; ProcessFragment());
+        DrawRasterQueue();
     } // End()
 
+// transforms vertices onto the end of the raster queue - the first half of End()
+void FakeGL::TransformVertices(const vertexWithAttributes *vertices, size_t nVertices)
+    { // TransformVertices()
+        // Transform every vertex in one pass, without giving back the queue's memory
+        // each vertex is independent, so with several threads they share the work a chunk at a time
+        SetClipPlanes();
+        DeclareVaryings();
+        size_t firstVertex = rasterQueue.size();
+        rasterQueue.resize(firstVertex + nVertices);
+        varyings.resize((firstVertex + nVertices) * varyingStride);
+        size_t nChunks = (nVertices + FAKEGL_TRANSFORM_CHUNK - 1) / FAKEGL_TRANSFORM_CHUNK;
+        threadPool.Run(nChunks, [&](size_t chunk)
+            { // per chunk
+            size_t end = std::min(nVertices, (chunk + 1) * FAKEGL_TRANSFORM_CHUNK);
+            for (size_t vertex = chunk * FAKEGL_TRANSFORM_CHUNK; vertex < end; vertex += FAKEGL_TRANSFORM_BATCH)
+                TransformBatch(vertices + vertex, std::min(FAKEGL_TRANSFORM_BATCH, end - vertex),
+                               &rasterQueue[firstVertex + vertex], firstVertex + vertex);
+            }); // per chunk
+
+        // the materials, if the draw needs them: a new one only where a vertex's differs from the one before
+        if (varyingMaterials)
+            for (size_t vertex = 0; vertex < nVertices; vertex++) {
+                if (drawMaterials.empty() or !HasMaterial(vertices[vertex], drawMaterials.back())) {
+                    drawMaterials.emplace_back();
+                    CopyMaterial(vertices[vertex], drawMaterials.back());
+                }
+                rasterQueue[firstVertex + vertex].material = (uint32_t) drawMaterials.size() - 1;
+            }
+    } // TransformVertices()
+
+// clips & rasterises the complete primitives in the raster queue, then processes any held back fragments
+void FakeGL::DrawRasterQueue()
+    { // DrawRasterQueue()
+        // Clip to the near & far planes & the guard band, so that nothing behind the eye
+        // is drawn and the rasteriser never sees a triangle too large for fixed point
+        ClipPrimitives();
+        // and drop the triangles that can't draw anything before any pixel of them is looked at
+        if (primType == FAKEGL_TRIANGLES)
+            CullTriangles();
+
+        // Phong triangles can leave their lighting until the visible ones are known
+        if (varyingsDeferred)
+            DeferTriangles();
+
+        // depth tests that can move a stored depth further away leave the Hi-Z pyramid behind
+        if (dBufferingEnabled and depthFunc != FAKEGL_LESS and depthFunc != FAKEGL_LEQUAL and depthFunc != FAKEGL_EQUAL and depthFunc != FAKEGL_NEVER)
+            depthBuffer.hiZValid = false;
+
+        // With a depth pre-pass, rasterise the triangles once for depth only, so that
+        // the shading pass below only lights & textures the fragments that end up visible
+        // only LEQUAL & GEQUAL let the final fragment through again unchanged - with the others
+        // either the pre-pass would reject it (LESS, GREATER) or it means nothing
+        bool prePass = depthPrePassEnabled and dBufferingEnabled and primType == FAKEGL_TRIANGLES
+                        and (depthFunc == FAKEGL_LEQUAL or depthFunc == FAKEGL_GEQUAL);
+
+        size_t nextVertex = 0;
+        // a draw call wholly behind what is already there needs nothing rasterised at all
+        if (BatchHidden()) {
+            size_t nPrimitives = rasterQueue.size() / 3;
+            hiZCulledTriangles += nPrimitives;
+            nextVertex = nPrimitives * 3;
+        }
+        // held back fragments have to stay in order, so they are only ever generated on this thread
+        else if (threadPool.Size() > 1 and !deferFragments) {
+            // sort the primitives into the screen tiles they touch, then let each thread take whole
+            // tiles - no two threads ever write the same pixel, and each tile still sees its
+            // primitives in the order they were sent, so the image is the same as drawing them in turn
+            size_t nPrimitives = BinPrimitives();
+            for (int pass = prePass ? 0 : 1; pass < 2; pass++) {
+                depthOnlyPass = (pass == 0);
+                threadPool.Run(tileBins.size(), [&](size_t tile)
+                    { // per tile
+                    // a clear still waiting is filled in by the thread about to draw there
+                    if (clearPending and !tileBins[tile].empty())
+                        ResolveTileClear((long) tile / nTileCols, (long) tile % nTileCols);
+                    rasterRectangle clip = TileRectangle(tile);
+                    for (uint32_t primitive : tileBins[tile]) {
+                        size_t vertex = primitive * VerticesPerPrimitive();
+                        RasterisePrimitive(vertex, clip);
+                    }
+                    }); // per tile
+            }
+            depthOnlyPass = false;
+            nextVertex = nPrimitives * VerticesPerPrimitive();
+        }
+        else {
+            // clears still waiting are filled in where the primitives might reach first
+            if (clearPending)
+                ResolveQueueClears();
+            rasterRectangle clip = { 0, 0, (int) frameBuffer.width - 1, (int) frameBuffer.height - 1 };
+            if (prePass) {
+                depthOnlyPass = true;
+                while (RasterisePrimitive(nextVertex, clip));
+                depthOnlyPass = false;
+                nextVertex = 0;
+            }
+
+            // Rasterise primitives until there are not enough vertices in the queue
+            while (RasterisePrimitive(nextVertex, clip));
+        }
+        shadingDeferred = false;
+        // any incomplete primitive stays queued, as before
+        rasterQueue.erase(rasterQueue.begin(), rasterQueue.begin() + nextVertex);
+
+        // Process any fragments that were held back, in the order they were generated
+        for (size_t fragment = 0; fragment < fragmentQueue.size(); fragment++)
+            ProcessFragment(fragmentQueue[fragment]);
+        fragmentQueue.clear();
+    } // DrawRasterQueue()
+
 // sets the size of a point for drawing
 void FakeGL::PointSize(float size)
     { // PointSize()
+        if (Record(FAKEGL_OP_POINT_SIZE, size))
+            return;
         pointSize = (unsigned int) size;
     } // PointSize()
 
 // sets the width of a line for drawing purposes
 void FakeGL::LineWidth(float width)
     { // LineWidth()
+        if (Record(FAKEGL_OP_LINE_WIDTH, width))
+            return;
         lineWidth = width;
     } // LineWidth()
 
@@ -88,6 +295,8 @@ void FakeGL::LineWidth(float width)
 // set the matrix mode (i.e. which one we change)   
 void FakeGL::MatrixMode(unsigned int whichMatrix)
     { // MatrixMode()
+        if (Record(FAKEGL_OP_MATRIX_MODE, whichMatrix))
+            return;
         // currMatrixStack is a pointer
         if (whichMatrix == FAKEGL_MODELVIEW) {
             currMatrixStack = &mvMatrixStack;
@@ -100,6 +309,8 @@ void FakeGL::MatrixMode(unsigned int whichMatrix)
 // pushes a matrix on the stack
 void FakeGL::PushMatrix()
     { // PushMatrix()
+        if (Record(FAKEGL_OP_PUSH_MATRIX))
+            return;
         // Copies the top of the stack and pushes it on
         currMatrixStack->push(currMatrixStack->top());
     } // PushMatrix()
@@ -107,6 +318,8 @@ void FakeGL::PushMatrix()
 // pops a matrix off the stack
 void FakeGL::PopMatrix()
     { // PopMatrix()
+        if (Record(FAKEGL_OP_POP_MATRIX))
+            return;
         currMatrixStack->pop();
         // If the pop results in an empty stack, fill with an empty matrix
         if (currMatrixStack->size() == 0) {
@@ -117,12 +330,20 @@ void FakeGL::PopMatrix()
 // load the identity matrix
 void FakeGL::LoadIdentity()
     { // LoadIdentity()
+        if (Record(FAKEGL_OP_LOAD_IDENTITY))
+            return;
         currMatrixStack->top().SetIdentity();
     } // LoadIdentity()
 
 // multiply by a known matrix in column-major format
 void FakeGL::MultMatrixf(const float *columnMajorCoordinates)
     { // MultMatrixf()
+        if (compilingList != 0) {
+            bool onlyRecorded = Record(FAKEGL_OP_MULT_MATRIX);
+            displayLists[compilingList - 1].PutFloats(columnMajorCoordinates, 16);
+            if (onlyRecorded)
+                return;
+        }
 
         // Convert the matrix passed in to a Matrix4 instance
         Matrix4 inMat;
@@ -139,6 +360,8 @@ void FakeGL::MultMatrixf(const float *columnMajorCoordinates)
 // sets up a perspective projection matrix
 void FakeGL::Frustum(float left, float right, float bottom, float top, float zNear, float zFar)
     { // Frustum()
+        if (Record(FAKEGL_OP_FRUSTUM, left, right, bottom, top, zNear, zFar))
+            return;
         // Generate the frustrum projection matrix according to the OpenGL documentation
         Matrix4 frusMat;
         frusMat[0][0] = (2.*zNear)/(right-left);
@@ -159,6 +382,8 @@ void FakeGL::Frustum(float left, float right, float bottom, float top, float zNe
 // sets an orthographic projection matrix
 void FakeGL::Ortho(float left, float right, float bottom, float top, float zNear, float zFar)
     { // Ortho()
+        if (Record(FAKEGL_OP_ORTHO, left, right, bottom, top, zNear, zFar))
+            return;
         // Same as frustrum but for orthographic projection
         Matrix4 orthMat;
         orthMat[0][0] = 2./(right-left);
@@ -178,6 +403,8 @@ void FakeGL::Ortho(float left, float right, float bottom, float top, float zNear
 // rotate the matrix
 void FakeGL::Rotatef(float angle, float axisX, float axisY, float axisZ)
     { // Rotatef()
+        if (Record(FAKEGL_OP_ROTATE, angle, axisX, axisY, axisZ))
+            return;
         // Create the desired rotation as a matrix
         Matrix4 rotMat;
         rotMat.SetRotation(Cartesian3(axisX,axisY,axisZ),angle);
@@ -188,6 +415,8 @@ void FakeGL::Rotatef(float angle, float axisX, float axisY, float axisZ)
 // scale the matrix
 void FakeGL::Scalef(float xScale, float yScale, float zScale)
     { // Scalef()
+        if (Record(FAKEGL_OP_SCALE, xScale, yScale, zScale))
+            return;
         Matrix4 scaleMat;
         scaleMat.SetScale(xScale,yScale,zScale);
 
@@ -197,6 +426,8 @@ void FakeGL::Scalef(float xScale, float yScale, float zScale)
 // translate the matrix
 void FakeGL::Translatef(float xTranslate, float yTranslate, float zTranslate)
     { // Translatef()
+        if (Record(FAKEGL_OP_TRANSLATE, xTranslate, yTranslate, zTranslate))
+            return;
         Matrix4 transMat;
         transMat.SetTranslation(Cartesian3(xTranslate,yTranslate,zTranslate));
 
@@ -206,6 +437,8 @@ void FakeGL::Translatef(float xTranslate, float yTranslate, float zTranslate)
 // sets the viewport
 void FakeGL::Viewport(int x, int y, int width, int height)
     { // Viewport()
+        if (Record(FAKEGL_OP_VIEWPORT, x, y, width, height))
+            return;
         windowX = x;
         windowY = y;
         windowWidth = width;
@@ -221,16 +454,29 @@ void FakeGL::Viewport(int x, int y, int width, int height)
 // sets colour with floating point
 void FakeGL::Color3f(float red, float green, float blue)
     { // Color3f()
+        // attributes run even when a list is only compiled, as its vertices are made from them
+        // (EndList() puts them back), and inside a primitive they are recorded with the vertices
+        if (!compilingPrimitive)
+            Record(FAKEGL_OP_COLOR, red, green, blue);
+
         // Scale up the floats from 0-1 -> 0->255
         drawColor.red = red*255.f;
         drawColor.green = green*255.f;
         drawColor.blue = blue*255.f;
         drawColor.alpha = 255.f;
+
+        // with colour material on, the colour stands in for the material parameters it names
+        if (colorMaterialEnabled) {
+            float colour[4] = {red, green, blue, 1.f};
+            SetMaterial(colorMaterialParameter, colour);
+        }
     } // Color3f()
 
 // sets material properties
 void FakeGL::Materialf(unsigned int parameterName, const float parameterValue)
     { // Materialf()
+        if (!compilingPrimitive)
+            Record(FAKEGL_OP_MATERIAL, parameterName, parameterValue);
         if (parameterName & FAKEGL_SHININESS) {
             matShininess = parameterValue;
         }
@@ -238,7 +484,16 @@ void FakeGL::Materialf(unsigned int parameterName, const float parameterValue)
 
 void FakeGL::Materialfv(unsigned int parameterName, const float *parameterValues)
     { // Materialfv()
+        if (compilingList != 0 and !compilingPrimitive) {
+            Record(FAKEGL_OP_MATERIALV, parameterName);
+            displayLists[compilingList - 1].PutFloats(parameterValues, 4);
+        }
+        SetMaterial(parameterName, parameterValues);
+    } // Materialfv()
 
+// sets the current material parameters named by a Materialfv() style bit mask
+void FakeGL::SetMaterial(unsigned int parameterName, const float *parameterValues)
+    { // SetMaterial()
         if (parameterName & FAKEGL_AMBIENT_AND_DIFFUSE) {
             for (size_t i = 0; i < 4; i++)
             {
@@ -270,17 +525,21 @@ void FakeGL::Materialfv(unsigned int parameterName, const float *parameterValues
                 matEmission[i] = parameterValues[i];
             }
         }
-    } // Materialfv()
+    } // SetMaterial()
 
 // sets the normal vector
 void FakeGL::Normal3f(float x, float y, float z)
     { // Normal3f()
+        if (!compilingPrimitive)
+            Record(FAKEGL_OP_NORMAL, x, y, z);
         normal = Cartesian3(x,y,z);
     } // Normal3f()
 
 // sets the texture coordinates
 void FakeGL::TexCoord2f(float u, float v)
     { // TexCoord2f()
+    if (!compilingPrimitive)
+        Record(FAKEGL_OP_TEX_COORD, u, v);
     texCoord = Cartesian3(u,v,0.f);
     } // TexCoord2f()
 
@@ -289,27 +548,382 @@ void FakeGL::Vertex3f(float x, float y, float z)
     { // Vertex3f()
         // Generate a new vertex with the properties filled by the current state of the FakeGL instance
         vertexWithAttributes newVert;
+        CurrentVertex(newVert);
         newVert.position = Homogeneous4(x,y,z);
-        newVert.colour.red = drawColor.red;
-        newVert.colour.green = drawColor.green;
-        newVert.colour.blue = drawColor.blue;
-        newVert.colour.alpha = drawColor.alpha;
-        newVert.normal = normal;
 
-        for (size_t i = 0; i < 4; i++) {
-            newVert.spec[i] = matSpecular[i];
-            newVert.amb[i] = matAmbient[i];
-            newVert.diff[i] = matDiffuse[i];
-            newVert.emiss[i] = matEmission[i];
+        // a list keeps its own copy, ready to transform when it is replayed
+        if (compilingPrimitive) {
+            displayLists[compilingList - 1].vertices.push_back(newVert);
+            if (!compileAndExecute)
+                return;
         }
-        newVert.shin = matShininess;
-
-        newVert.texCoord = texCoord;
 
         // Add it to the vertex queue
         vertexQueue.push_back(newVert);
     } // Vertex3f()
 
+//-------------------------------------------------//
+//                                                 //
+// VERTEX ARRAY ROUTINES                           //
+//                                                 //
+//-------------------------------------------------//
+
+// sets the array of positions
+void FakeGL::VertexPointer(int size, size_t stride, const float *pointer)
+    { // VertexPointer()
+        vertexArray.size = std::min(std::max(size, 2), 4);
+        vertexArray.stride = stride;
+        vertexArray.pointer = pointer;
+    } // VertexPointer()
+
+// sets the array of normals
+void FakeGL::NormalPointer(size_t stride, const float *pointer)
+    { // NormalPointer()
+        normalArray.size = 3;
+        normalArray.stride = stride;
+        normalArray.pointer = pointer;
+    } // NormalPointer()
+
+// sets the array of colours
+void FakeGL::ColorPointer(int size, size_t stride, const float *pointer)
+    { // ColorPointer()
+        colorArray.size = std::min(std::max(size, 3), 4);
+        colorArray.stride = stride;
+        colorArray.pointer = pointer;
+    } // ColorPointer()
+
+// sets the array of texture coordinates
+void FakeGL::TexCoordPointer(int size, size_t stride, const float *pointer)
+    { // TexCoordPointer()
+        texCoordArray.size = std::min(std::max(size, 1), 3);
+        texCoordArray.stride = stride;
+        texCoordArray.pointer = pointer;
+    } // TexCoordPointer()
+
+// turns one of the arrays on
+void FakeGL::EnableClientState(unsigned int array)
+    { // EnableClientState()
+        if (array == FAKEGL_VERTEX_ARRAY) vertexArray.enabled = true;
+        if (array == FAKEGL_NORMAL_ARRAY) normalArray.enabled = true;
+        if (array == FAKEGL_COLOR_ARRAY) colorArray.enabled = true;
+        if (array == FAKEGL_TEXTURE_COORD_ARRAY) texCoordArray.enabled = true;
+    } // EnableClientState()
+
+// turns one of the arrays off
+void FakeGL::DisableClientState(unsigned int array)
+    { // DisableClientState()
+        if (array == FAKEGL_VERTEX_ARRAY) vertexArray.enabled = false;
+        if (array == FAKEGL_NORMAL_ARRAY) normalArray.enabled = false;
+        if (array == FAKEGL_COLOR_ARRAY) colorArray.enabled = false;
+        if (array == FAKEGL_TEXTURE_COORD_ARRAY) texCoordArray.enabled = false;
+    } // DisableClientState()
+
+// draws primitives from count vertices of the arrays in turn
+void FakeGL::DrawArrays(unsigned int mode, size_t first, size_t count)
+    { // DrawArrays()
+        // a list reads the arrays now, so replaying it doesn't need them
+        if (compilingList != 0) {
+            displayList &list = displayLists[compilingList - 1];
+            size_t firstVertex = list.vertices.size();
+            list.vertices.resize(firstVertex + count);
+            for (size_t vertex = 0; vertex < count; vertex++)
+                FetchVertex(first + vertex, list.vertices[firstVertex + vertex]);
+            if (Record(FAKEGL_OP_DRAW, mode, (uint32_t) firstVertex, (uint32_t) count))
+                return;
+        }
+
+        // a draw call is a whole Begin() / End() pair, with the vertices read straight from the arrays
+        StartPrimitive(mode);
+        SetClipPlanes();
+        DeclareVaryings();
+        rasterQueue.resize(count);
+        TransformArrayVertices(first, count, rasterQueue.data());
+        DrawRasterQueue();
+    } // DrawArrays()
+
+// draws primitives from the array vertices that count indices name
+void FakeGL::DrawElements(unsigned int mode, size_t count, const unsigned int *indices)
+    { // DrawElements()
+        // a list reads the arrays now, a vertex per index, so replaying it doesn't need them
+        if (compilingList != 0) {
+            displayList &list = displayLists[compilingList - 1];
+            size_t firstVertex = list.vertices.size();
+            list.vertices.resize(firstVertex + count);
+            for (size_t index = 0; index < count; index++)
+                FetchVertex(indices[index], list.vertices[firstVertex + index]);
+            if (Record(FAKEGL_OP_DRAW, mode, (uint32_t) firstVertex, (uint32_t) count))
+                return;
+        }
+
+        StartPrimitive(mode);
+        if (count == 0)
+            return;
+
+        // the vertices are fetched, lit & transformed just once each, rather than once per primitive
+        unsigned int lowest = *std::min_element(indices, indices + count);
+        unsigned int highest = *std::max_element(indices, indices + count);
+        size_t nVertices = (size_t) highest - lowest + 1;
+        SetClipPlanes();
+        DeclareVaryings();
+        transformedVertices.resize(nVertices);
+        TransformArrayVertices(lowest, nVertices, transformedVertices.data());
+
+        // and the primitives take copies of the results, in the order the indices give
+        // - the varyings & materials stay where they are, shared by every copy
+        rasterQueue.resize(count);
+        size_t nChunks = (count + FAKEGL_TRANSFORM_CHUNK - 1) / FAKEGL_TRANSFORM_CHUNK;
+        threadPool.Run(nChunks, [&](size_t chunk)
+            { // per chunk
+            size_t end = std::min(count, (chunk + 1) * FAKEGL_TRANSFORM_CHUNK);
+            for (size_t index = chunk * FAKEGL_TRANSFORM_CHUNK; index < end; index++)
+                rasterQueue[index] = transformedVertices[indices[index] - lowest];
+            }); // per chunk
+        DrawRasterQueue();
+    } // DrawElements()
+
+//-------------------------------------------------//
+//                                                 //
+// DISPLAY LIST ROUTINES                           //
+//                                                 //
+//-------------------------------------------------//
+
+// reserves range unused list names, returning the first (0 if range is 0)
+unsigned int FakeGL::GenLists(unsigned int range)
+    { // GenLists()
+        if (range == 0)
+            return 0;
+        // every name past the end is unused
+        unsigned int first = (unsigned int) displayLists.size() + 1;
+        displayLists.resize(displayLists.size() + range);
+        return first;
+    } // GenLists()
+
+// starts recording list, replacing whatever it held
+void FakeGL::NewList(unsigned int list, unsigned int mode)
+    { // NewList()
+        // lists don't nest, and 0 is never a list
+        if (list == 0 or compilingList != 0 or (mode != FAKEGL_COMPILE and mode != FAKEGL_COMPILE_AND_EXECUTE))
+            return;
+        if (list > displayLists.size())
+            displayLists.resize(list);
+        displayLists[list - 1] = displayList();
+        displayLists[list - 1].defined = true;
+
+        // attributes are set while compiling, so the vertices have them, so keep what to put back
+        CurrentVertex(compileSavedAttributes);
+        compileSavedColorMaterial = colorMaterialEnabled;
+        compileSavedColorMaterialParameter = colorMaterialParameter;
+
+        compilingList = list;
+        compileAndExecute = (mode == FAKEGL_COMPILE_AND_EXECUTE);
+        compilingPrimitive = false;
+    } // NewList()
+
+// stops recording
+void FakeGL::EndList()
+    { // EndList()
+        if (compilingList == 0)
+            return;
+
+        // a list only compiled leaves the attributes as they were
+        if (!compileAndExecute) {
+            SetCurrentAttributes(compileSavedAttributes);
+            colorMaterialEnabled = compileSavedColorMaterial;
+            colorMaterialParameter = compileSavedColorMaterialParameter;
+        }
+
+        // the list won't grow any more
+        displayList &list = displayLists[compilingList - 1];
+        list.commands.shrink_to_fit();
+        list.vertices.shrink_to_fit();
+        compilingList = 0;
+        compilingPrimitive = false;
+    } // EndList()
+
+// replays a list
+void FakeGL::CallList(unsigned int list)
+    { // CallList()
+        if (Record(FAKEGL_OP_CALL_LIST, list))
+            return;
+        if (!IsList(list) or callListDepth >= FAKEGL_MAX_LIST_NESTING)
+            return;
+
+        // what the list does is not recorded again, as the call to it already has been
+        unsigned int recording = compilingList;
+        compilingList = 0;
+        callListDepth++;
+        ReplayList(displayLists[list - 1]);
+        callListDepth--;
+        compilingList = recording;
+    } // CallList()
+
+// replays the commands of a list
+void FakeGL::ReplayList(const displayList &list)
+    { // ReplayList()
+        const uint32_t *command = list.commands.data();
+        const uint32_t *end = command + list.commands.size();
+        // the arguments are read in the order they were put
+        float values[16];
+        auto word = [&command]() { return *command++; };
+        auto floats = [&command, &values](size_t count) { memcpy(values, command, count * sizeof(float)); command += count; };
+
+        while (command < end) {
+            uint32_t opcode = word();
+            switch (opcode) {
+                case FAKEGL_OP_DRAW: {
+                    // the vertices are ready made, so go straight to the transform stage
+                    unsigned int mode = word();
+                    uint32_t first = word();
+                    uint32_t count = word();
+                    StartPrimitive(mode);
+                    TransformVertices(list.vertices.data() + first, count);
+                    DrawRasterQueue();
+                    break;
+                }
+                case FAKEGL_OP_ATTRIBUTES:
+                    SetCurrentAttributes(list.vertices[word()]);
+                    break;
+                case FAKEGL_OP_POINT_SIZE:
+                    floats(1);
+                    PointSize(values[0]);
+                    break;
+                case FAKEGL_OP_LINE_WIDTH:
+                    floats(1);
+                    LineWidth(values[0]);
+                    break;
+                case FAKEGL_OP_MATRIX_MODE:
+                    MatrixMode(word());
+                    break;
+                case FAKEGL_OP_PUSH_MATRIX:
+                    PushMatrix();
+                    break;
+                case FAKEGL_OP_POP_MATRIX:
+                    PopMatrix();
+                    break;
+                case FAKEGL_OP_LOAD_IDENTITY:
+                    LoadIdentity();
+                    break;
+                case FAKEGL_OP_MULT_MATRIX:
+                    floats(16);
+                    MultMatrixf(values);
+                    break;
+                case FAKEGL_OP_FRUSTUM:
+                    floats(6);
+                    Frustum(values[0], values[1], values[2], values[3], values[4], values[5]);
+                    break;
+                case FAKEGL_OP_ORTHO:
+                    floats(6);
+                    Ortho(values[0], values[1], values[2], values[3], values[4], values[5]);
+                    break;
+                case FAKEGL_OP_ROTATE:
+                    floats(4);
+                    Rotatef(values[0], values[1], values[2], values[3]);
+                    break;
+                case FAKEGL_OP_SCALE:
+                    floats(3);
+                    Scalef(values[0], values[1], values[2]);
+                    break;
+                case FAKEGL_OP_TRANSLATE:
+                    floats(3);
+                    Translatef(values[0], values[1], values[2]);
+                    break;
+                case FAKEGL_OP_VIEWPORT: {
+                    int x = (int) word();
+                    int y = (int) word();
+                    int width = (int) word();
+                    int height = (int) word();
+                    Viewport(x, y, width, height);
+                    break;
+                }
+                case FAKEGL_OP_COLOR:
+                    floats(3);
+                    Color3f(values[0], values[1], values[2]);
+                    break;
+                case FAKEGL_OP_MATERIAL: {
+                    unsigned int parameterName = word();
+                    floats(1);
+                    Materialf(parameterName, values[0]);
+                    break;
+                }
+                case FAKEGL_OP_MATERIALV: {
+                    unsigned int parameterName = word();
+                    floats(4);
+                    Materialfv(parameterName, values);
+                    break;
+                }
+                case FAKEGL_OP_NORMAL:
+                    floats(3);
+                    Normal3f(values[0], values[1], values[2]);
+                    break;
+                case FAKEGL_OP_TEX_COORD:
+                    floats(2);
+                    TexCoord2f(values[0], values[1]);
+                    break;
+                case FAKEGL_OP_DISABLE:
+                    Disable(word());
+                    break;
+                case FAKEGL_OP_ENABLE:
+                    Enable(word());
+                    break;
+                case FAKEGL_OP_LIGHT: {
+                    int parameterName = (int) word();
+                    floats(4);
+                    Light(parameterName, values);
+                    break;
+                }
+                case FAKEGL_OP_COLOR_MATERIAL:
+                    ColorMaterial(word());
+                    break;
+                case FAKEGL_OP_TEX_ENV_MODE:
+                    TexEnvMode(word());
+                    break;
+                case FAKEGL_OP_TEX_IMAGE:
+                    TexImage2D(*list.textures[word()]);
+                    break;
+                case FAKEGL_OP_CLEAR:
+                    Clear(word());
+                    break;
+                case FAKEGL_OP_CLEAR_COLOR:
+                    floats(4);
+                    ClearColor(values[0], values[1], values[2], values[3]);
+                    break;
+                case FAKEGL_OP_CLEAR_DEPTH:
+                    floats(1);
+                    ClearDepth(values[0]);
+                    break;
+                case FAKEGL_OP_DEPTH_FUNC:
+                    DepthFunc(word());
+                    break;
+                case FAKEGL_OP_CALL_LIST:
+                    CallList(word());
+                    break;
+                case FAKEGL_OP_CULL_FACE:
+                    CullFace(word());
+                    break;
+                case FAKEGL_OP_FRONT_FACE:
+                    FrontFace(word());
+                    break;
+                default:
+                    // nothing else is ever recorded
+                    return;
+            }
+        }
+    } // ReplayList()
+
+// frees range lists starting at list
+void FakeGL::DeleteLists(unsigned int list, unsigned int range)
+    { // DeleteLists()
+        for (size_t name = list; name < (size_t) list + range and name <= displayLists.size(); name++)
+            if (name != 0 and name != compilingList)
+                displayLists[name - 1] = displayList();
+    } // DeleteLists()
+
+// true if NewList() has recorded list
+bool FakeGL::IsList(unsigned int list)
+    { // IsList()
+        return list != 0 and list <= displayLists.size() and displayLists[list - 1].defined;
+    } // IsList()
+
 //-------------------------------------------------//
 //                                                 //
 // STATE VARIABLE ROUTINES                         //
@@ -319,6 +933,9 @@ void FakeGL::Vertex3f(float x, float y, float z)
 // disables a specific flag in the library
 void FakeGL::Disable(unsigned int property)
     { // Disable()
+        // colour material changes the vertices a list records, so it runs even when only compiling
+        if (Record(FAKEGL_OP_DISABLE, property) and property != FAKEGL_COLOR_MATERIAL)
+            return;
         if (property == FAKEGL_LIGHTING) {
             lightingEnabled = false;
         }
@@ -331,11 +948,28 @@ void FakeGL::Disable(unsigned int property)
         if (property == FAKEGL_PHONG_SHADING) {
             phongEnabled = false;
         }
+        if (property == FAKEGL_DEPTH_PREPASS) {
+            depthPrePassEnabled = false;
+        }
+        if (property == FAKEGL_HIERARCHICAL_Z) {
+            hiZEnabled = false;
+        }
+        if (property == FAKEGL_COLOR_MATERIAL) {
+            colorMaterialEnabled = false;
+        }
+        if (property == FAKEGL_DEFERRED_SHADING) {
+            deferredShadingEnabled = false;
+        }
+        if (property == FAKEGL_CULL_FACE) {
+            cullFaceEnabled = false;
+        }
     } // Disable()
 
 // enables a specific flag in the library
 void FakeGL::Enable(unsigned int property)
     { // Enable()
+        if (Record(FAKEGL_OP_ENABLE, property) and property != FAKEGL_COLOR_MATERIAL)
+            return;
         if (property == FAKEGL_LIGHTING) {
             lightingEnabled = true;
         }
@@ -348,8 +982,41 @@ void FakeGL::Enable(unsigned int property)
         if (property == FAKEGL_PHONG_SHADING) {
             phongEnabled = true;
         }
+        if (property == FAKEGL_DEPTH_PREPASS) {
+            depthPrePassEnabled = true;
+        }
+        if (property == FAKEGL_HIERARCHICAL_Z) {
+            hiZEnabled = true;
+        }
+        if (property == FAKEGL_COLOR_MATERIAL) {
+            colorMaterialEnabled = true;
+        }
+        if (property == FAKEGL_DEFERRED_SHADING) {
+            deferredShadingEnabled = true;
+        }
+        if (property == FAKEGL_CULL_FACE) {
+            cullFaceEnabled = true;
+        }
     } // Enable()
 
+// sets which triangles FAKEGL_CULL_FACE drops
+void FakeGL::CullFace(unsigned int mode)
+    { // CullFace()
+        if (Record(FAKEGL_OP_CULL_FACE, mode))
+            return;
+        if (mode == FAKEGL_FRONT or mode == FAKEGL_BACK or mode == FAKEGL_FRONT_AND_BACK)
+            cullFaceMode = mode;
+    } // CullFace()
+
+// sets which winding on the screen faces the front
+void FakeGL::FrontFace(unsigned int mode)
+    { // FrontFace()
+        if (Record(FAKEGL_OP_FRONT_FACE, mode))
+            return;
+        if (mode == FAKEGL_CW or mode == FAKEGL_CCW)
+            frontFace = mode;
+    } // FrontFace()
+
 //-------------------------------------------------//
 //                                                 //
 // LIGHTING STATE ROUTINES                         //
@@ -359,6 +1026,12 @@ void FakeGL::Enable(unsigned int property)
 // sets properties for the one and only light
 void FakeGL::Light(int parameterName, const float *parameterValues)
     { // Light()
+        if (compilingList != 0) {
+            bool onlyRecorded = Record(FAKEGL_OP_LIGHT, parameterName);
+            displayLists[compilingList - 1].PutFloats(parameterValues, 4);
+            if (onlyRecorded)
+                return;
+        }
         if (parameterName & FAKEGL_POSITION) {
             lightPosition = Homogeneous4(parameterValues[0],
                                          parameterValues[1],
@@ -390,6 +1063,14 @@ void FakeGL::Light(int parameterName, const float *parameterValues)
         }
     } // Light()
 
+// sets which material parameters follow the colour while FAKEGL_COLOR_MATERIAL is enabled
+void FakeGL::ColorMaterial(unsigned int parameterName)
+    { // ColorMaterial()
+        if (!compilingPrimitive)
+            Record(FAKEGL_OP_COLOR_MATERIAL, parameterName);
+        colorMaterialParameter = parameterName & (FAKEGL_AMBIENT_AND_DIFFUSE | FAKEGL_SPECULAR | FAKEGL_EMISSION);
+    } // ColorMaterial()
+
 //-------------------------------------------------//
 //                                                 //
 // TEXTURE PROCESSING ROUTINES                     //
@@ -402,12 +1083,20 @@ void FakeGL::Light(int parameterName, const float *parameterValues)
 // sets whether textures replace or modulate
 void FakeGL::TexEnvMode(unsigned int textureMode)
     { // TexEnvMode()
+    if (Record(FAKEGL_OP_TEX_ENV_MODE, textureMode))
+        return;
     texMode = textureMode;
     } // TexEnvMode()
 
 // sets the texture image that corresponds to a given ID
 void FakeGL::TexImage2D(const RGBAImage &textureImage)
     { // TexImage2D()
+    if (compilingList != 0) {
+        displayList &list = displayLists[compilingList - 1];
+        list.textures.push_back(&textureImage);
+        if (Record(FAKEGL_OP_TEX_IMAGE, (uint32_t) list.textures.size() - 1))
+            return;
+    }
     // Texture is a const here as it only allows one texture to be used
     texture = &textureImage;
     } // TexImage2D()
@@ -421,29 +1110,39 @@ void FakeGL::TexImage2D(const RGBAImage &textureImage)
 // clears the frame buffer
 void FakeGL::Clear(unsigned int mask)
     { // Clear()        
+        if (Record(FAKEGL_OP_CLEAR, mask))
+            return;
 
         // If clear color buffer is set
         if (mask & FAKEGL_COLOR_BUFFER_BIT) {
-            for (size_t i = 0; i < frameBuffer.height*frameBuffer.width; i++)
-            {
-                // Update every pixel to be the clear color
-                frameBuffer.block[i].red = fbClearColor.red;
-                frameBuffer.block[i].green = fbClearColor.green;
-                frameBuffer.block[i].blue = fbClearColor.blue;
-                frameBuffer.block[i].alpha = fbClearColor.alpha;
+            // only the screen tiles are marked - the pixels are filled in as they are drawn in
+            long nTiles = ((frameBuffer.width + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE)
+                        * ((frameBuffer.height + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE);
+            colourClearPending.assign(nTiles, 1);
+            colourClearValue = fbClearColor;
+            colourClearWidth = frameBuffer.width;
+            colourClearHeight = frameBuffer.height;
+            clearPending = true;
+            // and anything waiting to be lit is gone too
+            if (deferredPending) {
+                std::fill(gBuffer.material.begin(), gBuffer.material.end(), FAKEGL_NO_MATERIAL);
+                deferredMaterials.clear();
+                deferredPending = false;
             }
         }
         // If clear depth buffer is set
         if (mask & FAKEGL_DEPTH_BUFFER_BIT) {
-            // Reset depth buffer to max value
-            for (size_t i = 0; i < depthBuffer.width*depthBuffer.height; i++)
-                depthBuffer.block[i].alpha = 255;
+            // which likewise only marks its tiles
+            depthBuffer.Clear(depthBuffer.Quantise(depthClearValue));
+            clearPending = true;
         }
     } // Clear()
 
 // sets the clear colour for the frame buffer
 void FakeGL::ClearColor(float red, float green, float blue, float alpha)
     { // ClearColor()
+        if (Record(FAKEGL_OP_CLEAR_COLOR, red, green, blue, alpha))
+            return;
         // Scale up the floats from 0-1 -> 0->255
         fbClearColor.red = red*255.f;
         fbClearColor.green = green*255.f;
@@ -451,78 +1150,498 @@ void FakeGL::ClearColor(float red, float green, float blue, float alpha)
         fbClearColor.alpha = alpha*255.f;
     } // ClearColor()
 
+// sets the depth the depth buffer is cleared to
+void FakeGL::ClearDepth(float depth)
+    { // ClearDepth()
+        if (Record(FAKEGL_OP_CLEAR_DEPTH, depth))
+            return;
+        depthClearValue = std::min(std::max(depth, 0.f), 1.f);
+    } // ClearDepth()
+
+// fills in any clear still waiting in a screen tile, of both buffers
+void FakeGL::ResolveTileClear(long tileRow, long tileCol)
+    { // ResolveTileClear()
+        ResolveColourTileClear(tileRow, tileCol);
+        // the depth buffer's tiles are the same size, so the same pixels
+        depthBuffer.ResolveClear(tileRow, tileCol);
+    } // ResolveTileClear()
+
+// fills in any clear still waiting in a screen tile of the frame buffer
+void FakeGL::ResolveColourTileClear(long tileRow, long tileCol)
+    { // ResolveColourTileClear()
+        // a frame buffer resized since the clear has lost it
+        long nTileCols = (colourClearWidth + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+        size_t tile = tileRow * nTileCols + tileCol;
+        if (colourClearWidth == frameBuffer.width and colourClearHeight == frameBuffer.height
+            and tileCol < nTileCols and tile < colourClearPending.size() and colourClearPending[tile]) {
+            long firstCol = tileCol * FAKEGL_TILE_SIZE;
+            long nCols = std::min((long) FAKEGL_TILE_SIZE, frameBuffer.width - firstCol);
+            long lastRow = std::min((tileRow + 1) * FAKEGL_TILE_SIZE, frameBuffer.height);
+            for (long row = tileRow * FAKEGL_TILE_SIZE; row < lastRow; row++)
+                std::fill_n(frameBuffer.block + row * frameBuffer.width + firstCol, nCols, colourClearValue);
+            colourClearPending[tile] = 0;
+        }
+    } // ResolveColourTileClear()
+
+// fills in the clears still waiting in the tiles the raster queue might cover
+void FakeGL::ResolveQueueClears()
+    { // ResolveQueueClears()
+        if (rasterQueue.empty())
+            return;
+
+        // the bounding box of the whole queue, which for one object is rarely much more than it covers
+        float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+        for (const screenVertexWithAttributes &vertex : rasterQueue) {
+            minX = std::min(minX, vertex.position.x); maxX = std::max(maxX, vertex.position.x);
+            minY = std::min(minY, vertex.position.y); maxY = std::max(maxY, vertex.position.y);
+        }
+
+        // in tiles - anything not a number could go anywhere
+        float reach = PrimitiveReach();
+        long nTileCols = (std::max(frameBuffer.width, depthBuffer.width) + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+        long nTileRows = (std::max(frameBuffer.height, depthBuffer.height) + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+        long firstCol = 0, lastCol = nTileCols - 1, firstRow = 0, lastRow = nTileRows - 1;
+        if (!std::isnan(minX + maxX + minY + maxY)) {
+            firstCol = (long) std::max(0.f, (minX - reach) / FAKEGL_TILE_SIZE);
+            lastCol = (long) std::min((float) lastCol, std::max(-1.f, floorf((maxX + reach) / FAKEGL_TILE_SIZE)));
+            firstRow = (long) std::max(0.f, (minY - reach) / FAKEGL_TILE_SIZE);
+            lastRow = (long) std::min((float) lastRow, std::max(-1.f, floorf((maxY + reach) / FAKEGL_TILE_SIZE)));
+        }
+
+        // the tiles are independent, so the threads can share them
+        long nCols = lastCol - firstCol + 1;
+        if (nCols > 0 and lastRow >= firstRow)
+            threadPool.Run((size_t) (nCols * (lastRow - firstRow + 1)), [&](size_t tile)
+                { // per tile
+                ResolveTileClear(firstRow + (long) tile / nCols, firstCol + (long) tile % nCols);
+                }); // per tile
+    } // ResolveQueueClears()
+
+// fills in the clears still waiting in the frame buffer, which is what gets read
+// the depth buffer's can go on waiting, into the next frame if nothing is drawn there
+void FakeGL::ResolveColourClears()
+    { // ResolveColourClears()
+        if (colourClearWidth == frameBuffer.width and colourClearHeight == frameBuffer.height) {
+            // with nothing drawn since the clear, the whole buffer in one go
+            if (std::all_of(colourClearPending.begin(), colourClearPending.end(), [](char pending) { return pending != 0; }))
+                std::fill_n(frameBuffer.block, (size_t) frameBuffer.width * frameBuffer.height, colourClearValue);
+            else {
+                long nTileCols = (frameBuffer.width + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+                long nTileRows = (frameBuffer.height + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+                threadPool.Run((size_t) (nTileCols * nTileRows), [&](size_t tile)
+                    { // per tile
+                    ResolveColourTileClear((long) tile / nTileCols, (long) tile % nTileCols);
+                    }); // per tile
+            }
+        }
+        colourClearPending.clear();
+    } // ResolveColourClears()
+
+// sets the comparison that decides whether a fragment is drawn
+void FakeGL::DepthFunc(unsigned int func)
+    { // DepthFunc()
+        if (Record(FAKEGL_OP_DEPTH_FUNC, func))
+            return;
+        if (func <= FAKEGL_ALWAYS)
+            depthFunc = func;
+    } // DepthFunc()
+
+// sets the precision of the depth buffer, which is left at the far plane
+void FakeGL::DepthFormat(unsigned int format)
+    { // DepthFormat()
+        depthBuffer.SetFormat(format);
+    } // DepthFormat()
+
+//-------------------------------------------------//
+//                                                 //
+// ROUTINE TO FLUSH THE PIPELINE                   //
+//                                                 //
+//-------------------------------------------------//
+
+// finishes anything the pipeline has left undone
+void FakeGL::Flush()
+    { // Flush()
+        // the tiles of the frame buffer nothing was drawn in still need their clear
+        if (!colourClearPending.empty())
+            ResolveColourClears();
+        // deferred shading leaves its lighting until the frame buffer is wanted
+        if (deferredPending)
+            ResolveDeferredShading();
+    } // Flush()
+
+//-------------------------------------------------//
+//                                                 //
+// CULLING & LEVEL OF DETAIL ROUTINES              //
+//                                                 //
+//-------------------------------------------------//
+
+// true if a sphere is wholly outside what the current matrices show of the frame buffer
+bool FakeGL::CullSphere(float x, float y, float z, float radius)
+    { // CullSphere()
+        float planes[FAKEGL_CLIP_PLANES][4];
+        CullPlanes(planes);
+        for (int plane = 0; plane < FAKEGL_CLIP_PLANES; plane++) {
+            // the planes aren't unit length, so neither is the distance
+            float distance = planes[plane][0] * x + planes[plane][1] * y + planes[plane][2] * z + planes[plane][3];
+            float scale = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1] + planes[plane][2] * planes[plane][2]);
+            if (distance < -radius * scale)
+                return true;
+        }
+        return false;
+    } // CullSphere()
+
+// the same for an axis aligned box
+bool FakeGL::CullBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+    { // CullBox()
+        float planes[FAKEGL_CLIP_PLANES][4];
+        CullPlanes(planes);
+        for (int plane = 0; plane < FAKEGL_CLIP_PLANES; plane++) {
+            // the corner furthest inside the plane is outside only if all of them are
+            float x = planes[plane][0] >= 0.f ? maxX : minX;
+            float y = planes[plane][1] >= 0.f ? maxY : minY;
+            float z = planes[plane][2] >= 0.f ? maxZ : minZ;
+            if (planes[plane][0] * x + planes[plane][1] * y + planes[plane][2] * z + planes[plane][3] < 0.f)
+                return true;
+        }
+        return false;
+    } // CullBox()
+
+// roughly the radius on screen, in pixels, of a sphere
+float FakeGL::ProjectedRadius(float x, float y, float z, float radius)
+    { // ProjectedRadius()
+        const Matrix4 &modelView = mvMatrixStack.top();
+        const Matrix4 &projection = pMatrixStack.top();
+
+        // the modelview matrix may scale, so the radius in VCS is the longest axis' worth
+        float axisScale = 0.f;
+        for (int axis = 0; axis < 3; axis++)
+            axisScale = std::max(axisScale, sqrtf(modelView[0][axis] * modelView[0][axis] + modelView[1][axis] * modelView[1][axis] + modelView[2][axis] * modelView[2][axis]));
+        float radiusVCS = radius * axisScale;
+
+        // w is what perspective divides by, and it is least at the sphere's nearest point
+        Homogeneous4 centreCCS = projection * (modelView * Homogeneous4(x, y, z));
+        float wChange = sqrtf(projection[3][0] * projection[3][0] + projection[3][1] * projection[3][1] + projection[3][2] * projection[3][2]);
+        if (centreCCS.w - radiusVCS * wChange <= 0.f)
+            return INFINITY;
+
+        // how far one unit in VCS moves across the screen, at the centre's distance
+        float pixelsPerUnit = std::max(fabsf(projection[0][0]) * windowWidth, fabsf(projection[1][1]) * windowHeight) / 2.f;
+        return radiusVCS * pixelsPerUnit / centreCCS.w;
+    } // ProjectedRadius()
+
+// picks which of nLevels versions of an object inside a sphere to draw
+unsigned int FakeGL::LevelOfDetail(float x, float y, float z, float radius, const size_t *triangleCounts, unsigned int nLevels)
+    { // LevelOfDetail()
+        if (nLevels == 0)
+            return 0;
+        float pixelRadius = ProjectedRadius(x, y, z, radius);
+        float pixels = (float) M_PI * pixelRadius * pixelRadius;
+
+        // the levels get simpler, so the first with few enough triangles will do
+        for (unsigned int level = 0; level < nLevels; level++)
+            if (triangleCounts[level] * FAKEGL_LOD_PIXELS_PER_TRIANGLE <= pixels)
+                return level;
+        return nLevels - 1;
+    } // LevelOfDetail()
+
 //-------------------------------------------------//
 //                                                 //
 // MAJOR PROCESSING ROUTINES                       //
 //                                                 //
 //-------------------------------------------------//
 
-// transform one vertex & shift to the raster queue
-void FakeGL::TransformVertex()
-    { // TransformVertex()
-        // Get vertex from the queue
-        vertexWithAttributes vert = vertexQueue.front();
-        vertexQueue.pop_front();
+// sets the material parameters named by a Materialfv() style bit mask on one vertex
+static void SetVertexMaterial(unsigned int parameterName, const float *parameterValues, vertexWithAttributes &vert)
+    { // SetVertexMaterial()
+        for (size_t i = 0; i < 4; i++) {
+            if (parameterName & FAKEGL_AMBIENT) vert.amb[i] = parameterValues[i];
+            if (parameterName & FAKEGL_DIFFUSE) vert.diff[i] = parameterValues[i];
+            if (parameterName & FAKEGL_SPECULAR) vert.spec[i] = parameterValues[i];
+            if (parameterName & FAKEGL_EMISSION) vert.emiss[i] = parameterValues[i];
+        }
+    } // SetVertexMaterial()
+
+// fills in a vertex with the current state, as Vertex3f() would
+void FakeGL::CurrentVertex(vertexWithAttributes &vert)
+    { // CurrentVertex()
+        vert.position = Homogeneous4(0.f, 0.f, 0.f);
+        vert.colour.red = drawColor.red;
+        vert.colour.green = drawColor.green;
+        vert.colour.blue = drawColor.blue;
+        vert.colour.alpha = drawColor.alpha;
+        vert.normal = normal;
+
+        for (size_t i = 0; i < 4; i++) {
+            vert.spec[i] = matSpecular[i];
+            vert.amb[i] = matAmbient[i];
+            vert.diff[i] = matDiffuse[i];
+            vert.emiss[i] = matEmission[i];
+        }
+        vert.shin = matShininess;
+
+        vert.texCoord = texCoord;
+    } // CurrentVertex()
+
+// makes a vertex's attributes the current ones, as CurrentVertex() would have made it
+void FakeGL::SetCurrentAttributes(const vertexWithAttributes &vert)
+    { // SetCurrentAttributes()
+        drawColor = vert.colour;
+        normal = vert.normal;
+
+        for (size_t i = 0; i < 4; i++) {
+            matSpecular[i] = vert.spec[i];
+            matAmbient[i] = vert.amb[i];
+            matDiffuse[i] = vert.diff[i];
+            matEmission[i] = vert.emiss[i];
+        }
+        matShininess = vert.shin;
+
+        texCoord = vert.texCoord;
+    } // SetCurrentAttributes()
+
+// fills in vertex index of the enabled arrays, taking anything else from the current state
+void FakeGL::FetchVertex(size_t index, vertexWithAttributes &vert)
+    { // FetchVertex()
+        CurrentVertex(vert);
+
+        if (vertexArray.enabled) {
+            const float *position = vertexArray.Element(index);
+            vert.position = Homogeneous4(position[0], position[1],
+                                         vertexArray.size > 2 ? position[2] : 0.f,
+                                         vertexArray.size > 3 ? position[3] : 1.f);
+        }
+        if (normalArray.enabled) {
+            const float *normalValues = normalArray.Element(index);
+            vert.normal = Cartesian3(normalValues[0], normalValues[1], normalValues[2]);
+        }
+        if (texCoordArray.enabled) {
+            const float *coords = texCoordArray.Element(index);
+            vert.texCoord = Cartesian3(coords[0],
+                                       texCoordArray.size > 1 ? coords[1] : 0.f,
+                                       texCoordArray.size > 2 ? coords[2] : 0.f);
+        }
+        if (colorArray.enabled) {
+            // the same conversion as Color3f()
+            const float *colourValues = colorArray.Element(index);
+            float colour[4] = { colourValues[0], colourValues[1], colourValues[2], colorArray.size > 3 ? colourValues[3] : 1.f };
+            vert.colour.red = colour[0]*255.f;
+            vert.colour.green = colour[1]*255.f;
+            vert.colour.blue = colour[2]*255.f;
+            vert.colour.alpha = colour[3]*255.f;
+            if (colorMaterialEnabled)
+                SetVertexMaterial(colorMaterialParameter, colour, vert);
+        }
+    } // FetchVertex()
+
+// picks the shading kernel, and the varyings & materials the draw's vertices carry for it
+void FakeGL::DeclareVaryings()
+    { // DeclareVaryings()
+        // the state can't change until the draw is over, so pick the shading to suit it now
+        SelectShadingKernel();
+        // Phong triangles can leave their lighting until the visible ones are known
+        // held back fragments are shaded as usual, since they expect a colour
+        varyingsDeferred = deferredShadingEnabled and primType == FAKEGL_TRIANGLES and (shadingKernel & FAKEGL_KERNEL_PHONG) and !deferFragments;
+
+        // then just what the kernel reads, one after another
+        varyingStride = 0;
+        if (shadingKernel & FAKEGL_KERNEL_PHONG) {
+            varyingNormal = varyingStride;
+            varyingEye = varyingStride + 3;
+            varyingStride += 6;
+        }
+        if (shadingKernel & (FAKEGL_KERNEL_REPLACE | FAKEGL_KERNEL_MODULATE)) {
+            varyingTexCoord = varyingStride;
+            varyingStride += 2;
+        }
+        if (varyingsDeferred) {
+            varyingNormalVCS = varyingStride;
+            varyingStride += 3;
+        }
+        // only Phong shading uses the material after the vertices are lit
+        varyingMaterials = (shadingKernel & FAKEGL_KERNEL_PHONG) != 0;
+    } // DeclareVaryings()
+
+// x to the power exponent, for specular highlights, where x is in (0, 1] & exponent > 0
+// as 2^(exponent * log2(x)), each in a few multiplies with no branches, so that a loop of them
+// can be vectorised - to within about 1e-6 of pow(), far finer than a colour step
+static inline float SpecularPower(float x, float exponent)
+    { // SpecularPower()
+        // x = 2^e * m, with m moved into [sqrt(1/2), sqrt(2)) so that log2(m) is near 0
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        int e = (int) (bits >> 23) - 127;
+        uint32_t mantissaBits = (bits & 0x007FFFFFu) | 0x3F800000u;
+        float m;
+        memcpy(&m, &mantissaBits, sizeof(m));
+        int big = m > 1.41421356f;
+        m = big ? m * 0.5f : m;
+        e += big;
+        // log2(m) = 2/ln(2) * (t + t^3/3 + t^5/5 + ...) with t = (m - 1) / (m + 1), at most 0.172
+        float t = (m - 1.f) / (m + 1.f), t2 = t * t;
+        float log2x = (float) e + t * (2.88539008f + t2 * (0.961796694f + t2 * (0.577078016f + t2 * 0.412198583f)));
+
+        // then 2^y = 2^n * 2^f, with n the nearest whole number (y <= 0) & f in [-1/2, 1/2]
+        // anything below 2^-126 is no highlight at all
+        float y = std::max(exponent * log2x, -126.f);
+        int n = -(int) (0.5f - y);
+        float f = y - (float) n;
+        float power = 1.f + f * (0.693147181f + f * (0.240226507f + f * (0.0555041087f
+                    + f * (0.00961812911f + f * (0.00133335581f + f * 0.000154035304f)))));
+        uint32_t scaleBits = (uint32_t) (n + 127) << 23;
+        float scale;
+        memcpy(&scale, &scaleBits, sizeof(scale));
+        return power * scale;
+    } // SpecularPower()
+
+// transforms & lights up to FAKEGL_TRANSFORM_BATCH vertices into their raster queue entries
+void FakeGL::TransformBatch(const vertexWithAttributes *vertices, size_t nVertices, screenVertexWithAttributes *transformed, size_t firstRecord)
+    { // TransformBatch()
+        // the positions & normals go through Matrix4's batched transforms, and the lighting
+        // is gathered into a structure of arrays, so that each step below is one branch free
+        // loop over the batch, the same sums for every vertex, which the compiler vectorises
+        const size_t B = FAKEGL_TRANSFORM_BATCH;
+        const Matrix4 &modelView = shadingModelView, &projection = pMatrixStack.top();
+        bool lit = lightingEnabled and !phongEnabled;
+
+        Homogeneous4 position[B];
+        for (size_t v = 0; v < nVertices; v++)
+            position[v] = vertices[v].position;
 
         // Convert to VCS
-        Homogeneous4 vertVCS = mvMatrixStack.top() * vert.position;
+        Homogeneous4 eye[B];
+        modelView.TransformPoints(position, eye, nVertices);
+
+        // Convert to CCS - in two steps rather than through one combined matrix, which would round
+        // differently & move the odd pixel on the edges of triangles
+        Homogeneous4 ccs[B];
+        projection.TransformPoints(eye, ccs, nVertices);
 
         // Compute Lighting
-        if (lightingEnabled and !phongEnabled) {
-            float totalLight[4] = {0.,0.,0.,0.};
-
-            // Emissive light
-            totalLight[0] += vert.emiss[0];
-            totalLight[1] += vert.emiss[1];
-            totalLight[2] += vert.emiss[2];
-            // totalLight[3] += vert.emiss[3];
-
-            // Ambient Light
-            totalLight[0] += (vert.amb[0]*lightAmbient[0]);
-            totalLight[1] += (vert.amb[1]*lightAmbient[1]);
-            totalLight[2] += (vert.amb[2]*lightAmbient[2]);
-            // totalLight[3] += (vert.amb[3]*lightAmbient[3]);
-
-            // Diffuse Light
-            Cartesian3 norm = mvMatrixStack.top() * vert.normal;
-            Cartesian3 lightDir = lightPosition.Vector();
-            float diffuse = std::max(norm.unit().dot(lightDir.unit()),0.f);
-
-            totalLight[0] += (vert.diff[0] * lightDiffuse[0] * diffuse);
-            totalLight[1] += (vert.diff[1] * lightDiffuse[1] * diffuse);
-            totalLight[2] += (vert.diff[2] * lightDiffuse[2] * diffuse);
-            totalLight[3] += (vert.diff[3]);
-
-            // Specular Light
-            Cartesian3 eyeDir = vertVCS.Vector();
-            Cartesian3 bisecDir = (lightDir+eyeDir)/2.f;
-
-            float specular= 0;
-
-            // If the light is going to hit the surface directly
-            if (norm.dot(lightDir) > 0) {
-                float ndotvb = norm.dot(bisecDir) / (norm.length() * bisecDir.length());
-
-                specular = ndotvb > 0 ? pow(ndotvb,vert.shin*4.) : 0;
+        unsigned char red[B], green[B], blue[B], alpha[B];
+        if (lit) {
+            Cartesian3 normal[B];
+            float shin[B];
+            float emiss[3][B], amb[3][B], diff[4][B], spec[3][B];
+            for (size_t v = 0; v < nVertices; v++) {
+                const vertexWithAttributes &vert = vertices[v];
+                normal[v] = vert.normal;
+                for (size_t i = 0; i < 3; i++) {
+                    emiss[i][v] = vert.emiss[i];
+                    amb[i][v] = vert.amb[i];
+                    spec[i][v] = vert.spec[i];
+                }
+                for (size_t i = 0; i < 4; i++)
+                    diff[i][v] = vert.diff[i];
+                shin[v] = vert.shin;
             }
-            
-            totalLight[0] += (vert.spec[0] * lightSpecular[0] * specular);
-            totalLight[1] += (vert.spec[1] * lightSpecular[1] * specular);
-            totalLight[2] += (vert.spec[2] * lightSpecular[2] * specular);
-            // totalLight[3] += (vert.spec[3] * lightSpecular[3] * specular);
+            // the normal goes through the modelview as a point does, divided through by w
+            modelView.TransformPoints(normal, normal, nVertices);
+
+            const Cartesian3 &lightDir = shadingLightDirection, &lightUnit = shadingLightUnit;
+            float diffuseLight[B], specularLight[B];
+            for (size_t v = 0; v < nVertices; v++) {
+                float normalLength = sqrtf(normal[v].x * normal[v].x + normal[v].y * normal[v].y + normal[v].z * normal[v].z);
+                float diffuse = (normal[v].x * lightUnit.x + normal[v].y * lightUnit.y + normal[v].z * lightUnit.z) / normalLength;
+                diffuseLight[v] = diffuse > 0.f ? diffuse : 0.f;
+
+                // the direction halfway between the light & the eye
+                float bisecX = (lightDir.x + eye[v].x) / 2.f, bisecY = (lightDir.y + eye[v].y) / 2.f, bisecZ = (lightDir.z + eye[v].z) / 2.f;
+                float bisecLength = sqrtf(bisecX * bisecX + bisecY * bisecY + bisecZ * bisecZ);
+                float normalDotLight = normal[v].x * lightDir.x + normal[v].y * lightDir.y + normal[v].z * lightDir.z;
+                float ndotvb = (normal[v].x * bisecX + normal[v].y * bisecY + normal[v].z * bisecZ) / (normalLength * bisecLength);
+                // no highlight unless the light hits the surface directly
+                bool highlight = (normalDotLight > 0.f) & (ndotvb > 0.f);
+                float power = SpecularPower(highlight ? ndotvb : 1.f, shin[v] * 4.f);
+                specularLight[v] = highlight ? power : 0.f;
+            }
+
+            for (size_t v = 0; v < nVertices; v++) {
+                float totalLight[4];
+                for (size_t i = 0; i < 3; i++)
+                    totalLight[i] = emiss[i][v] + amb[i][v] * lightAmbient[i]
+                                  + diff[i][v] * lightDiffuse[i] * diffuseLight[v]
+                                  + spec[i][v] * lightSpecular[i] * specularLight[v];
+                totalLight[3] = diff[3][v];
+
+                // Set vertex color to the lighting color, limiting to range [0,255]
+                red[v] = (unsigned char) std::min(std::max(totalLight[0] * 255.f, 0.f), 255.f);
+                green[v] = (unsigned char) std::min(std::max(totalLight[1] * 255.f, 0.f), 255.f);
+                blue[v] = (unsigned char) std::min(std::max(totalLight[2] * 255.f, 0.f), 255.f);
+                alpha[v] = (unsigned char) std::min(std::max(totalLight[3] * 255.f, 0.f), 255.f);
+            }
+        }
 
-            // Set vertex color to the lighting color, limiting to range [0,255]
-            RGBAValue newVCol;
-            newVCol.red = clamp(totalLight[0] * 255., 0.f, 255.f);
-            newVCol.green = clamp(totalLight[1] * 255., 0.f, 255.f);
-            newVCol.blue = clamp(totalLight[2] * 255., 0.f, 255.f);
-            newVCol.alpha = clamp(totalLight[3] * 255., 0.f, 255.f);
-            vert.colour = newVCol;
+        // Fill in the raster queue's entries
+        for (size_t v = 0; v < nVertices; v++) {
+            const vertexWithAttributes &vert = vertices[v];
+            screenVertexWithAttributes &sVert = transformed[v];
+            size_t record = firstRecord + v;
+            // lighting replaces the colour
+            sVert.colour = lit ? RGBAValue(red[v], green[v], blue[v], alpha[v]) : vert.colour;
+            // a vertex that will be clipped away may have a meaningless DCS position, but it is never used
+            sVert.position = WindowCoordinates(ccs[v]);
+            sVert.clipPosition = ccs[v];
+            sVert.clipCode = ClipCode(ccs[v]);
+            sVert.varying = (uint32_t) record;
+            // the caller sets the material, if the draw has them
+            sVert.material = 0;
+
+            // and copy whichever of the normal, eye position & texture coordinates the draw declared
+            float *varying = varyings.data() + record * varyingStride;
+            if (shadingKernel & FAKEGL_KERNEL_PHONG) {
+                varying[varyingNormal] = vert.normal.x;
+                varying[varyingNormal + 1] = vert.normal.y;
+                varying[varyingNormal + 2] = vert.normal.z;
+                varying[varyingEye] = eye[v].x;
+                varying[varyingEye + 1] = eye[v].y;
+                varying[varyingEye + 2] = eye[v].z;
+            }
+            if (shadingKernel & (FAKEGL_KERNEL_REPLACE | FAKEGL_KERNEL_MODULATE)) {
+                varying[varyingTexCoord] = vert.texCoord.x;
+                varying[varyingTexCoord + 1] = vert.texCoord.y;
+            }
+        }
+    } // TransformBatch()
+
+// fetches & transforms vertices of the arrays
+void FakeGL::TransformArrayVertices(size_t first, size_t nVertices, screenVertexWithAttributes *transformed)
+    { // TransformArrayVertices()
+        varyings.resize(nVertices * varyingStride);
+
+        // every vertex has the current material, unless the colour array changes it
+        bool perVertexMaterials = varyingMaterials and colorMaterialEnabled and colorArray.enabled;
+        if (varyingMaterials) {
+            drawMaterials.resize(perVertexMaterials ? nVertices : 1);
+            if (!perVertexMaterials) {
+                vertexWithAttributes current;
+                CurrentVertex(current);
+                CopyMaterial(current, drawMaterials[0]);
+            }
         }
 
-        // Convert to CCS
-        Homogeneous4 vertCCS = pMatrixStack.top()  * vertVCS;
+        // each vertex is independent, so with several threads they share the work a chunk at a time
+        size_t nChunks = (nVertices + FAKEGL_TRANSFORM_CHUNK - 1) / FAKEGL_TRANSFORM_CHUNK;
+        threadPool.Run(nChunks, [&](size_t chunk)
+            { // per chunk
+            vertexWithAttributes batch[FAKEGL_TRANSFORM_BATCH];
+            size_t end = std::min(nVertices, (chunk + 1) * FAKEGL_TRANSFORM_CHUNK);
+            for (size_t vertex = chunk * FAKEGL_TRANSFORM_CHUNK; vertex < end; vertex += FAKEGL_TRANSFORM_BATCH) {
+                size_t nBatch = std::min(FAKEGL_TRANSFORM_BATCH, end - vertex);
+                for (size_t lane = 0; lane < nBatch; lane++)
+                    FetchVertex(first + vertex + lane, batch[lane]);
+                TransformBatch(batch, nBatch, transformed + vertex, vertex);
+                if (perVertexMaterials)
+                    for (size_t lane = 0; lane < nBatch; lane++) {
+                        CopyMaterial(batch[lane], drawMaterials[vertex + lane]);
+                        transformed[vertex + lane].material = (uint32_t) (vertex + lane);
+                    }
+            }
+            }); // per chunk
+    } // TransformArrayVertices()
 
+// converts a position in CCS to DCS
+Cartesian3 FakeGL::WindowCoordinates(const Homogeneous4 &vertCCS)
+    { // WindowCoordinates()
         // Convert to NDCS
         Cartesian3 vertNDCS(vertCCS.x/vertCCS.w,vertCCS.y/vertCCS.w,vertCCS.z/vertCCS.w);
 
@@ -531,87 +1650,513 @@ void FakeGL::TransformVertex()
         vertDCS.x = ((vertNDCS.x+1) * (windowWidth/2.)) + windowX;
         vertDCS.y = ((vertNDCS.y+1) * (windowHeight/2.)) + windowY;
         vertDCS.z = ((((dFar-dNear)/2.)*vertNDCS.z)+((dFar+dNear)/2.));
+        return vertDCS;
+    } // WindowCoordinates()
+
+// works out the clip planes for the current viewport
+void FakeGL::SetClipPlanes()
+    { // SetClipPlanes()
+        // near: z >= -w, far: z <= w
+        float nearPlane[4] = { 0.f, 0.f, 1.f, 1.f };
+        float farPlane[4] = { 0.f, 0.f, -1.f, 1.f };
+        std::copy(nearPlane, nearPlane + 4, clipPlanes[0]);
+        std::copy(farPlane, farPlane + 4, clipPlanes[1]);
+
+        // the guard band is +/- FAKEGL_GUARD_BAND pixels, which is these x & y in NDCS
+        // an empty viewport leaves the sides unclipped (all zero is inside everywhere)
+        for (int side = 2; side < FAKEGL_CLIP_PLANES; side++)
+            std::fill(clipPlanes[side], clipPlanes[side] + 4, 0.f);
+        if (windowWidth > 0) {
+            clipPlanes[2][0] = 1.f;  clipPlanes[2][3] = -((-FAKEGL_GUARD_BAND - windowX) / (windowWidth / 2.f) - 1.f);
+            clipPlanes[3][0] = -1.f; clipPlanes[3][3] = (FAKEGL_GUARD_BAND - windowX) / (windowWidth / 2.f) - 1.f;
+        }
+        if (windowHeight > 0) {
+            clipPlanes[4][1] = 1.f;  clipPlanes[4][3] = -((-FAKEGL_GUARD_BAND - windowY) / (windowHeight / 2.f) - 1.f);
+            clipPlanes[5][1] = -1.f; clipPlanes[5][3] = (FAKEGL_GUARD_BAND - windowY) / (windowHeight / 2.f) - 1.f;
+        }
+    } // SetClipPlanes()
+
+// works out the planes bounding what can be drawn, in OCS, for culling
+void FakeGL::CullPlanes(float planes[FAKEGL_CLIP_PLANES][4])
+    { // CullPlanes()
+        // in CCS: near & far as for clipping, then the sides of the frame buffer rather than of the
+        // guard band - the frame buffer may reach beyond the viewport, and all of it can be drawn
+        float planesCCS[FAKEGL_CLIP_PLANES][4] = {
+            { 0.f, 0.f, 1.f, 1.f }, { 0.f, 0.f, -1.f, 1.f },
+            { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f } };
+        if (windowWidth > 0) {
+            planesCCS[2][0] = 1.f;  planesCCS[2][3] = -((0.f - windowX) / (windowWidth / 2.f) - 1.f);
+            planesCCS[3][0] = -1.f; planesCCS[3][3] = ((float) frameBuffer.width - windowX) / (windowWidth / 2.f) - 1.f;
+        }
+        if (windowHeight > 0) {
+            planesCCS[4][1] = 1.f;  planesCCS[4][3] = -((0.f - windowY) / (windowHeight / 2.f) - 1.f);
+            planesCCS[5][1] = -1.f; planesCCS[5][3] = ((float) frameBuffer.height - windowY) / (windowHeight / 2.f) - 1.f;
+        }
 
-        // Add to raster Queue
-        screenVertexWithAttributes sVert;
-        sVert.colour = vert.colour;
-        sVert.position = Cartesian3(vertDCS.x,vertDCS.y,vertDCS.z);
-        sVert.texCoord = vert.texCoord;
+        // a plane p in CCS is p M in OCS, where M takes OCS to CCS
+        Matrix4 objectToClip = pMatrixStack.top() * mvMatrixStack.top();
+        for (int plane = 0; plane < FAKEGL_CLIP_PLANES; plane++)
+            for (int column = 0; column < 4; column++) {
+                planes[plane][column] = 0.f;
+                for (int row = 0; row < 4; row++)
+                    planes[plane][column] += planesCCS[plane][row] * objectToClip[row][column];
+            }
+    } // CullPlanes()
+
+// the clip planes a position in CCS is outside, one bit each
+unsigned int FakeGL::ClipCode(const Homogeneous4 &vertCCS)
+    { // ClipCode()
+        unsigned int code = 0;
+        for (int plane = 0; plane < FAKEGL_CLIP_PLANES; plane++) {
+            const float *p = clipPlanes[plane];
+            // written so that NaNs count as inside, and are left to the rasteriser as before
+            if (p[0] * vertCCS.x + p[1] * vertCCS.y + p[2] * vertCCS.z + p[3] * vertCCS.w < 0.f)
+                code |= 1u << plane;
+        }
+        return code;
+    } // ClipCode()
+
+// the vertex a fraction t of the way from one vertex to another, in CCS
+void FakeGL::InterpolateVertex(const screenVertexWithAttributes &from, const screenVertexWithAttributes &to, float t, screenVertexWithAttributes &result)
+    { // InterpolateVertex()
+        // every attribute is linear in CCS, so they all move together
+        result.clipPosition = from.clipPosition + t * (to.clipPosition - from.clipPosition);
+        result.colour = (1.f - t) * from.colour + t * to.colour;
+
+        // the new vertex has a record of varyings of its own, on the end
+        size_t fromRecord = from.varying, toRecord = to.varying;
+        size_t record = (varyingStride == 0) ? 0 : varyings.size() / varyingStride;
+        varyings.resize(varyings.size() + varyingStride);
+        const float *fromVarying = varyings.data() + fromRecord * varyingStride;
+        const float *toVarying = varyings.data() + toRecord * varyingStride;
+        float *varying = varyings.data() + record * varyingStride;
+        for (size_t i = 0; i < varyingStride; i++)
+            varying[i] = fromVarying[i] + t * (toVarying[i] - fromVarying[i]);
+        result.varying = (uint32_t) record;
+
+        // and only needs a new material if it lies between two different ones
+        uint32_t fromMaterial = from.material, toMaterial = to.material;
+        if (varyingMaterials and fromMaterial != toMaterial) {
+            const vertexMaterial &material0 = drawMaterials[fromMaterial], &material1 = drawMaterials[toMaterial];
+            vertexMaterial material;
+            for (size_t i = 0; i < 4; i++)
+            {
+                material.amb[i] = material0.amb[i] + t * (material1.amb[i] - material0.amb[i]);
+                material.diff[i] = material0.diff[i] + t * (material1.diff[i] - material0.diff[i]);
+                material.spec[i] = material0.spec[i] + t * (material1.spec[i] - material0.spec[i]);
+                material.emiss[i] = material0.emiss[i] + t * (material1.emiss[i] - material0.emiss[i]);
+            }
+            material.shin = material0.shin + t * (material1.shin - material0.shin);
+            drawMaterials.push_back(material);
+            result.material = (uint32_t) drawMaterials.size() - 1;
+        }
+        else
+            result.material = fromMaterial;
+
+        // a new vertex lies on a clip plane, so rounding must not push it out of the depth range
+        result.position = WindowCoordinates(result.clipPosition);
+        result.position.z = clamp(result.position.z, std::min(dNear, dFar), std::max(dNear, dFar));
+        result.clipCode = 0;
+    } // InterpolateVertex()
+
+// clips the complete primitives in the raster queue
+void FakeGL::ClipPrimitives()
+    { // ClipPrimitives()
+        size_t perPrimitive = VerticesPerPrimitive();
+        if (perPrimitive == 0)
+            return;
+        size_t nVertices = (rasterQueue.size() / perPrimitive) * perPrimitive;
 
-        // Copy normal and material properties
-        sVert.normal = vert.normal;
-        for (size_t i = 0; i < 4; i++)
-        {
-            sVert.amb[i] = vert.amb[i];
-            sVert.diff[i] = vert.diff[i];
-            sVert.spec[i] = vert.spec[i];
-            sVert.emiss[i] = vert.emiss[i];
+        // nearly every batch is wholly inside, and is left where it is
+        bool anyOutside = false;
+        for (size_t vertex = 0; vertex < nVertices and !anyOutside; vertex++)
+            anyOutside = rasterQueue[vertex].clipCode != 0;
+        if (!anyOutside)
+            return;
+
+        // otherwise the batch is rebuilt in order, so the image is the same as clipping each primitive as it is drawn
+        clippedQueue.clear();
+        screenVertexWithAttributes polygon[FAKEGL_MAX_CLIPPED_VERTICES];
+        for (size_t first = 0; first < nVertices; first += perPrimitive) {
+            unsigned int inside = ~0u, outside = 0u;
+            for (size_t vertex = first; vertex < first + perPrimitive; vertex++) {
+                inside &= rasterQueue[vertex].clipCode;
+                outside |= rasterQueue[vertex].clipCode;
+            }
+
+            // wholly inside: kept as it is
+            if (outside == 0) {
+                clippedQueue.insert(clippedQueue.end(), rasterQueue.begin() + first, rasterQueue.begin() + first + perPrimitive);
+                continue;
+            }
+            // all vertices outside the same plane: nothing of it is left (this is all points can be)
+            if (inside != 0 or primType == FAKEGL_POINTS)
+                continue;
+
+            if (primType == FAKEGL_LINES) {
+                // move each end in to the last plane it crosses
+                const screenVertexWithAttributes &vertex0 = rasterQueue[first], &vertex1 = rasterQueue[first + 1];
+                float t0 = 0.f, t1 = 1.f;
+                for (int plane = 0; plane < FAKEGL_CLIP_PLANES; plane++) {
+                    if (!(outside & (1u << plane)))
+                        continue;
+                    const float *p = clipPlanes[plane];
+                    float distance0 = p[0] * vertex0.clipPosition.x + p[1] * vertex0.clipPosition.y + p[2] * vertex0.clipPosition.z + p[3] * vertex0.clipPosition.w;
+                    float distance1 = p[0] * vertex1.clipPosition.x + p[1] * vertex1.clipPosition.y + p[2] * vertex1.clipPosition.z + p[3] * vertex1.clipPosition.w;
+                    float crossing = distance0 / (distance0 - distance1);
+                    if (distance0 < 0.f) t0 = std::max(t0, crossing);
+                    if (distance1 < 0.f) t1 = std::min(t1, crossing);
+                }
+                // the line passes outside a corner of the clip volume
+                if (t0 >= t1)
+                    continue;
+                clippedQueue.push_back(vertex0);
+                if (vertex0.clipCode != 0)
+                    InterpolateVertex(vertex0, vertex1, t0, clippedQueue.back());
+                clippedQueue.push_back(vertex1);
+                if (vertex1.clipCode != 0)
+                    InterpolateVertex(vertex0, vertex1, t1, clippedQueue.back());
+                continue;
+            }
+
+            // a triangle becomes a convex polygon, which goes back as a fan of triangles
+            for (int vertex = 0; vertex < 3; vertex++)
+                polygon[vertex] = rasterQueue[first + vertex];
+            int nPolygon = ClipPolygon(polygon, 3, outside);
+            for (int vertex = 1; vertex + 1 < nPolygon; vertex++) {
+                clippedQueue.push_back(polygon[0]);
+                clippedQueue.push_back(polygon[vertex]);
+                clippedQueue.push_back(polygon[vertex + 1]);
+            }
         }
-        sVert.shin = vert.shin;
-        
-        sVert.ePos = vertVCS;
 
-        rasterQueue.push_back(sVert);
-    } // TransformVertex()
+        // any incomplete primitive stays queued after the rest
+        clippedQueue.insert(clippedQueue.end(), rasterQueue.begin() + nVertices, rasterQueue.end());
+        rasterQueue.swap(clippedQueue);
+    } // ClipPrimitives()
+
+// clips a convex polygon to the planes in clipCode, returning the number of vertices left
+int FakeGL::ClipPolygon(screenVertexWithAttributes *polygon, int nVertices, unsigned int clipCode)
+    { // ClipPolygon()
+        // Sutherland-Hodgman: one plane at a time, keeping the vertices inside & adding one where each edge crosses
+        screenVertexWithAttributes clipped[FAKEGL_MAX_CLIPPED_VERTICES];
+        float distance[FAKEGL_MAX_CLIPPED_VERTICES];
+        for (int plane = 0; plane < FAKEGL_CLIP_PLANES and nVertices >= 3; plane++) {
+            if (!(clipCode & (1u << plane)))
+                continue;
+            const float *p = clipPlanes[plane];
+            for (int vertex = 0; vertex < nVertices; vertex++) {
+                const Homogeneous4 &position = polygon[vertex].clipPosition;
+                distance[vertex] = p[0] * position.x + p[1] * position.y + p[2] * position.z + p[3] * position.w;
+            }
+
+            int nClipped = 0;
+            for (int vertex = 0; vertex < nVertices; vertex++) {
+                int next = (vertex + 1) % nVertices;
+                if (distance[vertex] >= 0.f)
+                    clipped[nClipped++] = polygon[vertex];
+                // the edge crosses the plane
+                if ((distance[vertex] >= 0.f) != (distance[next] >= 0.f))
+                    InterpolateVertex(polygon[vertex], polygon[next], distance[vertex] / (distance[vertex] - distance[next]), clipped[nClipped++]);
+            }
+
+            std::copy(clipped, clipped + nClipped, polygon);
+            nVertices = nClipped;
+        }
+        return nVertices;
+    } // ClipPolygon()
+
+// drops the complete triangles in the raster queue that can't draw anything, or face the wrong way
+void FakeGL::CullTriangles()
+    { // CullTriangles()
+        size_t nVertices = (rasterQueue.size() / 3) * 3;
+        const float subpixelScale = (float)(1 << FAKEGL_SUBPIXEL_BITS);
+        // the floating point rasteriser's pixels are only ever tested, so it is given a little room for rounding
+        const float margin = 1.f / subpixelScale;
+
+        // triangles that are kept slide down over the ones that aren't, so the order is unchanged
+        size_t kept = 0;
+        for (size_t first = 0; first < nVertices; first += 3) {
+            const screenVertexWithAttributes *triangle = &rasterQueue[first];
+            float minX = std::min(triangle[0].position.x, std::min(triangle[1].position.x, triangle[2].position.x));
+            float maxX = std::max(triangle[0].position.x, std::max(triangle[1].position.x, triangle[2].position.x));
+            float minY = std::min(triangle[0].position.y, std::min(triangle[1].position.y, triangle[2].position.y));
+            float maxY = std::max(triangle[0].position.y, std::max(triangle[1].position.y, triangle[2].position.y));
+
+            // anything not a number is left to the rasteriser
+            bool drop = false;
+            if (std::isfinite(minX + maxX + minY + maxY)) {
+                // the area's sign says which way the triangle faces, and it has to be the one the rasteriser
+                // will see - so where the fixed point rasteriser will draw it, it is worked out the same way
+                double area;
+                if (!floatRasteriser and std::max(-minX, maxX) < FAKEGL_FIXED_POINT_LIMIT and std::max(-minY, maxY) < FAKEGL_FIXED_POINT_LIMIT) {
+                    int64_t vertexX[3], vertexY[3];
+                    for (int vertex = 0; vertex < 3; vertex++) {
+                        vertexX[vertex] = (int64_t) floor(triangle[vertex].position.x * subpixelScale + 0.5f);
+                        vertexY[vertex] = (int64_t) floor(triangle[vertex].position.y * subpixelScale + 0.5f);
+                    }
+                    int64_t fixedArea = (vertexX[1] - vertexX[0]) * (vertexY[2] - vertexY[0]) - (vertexY[1] - vertexY[0]) * (vertexX[2] - vertexX[0]);
+                    area = (double) fixedArea;
+
+                    // no area, or no pixel centre - which are at whole numbers - inside the bounding box
+                    // (the same pixels the fixed point rasteriser would look at)
+                    int64_t minSnappedX = std::min(vertexX[0], std::min(vertexX[1], vertexX[2]));
+                    int64_t maxSnappedX = std::max(vertexX[0], std::max(vertexX[1], vertexX[2]));
+                    int64_t minSnappedY = std::min(vertexY[0], std::min(vertexY[1], vertexY[2]));
+                    int64_t maxSnappedY = std::max(vertexY[0], std::max(vertexY[1], vertexY[2]));
+                    drop = fixedArea == 0
+                        or ((minSnappedX + (1 << FAKEGL_SUBPIXEL_BITS) - 1) >> FAKEGL_SUBPIXEL_BITS) > (maxSnappedX >> FAKEGL_SUBPIXEL_BITS)
+                        or ((minSnappedY + (1 << FAKEGL_SUBPIXEL_BITS) - 1) >> FAKEGL_SUBPIXEL_BITS) > (maxSnappedY >> FAKEGL_SUBPIXEL_BITS);
+                }
+                else {
+                    area = ((double) triangle[1].position.x - triangle[0].position.x) * ((double) triangle[2].position.y - triangle[0].position.y)
+                         - ((double) triangle[1].position.y - triangle[0].position.y) * ((double) triangle[2].position.x - triangle[0].position.x);
+                    drop = ceilf(minX - margin) > floorf(maxX + margin) or ceilf(minY - margin) > floorf(maxY + margin);
+                }
+
+                // counter-clockwise triangles have a positive area
+                if (cullFaceEnabled and area != 0.0) {
+                    bool front = (area > 0.0) == (frontFace == FAKEGL_CCW);
+                    drop = drop or (cullFaceMode & (front ? FAKEGL_FRONT : FAKEGL_BACK)) != 0;
+                }
+            }
+
+            if (drop) {
+                setupCulledTriangles++;
+                continue;
+            }
+            if (kept != first)
+                std::copy(rasterQueue.begin() + first, rasterQueue.begin() + first + 3, rasterQueue.begin() + kept);
+            kept += 3;
+        }
+
+        // any incomplete triangle stays queued after the rest
+        if (kept != nVertices)
+            rasterQueue.erase(rasterQueue.begin() + kept, rasterQueue.begin() + nVertices);
+    } // CullTriangles()
 
 // rasterise a single primitive if there are enough vertices on the queue
-bool FakeGL::RasterisePrimitive()
+bool FakeGL::RasterisePrimitive(size_t &nextVertex, const rasterRectangle &clip)
     { // RasterisePrimitive()
-    
+        // the vertices are used where they sit in the queue rather than copied out
+        size_t remaining = rasterQueue.size() - nextVertex;
+
         // One code path for each primitive type
 
         if (primType == FAKEGL_POINTS) {
             // If there are enough vertices queued for a point (1 vertex)
-            if (rasterQueue.size() < 1) return false;
-            // Rasterise the point and remove the processed vertex from the queue
-            RasterisePoint(rasterQueue.front());
-            rasterQueue.pop_front();
-        }
-        if (primType == FAKEGL_LINES) {
-            if (rasterQueue.size() < 2) return false;
-            screenVertexWithAttributes v0,v1;
-            v0 = rasterQueue.front(); rasterQueue.pop_front();
-            v1 = rasterQueue.front(); rasterQueue.pop_front();
-            RasteriseLineSegment(v0,v1);
-        }
-        if (primType == FAKEGL_TRIANGLES) {
-            if (rasterQueue.size() < 3) return false;
-            screenVertexWithAttributes v0,v1,v2;
-            v0 = rasterQueue.front(); rasterQueue.pop_front();
-            v1 = rasterQueue.front(); rasterQueue.pop_front();
-            v2 = rasterQueue.front(); rasterQueue.pop_front();
-            RasteriseTriangle(v0,v1,v2);
-
+            if (remaining < 1) return false;
+            // Rasterise the point and step past the processed vertex
+            RasterisePoint(rasterQueue[nextVertex], clip);
+            nextVertex += 1;
+        }
+        else if (primType == FAKEGL_LINES) {
+            if (remaining < 2) return false;
+            RasteriseLineSegment(rasterQueue[nextVertex], rasterQueue[nextVertex+1], clip);
+            nextVertex += 2;
         }
+        else if (primType == FAKEGL_TRIANGLES) {
+            if (remaining < 3) return false;
+            RasteriseTriangle(rasterQueue[nextVertex], rasterQueue[nextVertex+1], rasterQueue[nextVertex+2], clip);
+            nextVertex += 3;
+        }
+        else
+            return false;
         return true;
     } // RasterisePrimitive()
 
+// the number of queued vertices each primitive uses
+size_t FakeGL::VerticesPerPrimitive()
+    { // VerticesPerPrimitive()
+        if (primType == FAKEGL_POINTS) return 1;
+        if (primType == FAKEGL_LINES) return 2;
+        if (primType == FAKEGL_TRIANGLES) return 3;
+        return 0;
+    } // VerticesPerPrimitive()
+
+// the pixels of one screen tile
+rasterRectangle FakeGL::TileRectangle(size_t tile)
+    { // TileRectangle()
+        rasterRectangle rectangle;
+        rectangle.minCol = (int) (tile % nTileCols) * FAKEGL_TILE_SIZE;
+        rectangle.minRow = (int) (tile / nTileCols) * FAKEGL_TILE_SIZE;
+        rectangle.maxCol = std::min(rectangle.minCol + FAKEGL_TILE_SIZE, (int) frameBuffer.width) - 1;
+        rectangle.maxRow = std::min(rectangle.minRow + FAKEGL_TILE_SIZE, (int) frameBuffer.height) - 1;
+        return rectangle;
+    } // TileRectangle()
+
+// how far the pixels of a primitive can reach beyond its vertices
+float FakeGL::PrimitiveReach()
+    { // PrimitiveReach()
+        float reach = 1.f;
+        if (primType == FAKEGL_POINTS) reach += pointSize;
+        if (primType == FAKEGL_LINES) reach += lineWidth;
+        return reach;
+    } // PrimitiveReach()
+
+// sorts the complete primitives in the raster queue into the tiles they might cover
+size_t FakeGL::BinPrimitives()
+    { // BinPrimitives()
+        nTileCols = (frameBuffer.width + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+        nTileRows = (frameBuffer.height + FAKEGL_TILE_SIZE - 1) / FAKEGL_TILE_SIZE;
+        // clearing keeps each bin's memory for the next time round
+        tileBins.resize(nTileCols * nTileRows);
+        for (std::vector<uint32_t> &bin : tileBins)
+            bin.clear();
+
+        size_t perPrimitive = VerticesPerPrimitive();
+        if (perPrimitive == 0)
+            return 0;
+        size_t nPrimitives = rasterQueue.size() / perPrimitive;
+
+        float reach = PrimitiveReach();
+
+        for (size_t primitive = 0; primitive < nPrimitives; primitive++) {
+            // the bounding box of the vertices, grown by the reach
+            float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+            for (size_t vertex = primitive * perPrimitive; vertex < (primitive + 1) * perPrimitive; vertex++) {
+                const Cartesian3 &position = rasterQueue[vertex].position;
+                minX = std::min(minX, position.x); maxX = std::max(maxX, position.x);
+                minY = std::min(minY, position.y); maxY = std::max(maxY, position.y);
+            }
+
+            // in tiles, clamped to the screen - anything not a number goes everywhere, like the rasteriser
+            int firstCol = 0, lastCol = nTileCols - 1, firstRow = 0, lastRow = nTileRows - 1;
+            if (!std::isnan(minX + maxX + minY + maxY)) {
+                if (maxX + reach < 0 or maxY + reach < 0 or minX - reach >= frameBuffer.width or minY - reach >= frameBuffer.height)
+                    continue;
+                firstCol = (int) std::max(0.f, (minX - reach) / FAKEGL_TILE_SIZE);
+                lastCol = (int) std::min((float) (nTileCols - 1), (maxX + reach) / FAKEGL_TILE_SIZE);
+                firstRow = (int) std::max(0.f, (minY - reach) / FAKEGL_TILE_SIZE);
+                lastRow = (int) std::min((float) (nTileRows - 1), (maxY + reach) / FAKEGL_TILE_SIZE);
+            }
+
+            for (int row = firstRow; row <= lastRow; row++)
+                for (int col = firstCol; col <= lastCol; col++)
+                    tileBins[row * nTileCols + col].push_back((uint32_t) primitive);
+        }
+        return nPrimitives;
+    } // BinPrimitives()
+
+// sets how many threads render, counting the calling thread
+void FakeGL::RenderThreads(unsigned int nThreads)
+    { // RenderThreads()
+        if (nThreads == 0)
+            nThreads = std::max(1u, std::thread::hardware_concurrency());
+        threadPool.Resize(nThreads);
+    } // RenderThreads()
+
 // rasterises a single point
-void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0)
+void FakeGL::RasterisePoint(screenVertexWithAttributes &vertex0, const rasterRectangle &clip)
     { // RasterisePoint()
-        // Generate a point fragment that is at the position of the vertex
-        fragmentWithAttributes newFrag;
-        newFrag.colour = vertex0.colour;
-        newFrag.depth = vertex0.position.z;
-        newFrag.normal = vertex0.normal;
+        // a point is a square of one colour & depth, so it is written a row at a time
+        if (!std::isfinite(vertex0.position.x + vertex0.position.y))
+            return;
 
         // Find point 'radius'
         unsigned int halfPSize = (unsigned int) floor(pointSize/2.);
-        // Add a fragment for each pixel in the point to the fragment queue
-        for (size_t xi = 0; xi < pointSize; xi++)
-            for (size_t yi = 0; yi < pointSize; yi++)
-            {
-                newFrag.row = vertex0.position.y - halfPSize+yi;
-                newFrag.col = vertex0.position.x - halfPSize+xi;
-                fragmentQueue.push_back(newFrag);
-            }
-        
+        long firstRow = (long) floorf(vertex0.position.y - halfPSize);
+        long firstCol = (long) floorf(vertex0.position.x - halfPSize);
+        // pixels outside the clip rectangle belong to somebody else (or nobody)
+        long minRow = std::max(firstRow, (long) clip.minRow), maxRow = std::min(firstRow + (long) pointSize - 1, (long) clip.maxRow);
+        long minCol = std::max(firstCol, (long) clip.minCol), maxCol = std::min(firstCol + (long) pointSize - 1, (long) clip.maxCol);
+        if (minCol > maxCol)
+            return;
 
+        for (long row = minRow; row <= maxRow; row++)
+            WriteSpan(row, minCol, maxCol - minCol + 1, false, vertex0.position.z, vertex0.colour);
     } // RasterisePoint()
 
+// a value in the line rasteriser's fixed point
+static int64_t LineFixed(double value)
+    { // LineFixed()
+        return (int64_t) llround(value * (double) ((int64_t) 1 << FAKEGL_LINE_FRACTION_BITS));
+    } // LineFixed()
+
 // rasterises a single line segment
-void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1)
+void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, const rasterRectangle &clip)
     { // RasteriseLineSegment()
+        // lighting & texturing per pixel need every varying, which the triangle rasteriser interpolates
+        if (shadingKernel & ~FAKEGL_KERNEL_DEPTH_TEST) {
+            RasteriseLineQuad(vertex0, vertex1, clip);
+            return;
+        }
+        if (!std::isfinite(vertex0.position.x + vertex0.position.y + vertex1.position.x + vertex1.position.y))
+            return;
+
+        // the line is stepped a pixel at a time along whichever axis it moves further in (the major axis),
+        // and a line wider than a pixel is a span that many pixels long across the other (minor) axis
+        bool xMajor = fabsf(vertex1.position.x - vertex0.position.x) >= fabsf(vertex1.position.y - vertex0.position.y);
+        double major0 = xMajor ? vertex0.position.x : vertex0.position.y, major1 = xMajor ? vertex1.position.x : vertex1.position.y;
+        double minor0 = xMajor ? vertex0.position.y : vertex0.position.x, minor1 = xMajor ? vertex1.position.y : vertex1.position.x;
+        long minMajor = xMajor ? clip.minCol : clip.minRow, maxMajor = xMajor ? clip.maxCol : clip.maxRow;
+        long minMinor = xMajor ? clip.minRow : clip.minCol, maxMinor = xMajor ? clip.maxRow : clip.maxCol;
+
+        // pixel centres are at whole numbers: the line covers those from the one nearest its start up to,
+        // but not including, the one nearest its end - so segments joined end to end share no pixel
+        long start = (long) floor(major0 + 0.5), end = (long) floor(major1 + 0.5);
+        long step = end >= start ? 1 : -1;
+        long count = (end - start) * step;
+        if (count == 0)
+            return;
+
+        // only the steps that land inside the clip rectangle are taken
+        long firstStep = step > 0 ? std::max(0L, minMajor - start) : std::max(0L, start - maxMajor);
+        long lastStep = step > 0 ? std::min(count - 1, maxMajor - start) : std::min(count - 1, start - minMajor);
+        if (firstStep > lastStep)
+            return;
+
+        // everything is stepped in fixed point, from its value at the first pixel - and a value at any step is
+        // its start plus a whole number of steps, so a tile starting part way along gets exactly the same pixels
+        double startT = (start - major0) / (major1 - major0), stepT = step / (major1 - major0);
+        auto stepper = [&](double value0, double value1, int64_t &value, int64_t &delta)
+            { // stepper
+            delta = LineFixed(stepT * (value1 - value0));
+            value = LineFixed(value0 + startT * (value1 - value0)) + firstStep * delta;
+            }; // stepper
+        int64_t minor, minorStep, depth, depthStep, colour[4], colourStep[4];
+        stepper(minor0, minor1, minor, minorStep);
+        stepper(vertex0.position.z, vertex1.position.z, depth, depthStep);
+        const RGBAValue &colour0 = vertex0.colour, &colour1 = vertex1.colour;
+        double channel0[4] = { (double) colour0.red, (double) colour0.green, (double) colour0.blue, (double) colour0.alpha };
+        double channel1[4] = { (double) colour1.red, (double) colour1.green, (double) colour1.blue, (double) colour1.alpha };
+        for (int i = 0; i < 4; i++)
+            stepper(channel0[i], channel1[i], colour[i], colourStep[i]);
+        // a line of one colour, the usual case, never changes it
+        bool oneColour = std::equal(channel0, channel0 + 4, channel1);
+        RGBAValue pixelColour = vertex0.colour;
+
+        const int64_t half = (int64_t) 1 << (FAKEGL_LINE_FRACTION_BITS - 1);
+        const double fixedUnit = 1.0 / (double) ((int64_t) 1 << FAKEGL_LINE_FRACTION_BITS);
+        // the span across the line starts this many pixels before the one the line passes through
+        long halfWidth = lineWidth / 2;
+        long majorPixel = start + firstStep * step;
+        for (long stepIndex = firstStep; stepIndex <= lastStep; stepIndex++) {
+            // rounding to the nearest pixel centre
+            long firstMinor = (long) ((minor + half) >> FAKEGL_LINE_FRACTION_BITS) - halfWidth;
+            long spanStart = std::max(firstMinor, minMinor), spanEnd = std::min(firstMinor + (long) lineWidth - 1, maxMinor);
+            if (spanStart <= spanEnd) {
+                if (!oneColour)
+                    pixelColour = RGBAValue((float) (colour[0] >> FAKEGL_LINE_FRACTION_BITS), (float) (colour[1] >> FAKEGL_LINE_FRACTION_BITS),
+                                            (float) (colour[2] >> FAKEGL_LINE_FRACTION_BITS), (float) (colour[3] >> FAKEGL_LINE_FRACTION_BITS));
+                float pixelDepth = (float) (depth * fixedUnit);
+                if (xMajor)
+                    WriteSpan(spanStart, majorPixel, spanEnd - spanStart + 1, true, pixelDepth, pixelColour);
+                else
+                    WriteSpan(majorPixel, spanStart, spanEnd - spanStart + 1, false, pixelDepth, pixelColour);
+            }
+
+            majorPixel += step;
+            minor += minorStep;
+            depth += depthStep;
+            for (int i = 0; i < 4; i++)
+                colour[i] += colourStep[i];
+        }
+    } // RasteriseLineSegment()
+
+// rasterises a single line segment as two triangles, for lines lit or textured per pixel
+void FakeGL::RasteriseLineQuad(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, const rasterRectangle &clip)
+    { // RasteriseLineQuad()
         Cartesian3 vector01 = vertex1.position - vertex0.position;
         Cartesian3 normal01(-vector01.y, vector01.x, 0.0);
         // normalise
@@ -627,48 +2172,583 @@ void FakeGL::RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVer
         c0.position = vertex0.position + (normal01 * (halfLineWidth+widthMod));
         c1.position = vertex0.position - (normal01 * (halfLineWidth));
         c0.colour = vertex0.colour; c1.colour = vertex0.colour;
-        c0.normal = vertex0.normal; c1.normal = vertex0.normal;
 
         c2.position = vertex1.position - (normal01 * halfLineWidth);
         c3.position = vertex1.position + (normal01 * (halfLineWidth+widthMod));
         c2.colour = vertex1.colour; c3.colour = vertex1.colour;
-        c2.normal = vertex1.normal; c3.normal = vertex1.normal;
 
-        // Copy color properties
-        for (size_t i = 0; i < 4; i++)
-        {
-            c0.amb[i] = vertex0.amb[i];
-            c0.diff[i] = vertex0.diff[i];
-            c0.spec[i] = vertex0.spec[i];
-            c0.emiss[i] = vertex0.emiss[i];
-            c1.amb[i] = vertex0.amb[i];
-            c1.diff[i] = vertex0.diff[i];
-            c1.spec[i] = vertex0.spec[i];
-            c1.emiss[i] = vertex0.emiss[i];
-            c2.amb[i] = vertex1.amb[i];
-            c2.diff[i] = vertex1.diff[i];
-            c2.spec[i] = vertex1.spec[i];
-            c2.emiss[i] = vertex1.emiss[i];
-            c3.amb[i] = vertex1.amb[i];
-            c3.diff[i] = vertex1.diff[i];
-            c3.spec[i] = vertex1.spec[i];
-            c3.emiss[i] = vertex1.emiss[i];
-        }
-        c0.shin = vertex0.shin;
-        c1.shin = vertex0.shin;
-        c2.shin = vertex1.shin;
-        c3.shin = vertex1.shin;
-        
+        // each end's varyings & material do for the two corners made from it
+        c0.varying = vertex0.varying; c1.varying = vertex0.varying;
+        c2.varying = vertex1.varying; c3.varying = vertex1.varying;
+        c0.material = vertex0.material; c1.material = vertex0.material;
+        c2.material = vertex1.material; c3.material = vertex1.material;
+        c0.materialId = c1.materialId = c2.materialId = c3.materialId = FAKEGL_NO_MATERIAL;
+
 
         // rasterise the triangles using the four corners
-        RasteriseTriangle(c0,c1,c2);
-        RasteriseTriangle(c0,c2,c3);
+        RasteriseTriangle(c0,c1,c2,clip);
+        RasteriseTriangle(c0,c2,c3,clip);
+
+    } // RasteriseLineQuad()
+
+// writes a run of pixels of one depth & colour, in a row or a column, as ProcessFragment() would one at a time
+void FakeGL::WriteSpan(long row, long col, long count, bool vertical, float depth, const RGBAValue &colour)
+    { // WriteSpan()
+        // held back fragments have to wait their turn like any other
+        if (deferFragments) {
+            fragmentWithAttributes fragment;
+            fragment.colour = colour;
+            fragment.depth = depth;
+            for (long pixel = 0; pixel < count; pixel++) {
+                fragment.row = vertical ? row + pixel : row;
+                fragment.col = vertical ? col : col + pixel;
+                EmitFragment(fragment);
+            }
+            return;
+        }
 
-    } // RasteriseLineSegment()
+        // the whole span is in or out of the depth range together
+        if (depth < dNear or depth > dFar)
+            return;
+        // and its depth is only quantised once
+        uint32_t fragDepth = dBufferingEnabled ? depthBuffer.Quantise((depth - dNear)/(dFar-dNear)) : 0;
+        // pixels drawn over ones waiting for deferred shading aren't lit after all
+        bool deferredHere = deferredPending and gBuffer.width == frameBuffer.width and gBuffer.height == frameBuffer.height;
+
+        size_t index = (size_t) row * frameBuffer.width + col;
+        size_t stride = vertical ? (size_t) frameBuffer.width : 1;
+        unsigned long long written = 0;
+        for (long pixel = 0; pixel < count; pixel++, index += stride) {
+            if (dBufferingEnabled) {
+                uint32_t &storedDepth = depthBuffer.At(vertical ? row + pixel : row, vertical ? col : col + pixel);
+                if (!DepthPasses(fragDepth, storedDepth))
+                    continue;
+                storedDepth = fragDepth;
+            }
+            if (deferredHere)
+                gBuffer.material[index] = FAKEGL_NO_MATERIAL;
+            frameBuffer.block[index] = colour;
+            written++;
+        }
+        if (countFragments)
+            fragmentCount += written;
+    } // WriteSpan()
+
+// one rasteriser for each combination of FAKEGL_KERNEL_ flags, indexed by them
+typedef void (FakeGL::*TriangleKernel)(screenVertexWithAttributes &, screenVertexWithAttributes &, screenVertexWithAttributes &, const rasterRectangle &);
+static const TriangleKernel triangleKernels[FAKEGL_KERNELS] =
+    { // triangleKernels
+    &FakeGL::RasteriseTriangleKernel<0>, &FakeGL::RasteriseTriangleKernel<1>, &FakeGL::RasteriseTriangleKernel<2>, &FakeGL::RasteriseTriangleKernel<3>,
+    &FakeGL::RasteriseTriangleKernel<4>, &FakeGL::RasteriseTriangleKernel<5>, &FakeGL::RasteriseTriangleKernel<6>, &FakeGL::RasteriseTriangleKernel<7>,
+    &FakeGL::RasteriseTriangleKernel<8>, &FakeGL::RasteriseTriangleKernel<9>, &FakeGL::RasteriseTriangleKernel<10>, &FakeGL::RasteriseTriangleKernel<11>
+    }; // triangleKernels
+// and the ones that fill in the G-buffer, without & with the depth test
+static const TriangleKernel deferredKernels[2] =
+    { // deferredKernels
+    &FakeGL::RasteriseTriangleKernel<FAKEGL_KERNEL_DEFERRED>, &FakeGL::RasteriseTriangleKernel<FAKEGL_KERNEL_DEFERRED + FAKEGL_KERNEL_DEPTH_TEST>
+    }; // deferredKernels
+
+// picks the shading kernel for the current state, at the start of a draw
+void FakeGL::SelectShadingKernel()
+    { // SelectShadingKernel()
+        shadingKernel = 0;
+        if (dBufferingEnabled)
+            shadingKernel += FAKEGL_KERNEL_DEPTH_TEST;
+        if (lightingEnabled and phongEnabled)
+            shadingKernel += FAKEGL_KERNEL_PHONG;
+        // any other texture mode leaves the colour alone, as if texturing were off
+        if (textureEnabled and texMode == FAKEGL_REPLACE)
+            shadingKernel += FAKEGL_KERNEL_REPLACE;
+        else if (textureEnabled and texMode == FAKEGL_MODULATE)
+            shadingKernel += FAKEGL_KERNEL_MODULATE;
+
+        // Phong shading lights every fragment of the draw the same way
+        shadingModelView = mvMatrixStack.top();
+        shadingLightDirection = lightPosition.Vector();
+        shadingLightUnit = shadingLightDirection.unit();
+    } // SelectShadingKernel()
+
+// whether two materials are the same
+static bool SameMaterial(const vertexMaterial &material0, const vertexMaterial &material1)
+    { // SameMaterial()
+        for (size_t i = 0; i < 4; i++)
+            if (material0.amb[i] != material1.amb[i] or material0.diff[i] != material1.diff[i]
+                or material0.spec[i] != material1.spec[i] or material0.emiss[i] != material1.emiss[i])
+                return false;
+        return material0.shin == material1.shin;
+    } // SameMaterial()
+
+// with deferred shading, sets up a draw's triangles to fill in the G-buffer
+void FakeGL::DeferTriangles()
+    { // DeferTriangles()
+        // the G-buffer matches the frame buffer - if that has been resized, what was waiting is lost
+        if (gBuffer.width != frameBuffer.width or gBuffer.height != frameBuffer.height) {
+            gBuffer.Resize(frameBuffer.width, frameBuffer.height);
+            deferredMaterials.clear();
+            deferredPending = false;
+        }
+
+        // every pixel waiting is lit by the same light, so a draw with another one lights them first
+        if (deferredPending and !(shadingLightDirection == deferredLightDirection
+                                  and std::equal(lightAmbient, lightAmbient + 4, deferredLightAmbient)
+                                  and std::equal(lightDiffuse, lightDiffuse + 4, deferredLightDiffuse)
+                                  and std::equal(lightSpecular, lightSpecular + 4, deferredLightSpecular)))
+            ResolveDeferredShading();
+        if (!deferredPending) {
+            deferredLightDirection = shadingLightDirection;
+            deferredLightUnit = shadingLightUnit;
+            std::copy(lightAmbient, lightAmbient + 4, deferredLightAmbient);
+            std::copy(lightDiffuse, lightDiffuse + 4, deferredLightDiffuse);
+            std::copy(lightSpecular, lightSpecular + 4, deferredLightSpecular);
+        }
+
+        unsigned int texturing = shadingKernel & (FAKEGL_KERNEL_REPLACE | FAKEGL_KERNEL_MODULATE);
+        float minY = INFINITY, maxY = -INFINITY;
+        size_t nVertices = (rasterQueue.size() / 3) * 3;
+        for (size_t first = 0; first < nVertices; first += 3) {
+            screenVertexWithAttributes *triangle = &rasterQueue[first];
+
+            // a pixel only has room for one material, so a triangle whose material varies is shaded as usual
+            const vertexMaterial &surface = drawMaterials[triangle[0].material];
+            if ((triangle[1].material != triangle[0].material and !SameMaterial(surface, drawMaterials[triangle[1].material]))
+                or (triangle[2].material != triangle[0].material and !SameMaterial(surface, drawMaterials[triangle[2].material]))) {
+                triangle[0].materialId = FAKEGL_NO_MATERIAL;
+                continue;
+            }
+
+            // one object's triangles nearly always share a material, so only the last one is compared
+            const deferredMaterial *last = deferredMaterials.empty() ? nullptr : &deferredMaterials.back();
+            if (last == nullptr or last->texturing != texturing or last->texture != texture or last->shin != surface.shin
+                or !std::equal(last->amb, last->amb + 4, surface.amb) or !std::equal(last->diff, last->diff + 4, surface.diff)
+                or !std::equal(last->spec, last->spec + 4, surface.spec) or !std::equal(last->emiss, last->emiss + 4, surface.emiss)) {
+                deferredMaterial material;
+                std::copy(surface.amb, surface.amb + 4, material.amb);
+                std::copy(surface.diff, surface.diff + 4, material.diff);
+                std::copy(surface.spec, surface.spec + 4, material.spec);
+                std::copy(surface.emiss, surface.emiss + 4, material.emiss);
+                material.shin = surface.shin;
+                material.texturing = texturing;
+                material.texture = texture;
+                deferredMaterials.push_back(material);
+            }
+            triangle[0].materialId = (uint32_t) deferredMaterials.size() - 1;
+
+            for (int vertex = 0; vertex < 3; vertex++) {
+                minY = std::min(minY, triangle[vertex].position.y);
+                maxY = std::max(maxY, triangle[vertex].position.y);
+            }
+            shadingDeferred = true;
+        }
+        if (!shadingDeferred)
+            return;
+
+        // the normal matrix, once per vertex rather than per pixel - into a varying of its own,
+        // since the triangles shaded as usual still want the normals in OCS
+        size_t nRecords = varyings.size() / varyingStride;
+        for (size_t record = 0; record < nRecords; record++) {
+            float *varying = &varyings[record * varyingStride];
+            Cartesian3 normalVCS = shadingModelView * Cartesian3(varying[varyingNormal], varying[varyingNormal + 1], varying[varyingNormal + 2]);
+            varying[varyingNormalVCS] = normalVCS.x;
+            varying[varyingNormalVCS + 1] = normalVCS.y;
+            varying[varyingNormalVCS + 2] = normalVCS.z;
+        }
+
+        // the rows the lighting pass has to look at - anything odd means all of them
+        long firstRow = 0, lastRow = gBuffer.height - 1;
+        if (std::isfinite(minY + maxY)) {
+            firstRow = std::max(firstRow, (long) floorf(minY) - 1);
+            lastRow = std::min(lastRow, (long) ceilf(maxY) + 1);
+        }
+        if (!deferredPending) {
+            deferredFirstRow = firstRow;
+            deferredLastRow = lastRow;
+        }
+        else {
+            deferredFirstRow = std::min(deferredFirstRow, firstRow);
+            deferredLastRow = std::max(deferredLastRow, lastRow);
+        }
+        deferredPending = true;
+    } // DeferTriangles()
+
+// lights the pixels waiting in the G-buffer, a band of rows at a time
+void FakeGL::ResolveDeferredShading()
+    { // ResolveDeferredShading()
+        deferredPending = false;
+        // a frame buffer resized since means what was waiting no longer fits it
+        if (gBuffer.width != frameBuffer.width or gBuffer.height != frameBuffer.height) {
+            gBuffer.Resize(frameBuffer.width, frameBuffer.height);
+            deferredMaterials.clear();
+            return;
+        }
+
+        long firstRow = std::max(deferredFirstRow, 0L);
+        long lastRow = std::min(deferredLastRow, gBuffer.height - 1);
+        if (lastRow < firstRow) {
+            deferredMaterials.clear();
+            return;
+        }
+        size_t nBands = (size_t) (lastRow - firstRow) / FAKEGL_TILE_SIZE + 1;
+
+        threadPool.Run(nBands, [&](size_t band)
+            { // per band
+            // the parts of the lighting that don't depend on the material, for a row
+            std::vector<float> diffuseRow(gBuffer.width), cosineRow(gBuffer.width);
+            const Cartesian3 &light = deferredLightDirection, &lightUnit = deferredLightUnit;
+
+            long bandEnd = std::min(lastRow + 1, firstRow + (long) (band + 1) * FAKEGL_TILE_SIZE);
+            for (long row = firstRow + (long) band * FAKEGL_TILE_SIZE; row < bandEnd; row++) {
+                size_t rowStart = (size_t) row * gBuffer.width;
+                const float *normalX = &gBuffer.normalX[rowStart], *normalY = &gBuffer.normalY[rowStart], *normalZ = &gBuffer.normalZ[rowStart];
+                const float *eyeX = &gBuffer.eyeX[rowStart], *eyeY = &gBuffer.eyeY[rowStart], *eyeZ = &gBuffer.eyeZ[rowStart];
+                uint32_t *material = &gBuffer.material[rowStart];
+
+                // first the geometry, for the whole row: the same sums for every pixel & no branches, so
+                // the compiler can do several pixels at once (pixels with nothing waiting are just ignored)
+                for (long col = 0; col < gBuffer.width; col++) {
+                    float normalLength = sqrtf(normalX[col] * normalX[col] + normalY[col] * normalY[col] + normalZ[col] * normalZ[col]);
+                    float normalDotLight = normalX[col] * light.x + normalY[col] * light.y + normalZ[col] * light.z;
+                    float diffuse = (normalX[col] * lightUnit.x + normalY[col] * lightUnit.y + normalZ[col] * lightUnit.z) / normalLength;
+                    diffuseRow[col] = diffuse > 0.f ? diffuse : 0.f;
+
+                    // the direction halfway between the light & the eye
+                    float bisecX = (light.x + eyeX[col]) / 2.f, bisecY = (light.y + eyeY[col]) / 2.f, bisecZ = (light.z + eyeZ[col]) / 2.f;
+                    float bisecLength = sqrtf(bisecX * bisecX + bisecY * bisecY + bisecZ * bisecZ);
+                    float cosine = (normalX[col] * bisecX + normalY[col] * bisecY + normalZ[col] * bisecZ) / (normalLength * bisecLength);
+                    // no highlight unless the light hits the surface directly
+                    cosineRow[col] = (normalDotLight > 0.f) & (cosine > 0.f) ? cosine : 0.f;
+                }
+
+                // then the materials, only where something is waiting
+                for (long col = 0; col < gBuffer.width; col++) {
+                    if (material[col] == FAKEGL_NO_MATERIAL)
+                        continue;
+                    const deferredMaterial &surface = deferredMaterials[material[col]];
+                    material[col] = FAKEGL_NO_MATERIAL;
+
+                    float specular = cosineRow[col] > 0.f ? (float) pow(cosineRow[col], surface.shin*4.) : 0.f;
+                    float totalLight[4];
+                    for (size_t i = 0; i < 3; i++)
+                        totalLight[i] = surface.emiss[i] + surface.amb[i] * deferredLightAmbient[i]
+                                      + surface.diff[i] * deferredLightDiffuse[i] * diffuseRow[col]
+                                      + surface.spec[i] * deferredLightSpecular[i] * specular;
+                    totalLight[3] = surface.diff[3];
+
+                    RGBAValue colour;
+                    colour.red = clamp(totalLight[0] * 255., 0.f, 255.f);
+                    colour.green = clamp(totalLight[1] * 255., 0.f, 255.f);
+                    colour.blue = clamp(totalLight[2] * 255., 0.f, 255.f);
+                    colour.alpha = clamp(totalLight[3] * 255., 0.f, 255.f);
+
+                    // then texturing, as the forward path does it
+                    if (surface.texturing != 0) {
+                        size_t texIndexIx = (size_t)(gBuffer.texU[rowStart + col] * surface.texture->width);
+                        size_t texIndexIy = (size_t)(gBuffer.texV[rowStart + col] * surface.texture->height);
+                        if (texIndexIx < surface.texture->width and texIndexIy < surface.texture->height) {
+                            RGBAValue texCol = surface.texture->block[texIndexIy*surface.texture->width + texIndexIx];
+                            if (surface.texturing == FAKEGL_KERNEL_REPLACE)
+                                colour = texCol;
+                            else {
+                                colour.red = colour.red * (texCol.red / 255.f);
+                                colour.green = colour.green * (texCol.green / 255.f);
+                                colour.blue = colour.blue * (texCol.blue / 255.f);
+                                colour.alpha = colour.alpha * (texCol.alpha / 255.f);
+                            }
+                        }
+                    }
+                    frameBuffer.block[rowStart + col] = colour;
+                }
+            }
+            }); // per band
+
+        deferredMaterials.clear();
+    } // ResolveDeferredShading()
 
 // rasterises a single triangle
-void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2)
+void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip)
     { // RasteriseTriangle()
+    // a triangle behind everything already drawn under its bounding box is dropped before any pixel is looked at
+    if (HiZUsable()) {
+        float minX = std::min(vertex0.position.x, std::min(vertex1.position.x, vertex2.position.x));
+        float maxX = std::max(vertex0.position.x, std::max(vertex1.position.x, vertex2.position.x));
+        float minY = std::min(vertex0.position.y, std::min(vertex1.position.y, vertex2.position.y));
+        float maxY = std::max(vertex0.position.y, std::max(vertex1.position.y, vertex2.position.y));
+        float minZ = std::min(vertex0.position.z, std::min(vertex1.position.z, vertex2.position.z));
+        // anything not a number is left to the rasteriser
+        if (std::isfinite(minX + maxX + minY + maxY + minZ)) {
+            // pixel centres are at whole numbers - with a pixel to spare for the rasteriser's rounding
+            rasterRectangle box;
+            box.minCol = (int) std::max((float) clip.minCol, floorf(minX));
+            box.maxCol = (int) std::min((float) clip.maxCol, ceilf(maxX));
+            box.minRow = (int) std::max((float) clip.minRow, floorf(minY));
+            box.maxRow = (int) std::min((float) clip.maxRow, ceilf(maxY));
+            // an empty box has no pixels to draw anyway
+            if (box.minCol > box.maxCol or box.minRow > box.maxRow)
+                return;
+            if (HiZHidden(box, QuantiseDepth(minZ - FAKEGL_HIZ_MARGIN * (dFar - dNear)))) {
+                hiZCulledTriangles++;
+                return;
+            }
+        }
+    }
+
+    // and the rest is specialised for the current state
+    if (shadingDeferred and vertex0.materialId != FAKEGL_NO_MATERIAL)
+        (this->*deferredKernels[shadingKernel & FAKEGL_KERNEL_DEPTH_TEST])(vertex0, vertex1, vertex2, clip);
+    else
+        (this->*triangleKernels[shadingKernel])(vertex0, vertex1, vertex2, clip);
+    } // RasteriseTriangle()
+
+// rasterises a single triangle with whichever rasteriser suits it
+template <unsigned int kernel>
+void FakeGL::RasteriseTriangleKernel(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip)
+    { // RasteriseTriangleKernel()
+    // triangles too large for the fixed point rasteriser use the floating point one
+    if (floatRasteriser or !RasteriseTriangleFixed<kernel>(vertex0, vertex1, vertex2, clip))
+        RasteriseTriangleFloat<kernel>(vertex0, vertex1, vertex2, clip);
+    } // RasteriseTriangleKernel()
+
+// works out which pixels of a block lie inside every edge that crosses it
+// bit (row * FAKEGL_RASTER_BLOCK + col) is set for each covered pixel
+// the edge values must already have had the sub-pixel scale divided out, so that they fit in 32 bits
+static uint64_t BlockCoverage(int nEdges, const int32_t *cornerValue, const int32_t *stepX, const int32_t *stepY, int blockWidth, int blockHeight)
+    { // BlockCoverage()
+    uint64_t coverage = 0;
+    // the columns of the block that are inside the bounding box
+    unsigned int columnMask = (1u << blockWidth) - 1;
+
+#ifdef FAKEGL_SSE2
+    // one register for columns 0-3 and one for 4-7, for each edge
+    __m128i rowValue[3][2], rowStep[3];
+    for (int edge = 0; edge < nEdges; edge++)
+        { // per edge
+        rowValue[edge][0] = _mm_add_epi32(_mm_set1_epi32(cornerValue[edge]),
+                                          _mm_setr_epi32(0, stepX[edge], 2 * stepX[edge], 3 * stepX[edge]));
+        rowValue[edge][1] = _mm_add_epi32(rowValue[edge][0], _mm_set1_epi32(4 * stepX[edge]));
+        rowStep[edge] = _mm_set1_epi32(stepY[edge]);
+        } // per edge
+
+    const __m128i minusOne = _mm_set1_epi32(-1);
+    for (int row = 0; row < blockHeight; row++)
+        { // per row
+        __m128i inside0 = _mm_cmpeq_epi32(minusOne, minusOne);
+        __m128i inside1 = inside0;
+        for (int edge = 0; edge < nEdges; edge++)
+            { // per edge
+            inside0 = _mm_and_si128(inside0, _mm_cmpgt_epi32(rowValue[edge][0], minusOne));
+            inside1 = _mm_and_si128(inside1, _mm_cmpgt_epi32(rowValue[edge][1], minusOne));
+            rowValue[edge][0] = _mm_add_epi32(rowValue[edge][0], rowStep[edge]);
+            rowValue[edge][1] = _mm_add_epi32(rowValue[edge][1], rowStep[edge]);
+            } // per edge
+        unsigned int rowBits = _mm_movemask_ps(_mm_castsi128_ps(inside0)) | (_mm_movemask_ps(_mm_castsi128_ps(inside1)) << 4);
+        coverage |= (uint64_t)(rowBits & columnMask) << (row * FAKEGL_RASTER_BLOCK);
+        } // per row
+#else
+    for (int row = 0; row < blockHeight; row++)
+        for (int col = 0; col < blockWidth; col++)
+            { // per pixel
+            bool inside = true;
+            for (int edge = 0; edge < nEdges; edge++)
+                inside = inside and (cornerValue[edge] + col * stepX[edge] + row * stepY[edge] >= 0);
+            if (inside)
+                coverage |= (uint64_t)1 << (row * FAKEGL_RASTER_BLOCK + col);
+            } // per pixel
+#endif
+
+    return coverage;
+    } // BlockCoverage()
+
+// rasterises a single triangle with fixed point edge functions, a block of pixels at a time
+// returns false without drawing anything if the triangle is too large for fixed point
+template <unsigned int kernel>
+bool FakeGL::RasteriseTriangleFixed(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip)
+    { // RasteriseTriangleFixed()
+    const screenVertexWithAttributes *vertices[3] = { &vertex0, &vertex1, &vertex2 };
+    const float subpixelScale = (float)(1 << FAKEGL_SUBPIXEL_BITS);
+
+    // snap the vertices to the sub-pixel grid - the test is written so that NaNs fail it too
+    int64_t vertexX[3], vertexY[3];
+    for (int vertex = 0; vertex < 3; vertex++)
+        { // per vertex
+        float x = vertices[vertex]->position.x;
+        float y = vertices[vertex]->position.y;
+        if (!(fabs(x) < FAKEGL_FIXED_POINT_LIMIT) or !(fabs(y) < FAKEGL_FIXED_POINT_LIMIT))
+            return false;
+        vertexX[vertex] = (int64_t) floor(x * subpixelScale + 0.5f);
+        vertexY[vertex] = (int64_t) floor(y * subpixelScale + 0.5f);
+        } // per vertex
+
+    // twice the signed area: positive for counter-clockwise triangles
+    int64_t area = (vertexX[1] - vertexX[0]) * (vertexY[2] - vertexY[0]) - (vertexY[1] - vertexY[0]) * (vertexX[2] - vertexX[0]);
+
+    // edge on triangles have no pixels of their own - the adjacent triangles cover them
+    if (area == 0)
+        return true;
+
+    // both windings are drawn, so flip the edges of clockwise triangles to keep the inside positive
+    int64_t orientation = (area > 0) ? 1 : -1;
+    area *= orientation;
+
+    // edge i is the one opposite vertex i, so that its value over the area is that vertex's barycentric coordinate
+    // at pixel (col, row) its value is edgeA * col * scale + edgeB * row * scale + edgeC
+    int64_t edgeA[3], edgeB[3], edgeC[3];
+    // the coverage test E >= 0 becomes edgeA * col + edgeB * row + testC >= 0 with the scale divided out
+    // pixels exactly on an edge only belong to the triangle if it is a top or left edge, so that
+    // triangles sharing the edge don't both draw them
+    int64_t testC[3];
+    for (int edge = 0; edge < 3; edge++)
+        { // per edge
+        int from = (edge + 1) % 3;
+        int to = (edge + 2) % 3;
+        edgeA[edge] = (vertexY[from] - vertexY[to]) * orientation;
+        edgeB[edge] = (vertexX[to] - vertexX[from]) * orientation;
+        edgeC[edge] = -(edgeA[edge] * vertexX[from] + edgeB[edge] * vertexY[from]);
+
+        // the edge runs in direction (edgeB, -edgeA), with the inside to its left
+        bool topLeft = (edgeA[edge] > 0) or (edgeA[edge] == 0 and edgeB[edge] < 0);
+        // arithmetic shift, so this rounds down
+        testC[edge] = (edgeC[edge] + (topLeft ? 0 : -1)) >> FAKEGL_SUBPIXEL_BITS;
+        } // per edge
+
+    // the pixels in the bounding box, clipped to the clip rectangle
+    int64_t minX = std::min(vertexX[0], std::min(vertexX[1], vertexX[2]));
+    int64_t maxX = std::max(vertexX[0], std::max(vertexX[1], vertexX[2]));
+    int64_t minY = std::min(vertexY[0], std::min(vertexY[1], vertexY[2]));
+    int64_t maxY = std::max(vertexY[0], std::max(vertexY[1], vertexY[2]));
+    int minCol = (int) std::max<int64_t>((minX + (1 << FAKEGL_SUBPIXEL_BITS) - 1) >> FAKEGL_SUBPIXEL_BITS, clip.minCol);
+    int maxCol = (int) std::min<int64_t>(maxX >> FAKEGL_SUBPIXEL_BITS, clip.maxCol);
+    int minRow = (int) std::max<int64_t>((minY + (1 << FAKEGL_SUBPIXEL_BITS) - 1) >> FAKEGL_SUBPIXEL_BITS, clip.minRow);
+    int maxRow = (int) std::min<int64_t>(maxY >> FAKEGL_SUBPIXEL_BITS, clip.maxRow);
+
+    double inverseArea = 1.0 / (double) area;
+
+    // the depth is a plane over the screen, so its extremes over a block are at the block's corners
+    // depthA * col + depthB * row + depthC, from the same edge values as the per-pixel barycentrics
+    bool hiZ = HiZUsable();
+    double depthA = 0.0, depthB = 0.0, depthC = 0.0, minZ = 0.0, maxZ = 0.0, margin = 0.0;
+    if (hiZ)
+        { // depth plane
+        for (int vertex = 0; vertex < 3; vertex++)
+            { // per vertex
+            double z = vertices[vertex]->position.z * inverseArea;
+            depthA += (double) (edgeA[vertex] * (1 << FAKEGL_SUBPIXEL_BITS)) * z;
+            depthB += (double) (edgeB[vertex] * (1 << FAKEGL_SUBPIXEL_BITS)) * z;
+            depthC += (double) edgeC[vertex] * z;
+            } // per vertex
+        minZ = std::min(vertex0.position.z, std::min(vertex1.position.z, vertex2.position.z));
+        maxZ = std::max(vertex0.position.z, std::max(vertex1.position.z, vertex2.position.z));
+        margin = FAKEGL_HIZ_MARGIN * (dFar - dNear);
+        } // depth plane
+    // Hi-Z counts are kept locally, so threads don't fight over the shared counter
+    unsigned long long culledBlocks = 0;
+
+    // create a fragment for reuse
+    fragmentWithAttributes rasterFragment;
+
+    // walk the bounding box a block at a time, with the blocks lined up with the depth buffer's
+    for (int alignedRow = minRow & ~(FAKEGL_RASTER_BLOCK - 1); alignedRow <= maxRow; alignedRow += FAKEGL_RASTER_BLOCK)
+        { // per block row
+        int blockRow = std::max(alignedRow, minRow);
+        int blockHeight = std::min(alignedRow + FAKEGL_RASTER_BLOCK - 1, maxRow) - blockRow + 1;
+        for (int alignedCol = minCol & ~(FAKEGL_RASTER_BLOCK - 1); alignedCol <= maxCol; alignedCol += FAKEGL_RASTER_BLOCK)
+            { // per block
+            int blockCol = std::max(alignedCol, minCol);
+            int blockWidth = std::min(alignedCol + FAKEGL_RASTER_BLOCK - 1, maxCol) - blockCol + 1;
+
+            // the edge functions are linear, so their extremes over the block are at its corners
+            // a block outside any edge is skipped, and edges the block is wholly inside need no per-pixel test
+            int nCrossing = 0;
+            int32_t cornerValue[3], stepX[3], stepY[3];
+            bool outside = false;
+            for (int edge = 0; edge < 3; edge++)
+                { // per edge
+                int64_t corner = edgeA[edge] * blockCol + edgeB[edge] * blockRow + testC[edge];
+                int64_t spanX = edgeA[edge] * (blockWidth - 1);
+                int64_t spanY = edgeB[edge] * (blockHeight - 1);
+                int64_t lowest = corner + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+                int64_t highest = corner + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+                if (highest < 0)
+                    { // outside
+                    outside = true;
+                    break;
+                    } // outside
+                if (lowest < 0)
+                    { // crossing
+                    // values across the block lie between lowest & highest, which bound the corner too
+                    cornerValue[nCrossing] = (int32_t) corner;
+                    stepX[nCrossing] = (int32_t) edgeA[edge];
+                    stepY[nCrossing] = (int32_t) edgeB[edge];
+                    nCrossing++;
+                    } // crossing
+                } // per edge
+            if (outside)
+                continue;
+
+            // a block inside every edge is covered completely
+            uint64_t coverage = (nCrossing == 0) ? ~(uint64_t)0 : BlockCoverage(nCrossing, cornerValue, stepX, stepY, blockWidth, blockHeight);
+            if (coverage == 0)
+                continue;
+
+            // the nearest & furthest the triangle gets within the block, which can't be beyond its vertices
+            double blockNearest = 0.0, blockFurthest = 0.0;
+            long depthBlockRow = alignedRow / DEPTH_BLOCK_SIZE, depthBlockCol = alignedCol / DEPTH_BLOCK_SIZE;
+            if (hiZ)
+                { // Hi-Z test
+                double corner = depthA * blockCol + depthB * blockRow + depthC;
+                double spanX = depthA * (blockWidth - 1);
+                double spanY = depthB * (blockHeight - 1);
+                blockNearest = std::max(minZ, corner + std::min(spanX, 0.0) + std::min(spanY, 0.0));
+                blockFurthest = std::min(maxZ, corner + std::max(spanX, 0.0) + std::max(spanY, 0.0));
+                if (DepthPasses(QuantiseDepth(blockNearest - margin), depthBuffer.BlockMax(depthBlockRow, depthBlockCol)) == false)
+                    { // hidden
+                    culledBlocks++;
+                    continue;
+                    } // hidden
+                } // Hi-Z test
+
+            for (int row = 0; row < blockHeight; row++)
+                for (int col = 0; col < blockWidth; col++)
+                    { // per pixel
+                    if (!((coverage >> (row * FAKEGL_RASTER_BLOCK + col)) & 1))
+                        continue;
+
+                    rasterFragment.row = blockRow + row;
+                    rasterFragment.col = blockCol + col;
+
+                    // exact edge values at the pixel give the barycentric coordinates
+                    int64_t pixelX = (int64_t) rasterFragment.col << FAKEGL_SUBPIXEL_BITS;
+                    int64_t pixelY = (int64_t) rasterFragment.row << FAKEGL_SUBPIXEL_BITS;
+                    float alpha = (float) ((edgeA[0] * pixelX + edgeB[0] * pixelY + edgeC[0]) * inverseArea);
+                    float beta = (float) ((edgeA[1] * pixelX + edgeB[1] * pixelY + edgeC[1]) * inverseArea);
+                    float gamma = (float) ((edgeA[2] * pixelX + edgeB[2] * pixelY + edgeC[2]) * inverseArea);
+
+                    // light, texture & pass on the fragment
+                    ShadeTriangleFragment<kernel>(vertex0, vertex1, vertex2, alpha, beta, gamma, rasterFragment);
+                    } // per pixel
+
+            // bring the block's furthest depth up to date - held back fragments haven't written theirs yet
+            if (hiZ and !deferFragments)
+                { // update Hi-Z
+                // every pixel of a covered block now holds the nearer of its old depth & the triangle's,
+                // unless the triangle left the depth range there & didn't get written
+                if (coverage == ~(uint64_t)0 and blockWidth == DEPTH_BLOCK_SIZE and blockHeight == DEPTH_BLOCK_SIZE
+                    and blockNearest - margin >= dNear and blockFurthest + margin <= dFar)
+                    depthBuffer.LowerBlockMax(depthBlockRow, depthBlockCol, QuantiseDepth(blockFurthest + margin));
+                else
+                    depthBuffer.UpdateBlockMax(depthBlockRow, depthBlockCol);
+                } // update Hi-Z
+            } // per block
+        } // per block row
+
+    if (culledBlocks != 0)
+        hiZCulledBlocks += culledBlocks;
+
+    return true;
+    } // RasteriseTriangleFixed()
+
+// rasterises a single triangle by testing every pixel of its bounding box in floating point
+template <unsigned int kernel>
+void FakeGL::RasteriseTriangleFloat(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip)
+    { // RasteriseTriangleFloat()
     // compute a bounding box that starts inverted to frame size
     // clipping will happen in the raster loop proper
     float minX = frameBuffer.width, maxX = 0.0;
@@ -690,6 +2770,13 @@ void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertex
     if (vertex2.position.y < minY) minY = vertex2.position.y;
     if (vertex2.position.y > maxY) maxY = vertex2.position.y;
 
+    // and limit it to the clip rectangle, so that a triangle reaching far off the screen
+    // doesn't spend its time stepping over pixels that will never be drawn
+    minX = std::max(minX, (float) clip.minCol);
+    maxX = std::min(maxX, (float) clip.maxCol);
+    minY = std::max(minY, (float) clip.minRow);
+    maxY = std::min(maxY, (float) clip.maxRow);
+
     // now for each side of the triangle, compute the line vectors
     Cartesian3 vector01 = vertex1.position - vertex0.position;
     Cartesian3 vector12 = vertex2.position - vertex1.position;
@@ -724,13 +2811,13 @@ void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertex
     for (rasterFragment.row = minY; rasterFragment.row <= maxY; rasterFragment.row++)
         { // per row
         // this is here so that clipping works correctly
-        if (rasterFragment.row < 0) continue;
-        if (rasterFragment.row >= frameBuffer.height) continue;
+        if (rasterFragment.row < clip.minRow) continue;
+        if (rasterFragment.row > clip.maxRow) continue;
         for (rasterFragment.col = minX; rasterFragment.col <= maxX; rasterFragment.col++)
             { // per pixel
             // this is also for correct clipping
-            if (rasterFragment.col < 0) continue;
-            if (rasterFragment.col >= frameBuffer.width) continue;
+            if (rasterFragment.col < clip.minCol) continue;
+            if (rasterFragment.col > clip.maxCol) continue;
             
             // the pixel in cartesian format
             Cartesian3 pixel(rasterFragment.col, rasterFragment.row, 0.);
@@ -745,120 +2832,302 @@ void FakeGL::RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertex
             if ((alpha < 0.0) || (beta < 0.0) || (gamma < 0.0))
                 continue;
 
-            // compute colour
-            rasterFragment.colour = alpha * vertex0.colour + beta * vertex1.colour + gamma * vertex2.colour; 
+            // light, texture & pass on the fragment
+            ShadeTriangleFragment<kernel>(vertex0, vertex1, vertex2, alpha, beta, gamma, rasterFragment);
+            } // per pixel
+        } // per row
 
-            if (lightingEnabled and phongEnabled) {
-                // Interpolate normal and material properties
-                Cartesian3 fragNormal = alpha * vertex0.normal + beta * vertex1.normal + gamma * vertex2.normal;
-                float fragAmb[4];
-                float fragDiff[4];
-                float fragSpec[4];
-                float fragEmiss[4]; 
-                for (size_t i = 0; i < 4; i++)
-                {
-                    fragAmb[i] = alpha * vertex0.amb[i] + beta * vertex1.amb[i] + gamma * vertex2.amb[i];
-                    fragDiff[i] = alpha * vertex0.diff[i] + beta * vertex1.diff[i] + gamma * vertex2.diff[i];
-                    fragSpec[i] = alpha * vertex0.spec[i] + beta * vertex1.spec[i] + gamma * vertex2.spec[i];
-                    fragEmiss[i] = alpha * vertex0.emiss[i] + beta * vertex1.emiss[i] + gamma * vertex2.emiss[i];
-                }
-                float fragShin = alpha * vertex0.shin + beta * vertex1.shin + gamma * vertex2.shin;
-                Cartesian3 fragEPos = alpha * vertex0.ePos.Vector() + beta * vertex1.ePos.Vector() + gamma * vertex2.ePos.Vector();
+    } // RasteriseTriangleFloat()
 
-                float totalLight[4] = {0.,0.,0.,0.};
+// shades one covered pixel of a triangle given its barycentric coordinates
+template <unsigned int kernel>
+void FakeGL::ShadeTriangleFragment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2,
+        float alpha, float beta, float gamma, fragmentWithAttributes &rasterFragment)
+    { // ShadeTriangleFragment()
+    // Compute depth using barycentric interp
+    rasterFragment.depth = alpha * vertex0.position.z + beta * vertex1.position.z + gamma * vertex2.position.z;
 
-                // Emissive light
-                totalLight[0] += fragEmiss[0];
-                totalLight[1] += fragEmiss[1];
-                totalLight[2] += fragEmiss[2];
-                // totalLight[3] += vert.emiss[3];
+    // and test it before spending any time on lighting or texturing
+    if (kernel & FAKEGL_KERNEL_DEPTH_TEST) {
+        if (!EarlyDepthTest(rasterFragment))
+            return;
+    }
+    // without a depth test, all that ProcessFragment() would throw away is what is outside the depth range
+    else if (rasterFragment.depth < dNear or rasterFragment.depth > dFar)
+        return;
+
+    // the vertices' varyings, which every pixel blends in the same way
+    const float *varying0 = varyings.data() + (size_t) vertex0.varying * varyingStride;
+    const float *varying1 = varyings.data() + (size_t) vertex1.varying * varyingStride;
+    const float *varying2 = varyings.data() + (size_t) vertex2.varying * varyingStride;
+    auto interpolate = [&](size_t offset) { return alpha * varying0[offset] + beta * varying1[offset] + gamma * varying2[offset]; };
+
+    if (kernel & FAKEGL_KERNEL_DEFERRED) {
+        // the depth test proper, as ProcessFragment() would do it - whatever is left at the end is lit
+        if ((kernel & FAKEGL_KERNEL_DEPTH_TEST) and !DepthTestAndWrite(rasterFragment))
+            return;
 
-                // Ambient Light
-                totalLight[0] += (fragAmb[0]*lightAmbient[0]);
-                totalLight[1] += (fragAmb[1]*lightAmbient[1]);
-                totalLight[2] += (fragAmb[2]*lightAmbient[2]);
-                // totalLight[3] += (vert.amb[3]*lightAmbient[3]);
+        // these normals are already in VCS
+        size_t pixel = (size_t) rasterFragment.row * gBuffer.width + rasterFragment.col;
+        gBuffer.normalX[pixel] = interpolate(varyingNormalVCS);
+        gBuffer.normalY[pixel] = interpolate(varyingNormalVCS + 1);
+        gBuffer.normalZ[pixel] = interpolate(varyingNormalVCS + 2);
+        gBuffer.eyeX[pixel] = interpolate(varyingEye);
+        gBuffer.eyeY[pixel] = interpolate(varyingEye + 1);
+        gBuffer.eyeZ[pixel] = interpolate(varyingEye + 2);
+        // the texture coordinates are only there (and only read) when texturing
+        if (shadingKernel & (FAKEGL_KERNEL_REPLACE | FAKEGL_KERNEL_MODULATE)) {
+            gBuffer.texU[pixel] = interpolate(varyingTexCoord);
+            gBuffer.texV[pixel] = interpolate(varyingTexCoord + 1);
+        }
+        gBuffer.material[pixel] = vertex0.materialId;
+        if (countFragments)
+            fragmentCount++;
+        return;
+    }
+
+    if (kernel & FAKEGL_KERNEL_PHONG) {
+        // Interpolate normal and material properties
+        // (the colour isn't needed, as lighting replaces all of it)
+        Cartesian3 fragNormal(interpolate(varyingNormal), interpolate(varyingNormal + 1), interpolate(varyingNormal + 2));
+        const vertexMaterial &material0 = drawMaterials[vertex0.material];
+        const vertexMaterial &material1 = drawMaterials[vertex1.material];
+        const vertexMaterial &material2 = drawMaterials[vertex2.material];
+        float fragAmb[4];
+        float fragDiff[4];
+        float fragSpec[4];
+        float fragEmiss[4];
+        for (size_t i = 0; i < 4; i++)
+        {
+            fragAmb[i] = alpha * material0.amb[i] + beta * material1.amb[i] + gamma * material2.amb[i];
+            fragDiff[i] = alpha * material0.diff[i] + beta * material1.diff[i] + gamma * material2.diff[i];
+            fragSpec[i] = alpha * material0.spec[i] + beta * material1.spec[i] + gamma * material2.spec[i];
+            fragEmiss[i] = alpha * material0.emiss[i] + beta * material1.emiss[i] + gamma * material2.emiss[i];
+        }
+        float fragShin = alpha * material0.shin + beta * material1.shin + gamma * material2.shin;
+        Cartesian3 fragEPos(interpolate(varyingEye), interpolate(varyingEye + 1), interpolate(varyingEye + 2));
 
-                // Diffuse Light
-                Cartesian3 norm = mvMatrixStack.top() * fragNormal;
-                Cartesian3 lightDir = lightPosition.Vector();
-                float diffuse = std::max(norm.unit().dot(lightDir.unit()),0.f);
+        float totalLight[4] = {0.,0.,0.,0.};
 
-                totalLight[0] += (fragDiff[0] * lightDiffuse[0] * diffuse);
-                totalLight[1] += (fragDiff[1] * lightDiffuse[1] * diffuse);
-                totalLight[2] += (fragDiff[2] * lightDiffuse[2] * diffuse);
-                totalLight[3] += (fragDiff[3]);
+        // Emissive light
+        totalLight[0] += fragEmiss[0];
+        totalLight[1] += fragEmiss[1];
+        totalLight[2] += fragEmiss[2];
+        // totalLight[3] += vert.emiss[3];
 
-                // Specular Light
-                Cartesian3 eyeDir = fragEPos;
-                Cartesian3 bisecDir = (lightDir+eyeDir)/2.f;
+        // Ambient Light
+        totalLight[0] += (fragAmb[0]*lightAmbient[0]);
+        totalLight[1] += (fragAmb[1]*lightAmbient[1]);
+        totalLight[2] += (fragAmb[2]*lightAmbient[2]);
+        // totalLight[3] += (vert.amb[3]*lightAmbient[3]);
 
-                float specular= 0;
+        // Diffuse Light
+        Cartesian3 norm = shadingModelView * fragNormal;
+        const Cartesian3 &lightDir = shadingLightDirection;
+        float diffuse = std::max(norm.unit().dot(shadingLightUnit),0.f);
 
-                // If the light is going to hit the surface directly
-                if (norm.dot(lightDir) > 0) {
-                    float ndotvb = norm.dot(bisecDir) / (norm.length() * bisecDir.length());
+        totalLight[0] += (fragDiff[0] * lightDiffuse[0] * diffuse);
+        totalLight[1] += (fragDiff[1] * lightDiffuse[1] * diffuse);
+        totalLight[2] += (fragDiff[2] * lightDiffuse[2] * diffuse);
+        totalLight[3] += (fragDiff[3]);
 
-                    specular = ndotvb > 0 ? pow(ndotvb,fragShin*4.) : 0;
-                }
-                
-                totalLight[0] += (fragSpec[0] * lightSpecular[0] * specular);
-                totalLight[1] += (fragSpec[1] * lightSpecular[1] * specular);
-                totalLight[2] += (fragSpec[2] * lightSpecular[2] * specular);
-                // totalLight[3] += (vert.spec[3] * lightSpecular[3] * specular);
+        // Specular Light
+        Cartesian3 eyeDir = fragEPos;
+        Cartesian3 bisecDir = (lightDir+eyeDir)/2.f;
 
-                // Set vertex color to the lighting color, limiting to range [0,255]
-                RGBAValue newVCol;
-                newVCol.red = clamp(totalLight[0] * 255., 0.f, 255.f);
-                newVCol.green = clamp(totalLight[1] * 255., 0.f, 255.f);
-                newVCol.blue = clamp(totalLight[2] * 255., 0.f, 255.f);
-                newVCol.alpha = clamp(totalLight[3] * 255., 0.f, 255.f);
-                rasterFragment.colour = newVCol;
-            }
+        float specular= 0;
 
-            if (textureEnabled) {
-                // Calculate the position in the texture of the fragment using barycentric [0,1]        
-                Cartesian3 fragTexCoord = alpha * vertex0.texCoord + beta * vertex1.texCoord + gamma * vertex2.texCoord; 
-                // Convert to texel coordinates
-                size_t texIndexIx = (size_t)(fragTexCoord.x * texture->width); 
-                size_t texIndexIy = (size_t)(fragTexCoord.y * texture->height); 
-
-                // This is to prevent a rare segmentation fault that  I think is caused by an attempt to access a texel outside fo the textures range
-                if (texIndexIx < texture->width and texIndexIx >= 0 and texIndexIy < texture->height and texIndexIy >= 0) {
-                    if (texMode == FAKEGL_REPLACE) {
-                        // Replace all color/lighting with the texel color
-                        rasterFragment.colour = texture->block[texIndexIy*texture->width + texIndexIx];
-                    } else if (texMode == FAKEGL_MODULATE) {
-                        // Map the texel color to [0,1]
-                        RGBAValue texCol = texture->block[texIndexIy*texture->width + texIndexIx];
-                        float modifier[4] = {texCol.red, texCol.green, texCol.blue, texCol.alpha};
-                        for (size_t i = 0; i < 4; i++) modifier[i] /= 255;
-
-                        // Multiply the fragment color by the texel color modifier
-                        rasterFragment.colour.red = rasterFragment.colour.red * modifier[0];
-                        rasterFragment.colour.green = rasterFragment.colour.green * modifier[1];
-                        rasterFragment.colour.blue = rasterFragment.colour.blue * modifier[2];
-                        rasterFragment.colour.alpha = rasterFragment.colour.alpha * modifier[3];
-                    }
-                }
-            }
-            // Compute depth using barycentric interp
-            rasterFragment.depth = alpha * vertex0.position.z + beta * vertex1.position.z + gamma * vertex2.position.z;
+        // If the light is going to hit the surface directly
+        if (norm.dot(lightDir) > 0) {
+            float ndotvb = norm.dot(bisecDir) / (norm.length() * bisecDir.length());
 
-            // now we add it to the queue for fragment processing
-            fragmentQueue.push_back(rasterFragment);
-            } // per pixel
-        } // per row
+            specular = ndotvb > 0 ? pow(ndotvb,fragShin*4.) : 0;
+        }
 
-    } // RasteriseTriangle()
+        totalLight[0] += (fragSpec[0] * lightSpecular[0] * specular);
+        totalLight[1] += (fragSpec[1] * lightSpecular[1] * specular);
+        totalLight[2] += (fragSpec[2] * lightSpecular[2] * specular);
+        // totalLight[3] += (vert.spec[3] * lightSpecular[3] * specular);
+
+        // Set vertex color to the lighting color, limiting to range [0,255]
+        rasterFragment.colour.red = clamp(totalLight[0] * 255., 0.f, 255.f);
+        rasterFragment.colour.green = clamp(totalLight[1] * 255., 0.f, 255.f);
+        rasterFragment.colour.blue = clamp(totalLight[2] * 255., 0.f, 255.f);
+        rasterFragment.colour.alpha = clamp(totalLight[3] * 255., 0.f, 255.f);
+    }
+    else
+        // compute colour
+        rasterFragment.colour = alpha * vertex0.colour + beta * vertex1.colour + gamma * vertex2.colour;
+
+    if (kernel & (FAKEGL_KERNEL_REPLACE | FAKEGL_KERNEL_MODULATE)) {
+        // Calculate the position in the texture of the fragment using barycentric [0,1]
+        float fragTexU = interpolate(varyingTexCoord);
+        float fragTexV = interpolate(varyingTexCoord + 1);
+        // Convert to texel coordinates
+        size_t texIndexIx = (size_t)(fragTexU * texture->width);
+        size_t texIndexIy = (size_t)(fragTexV * texture->height);
+
+        // This is to prevent a rare segmentation fault that  I think is caused by an attempt to access a texel outside fo the textures range
+        if (texIndexIx < texture->width and texIndexIy < texture->height) {
+            if (kernel & FAKEGL_KERNEL_REPLACE) {
+                // Replace all color/lighting with the texel color
+                rasterFragment.colour = texture->block[texIndexIy*texture->width + texIndexIx];
+            } else {
+                // Map the texel color to [0,1]
+                RGBAValue texCol = texture->block[texIndexIy*texture->width + texIndexIx];
+                float modifier[4] = {texCol.red, texCol.green, texCol.blue, texCol.alpha};
+                for (size_t i = 0; i < 4; i++) modifier[i] /= 255;
+
+                // Multiply the fragment color by the texel color modifier
+                rasterFragment.colour.red = rasterFragment.colour.red * modifier[0];
+                rasterFragment.colour.green = rasterFragment.colour.green * modifier[1];
+                rasterFragment.colour.blue = rasterFragment.colour.blue * modifier[2];
+                rasterFragment.colour.alpha = rasterFragment.colour.alpha * modifier[3];
+            }
+        }
+    }
+    // now we pass it on for fragment processing
+    EmitFragment(rasterFragment);
+    } // ShadeTriangleFragment()
+
+// whether the Hi-Z pyramid can be relied on for the current depth test
+bool FakeGL::HiZUsable()
+    { // HiZUsable()
+        // the pyramid holds the furthest depths, which only bound what LESS & LEQUAL will let through
+        return hiZEnabled and dBufferingEnabled and depthBuffer.hiZValid
+            and (depthFunc == FAKEGL_LESS or depthFunc == FAKEGL_LEQUAL)
+            and depthBuffer.width == frameBuffer.width and depthBuffer.height == frameBuffer.height;
+    } // HiZUsable()
+
+// what the depth buffer would store for a depth in DCS, clamped to the depth range
+uint32_t FakeGL::QuantiseDepth(double depth)
+    { // QuantiseDepth()
+        double normalised = (depth - dNear) / (dFar - dNear);
+        return depthBuffer.Quantise((float) std::min(std::max(normalised, 0.0), 1.0));
+    } // QuantiseDepth()
+
+// whether the Hi-Z pyramid shows a depth fails the depth test everywhere in a rectangle of pixels
+bool FakeGL::HiZHidden(const rasterRectangle &rectangle, uint32_t nearest)
+    { // HiZHidden()
+        long firstBlockRow = rectangle.minRow / DEPTH_BLOCK_SIZE, lastBlockRow = rectangle.maxRow / DEPTH_BLOCK_SIZE;
+        long firstBlockCol = rectangle.minCol / DEPTH_BLOCK_SIZE, lastBlockCol = rectangle.maxCol / DEPTH_BLOCK_SIZE;
+        // small rectangles go straight to the blocks, so they don't keep working out tiles again
+        bool useTiles = (lastBlockRow - firstBlockRow + 1) * (lastBlockCol - firstBlockCol + 1) > 4;
+
+        for (long tileRow = firstBlockRow / DEPTH_TILE_BLOCKS; tileRow <= lastBlockRow / DEPTH_TILE_BLOCKS; tileRow++)
+            for (long tileCol = firstBlockCol / DEPTH_TILE_BLOCKS; tileCol <= lastBlockCol / DEPTH_TILE_BLOCKS; tileCol++) {
+                if (useTiles and !DepthPasses(nearest, depthBuffer.TileMax(tileRow, tileCol)))
+                    continue;
+                // the tile might show it, so look at its blocks in the rectangle
+                long blockRowEnd = std::min(lastBlockRow, (tileRow + 1) * DEPTH_TILE_BLOCKS - 1);
+                long blockColEnd = std::min(lastBlockCol, (tileCol + 1) * DEPTH_TILE_BLOCKS - 1);
+                for (long blockRow = std::max(firstBlockRow, tileRow * DEPTH_TILE_BLOCKS); blockRow <= blockRowEnd; blockRow++)
+                    for (long blockCol = std::max(firstBlockCol, tileCol * DEPTH_TILE_BLOCKS); blockCol <= blockColEnd; blockCol++)
+                        if (DepthPasses(nearest, depthBuffer.BlockMax(blockRow, blockCol)))
+                            return false;
+            }
+        return true;
+    } // HiZHidden()
+
+// whether every complete triangle in the raster queue is hidden, tested together
+bool FakeGL::BatchHidden()
+    { // BatchHidden()
+        if (primType != FAKEGL_TRIANGLES or rasterQueue.size() < 3 or !HiZUsable())
+            return false;
+
+        // the screen box & nearest depth of the whole batch
+        float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, minZ = INFINITY;
+        size_t nVertices = (rasterQueue.size() / 3) * 3;
+        for (size_t vertex = 0; vertex < nVertices; vertex++) {
+            const Cartesian3 &position = rasterQueue[vertex].position;
+            minX = std::min(minX, position.x); maxX = std::max(maxX, position.x);
+            minY = std::min(minY, position.y); maxY = std::max(maxY, position.y);
+            minZ = std::min(minZ, position.z);
+        }
+        // std::min & max drop NaNs only sometimes, so anything odd means no
+        if (!std::isfinite(minX + maxX + minY + maxY + minZ))
+            return false;
+
+        // with a pixel to spare for the rasteriser's rounding
+        rasterRectangle box;
+        box.minCol = (int) std::max(0.f, floorf(minX));
+        box.maxCol = (int) std::min((float) frameBuffer.width - 1, ceilf(maxX));
+        box.minRow = (int) std::max(0.f, floorf(minY));
+        box.maxRow = (int) std::min((float) frameBuffer.height - 1, ceilf(maxY));
+        // nothing on screen is left to the rasteriser, which does the counting the same either way
+        if (box.minCol > box.maxCol or box.minRow > box.maxRow)
+            return false;
+        return HiZHidden(box, QuantiseDepth(minZ - FAKEGL_HIZ_MARGIN * (dFar - dNear)));
+    } // BatchHidden()
+
+// compares a fragment's depth with the stored one using depthFunc
+bool FakeGL::DepthPasses(uint32_t fragDepth, uint32_t storedDepth)
+    { // DepthPasses()
+        unsigned int relation = (fragDepth < storedDepth) ? FAKEGL_LESS : (fragDepth == storedDepth) ? FAKEGL_EQUAL : FAKEGL_GREATER;
+        return (depthFunc & relation) != 0;
+    } // DepthPasses()
+
+// the depth test for a fragment on the screen, storing its depth if it passes
+bool FakeGL::DepthTestAndWrite(const fragmentWithAttributes &frag)
+    { // DepthTestAndWrite()
+        // Map from [dNear,dFar]->[0,1], then to the depth buffer's format
+        uint32_t fragDepth = depthBuffer.Quantise((frag.depth - dNear)/(dFar-dNear));
+        uint32_t &storedDepth = depthBuffer.At(frag.row, frag.col);
+
+        if (!DepthPasses(fragDepth, storedDepth))
+            return false;
+        storedDepth = fragDepth;
+        return true;
+    } // DepthTestAndWrite()
+
+// tests a fragment against the depth buffer before it is shaded
+bool FakeGL::EarlyDepthTest(const fragmentWithAttributes &frag)
+    { // EarlyDepthTest()
+        // ProcessFragment() would discard it for being outside the depth range
+        if (frag.depth < dNear or frag.depth > dFar)
+            return false;
+
+        if (!dBufferingEnabled)
+            return true;
+
+        // the rasteriser only produces fragments inside the frame buffer
+        uint32_t fragDepth = depthBuffer.Quantise((frag.depth - dNear)/(dFar-dNear));
+        uint32_t &storedDepth = depthBuffer.At(frag.row, frag.col);
+
+        // during the pre-pass we only record the winning depth, nothing is shaded
+        if (depthOnlyPass) {
+            if (DepthPasses(fragDepth, storedDepth))
+                storedDepth = fragDepth;
+            return false;
+        }
+
+        // with EQUAL, NOTEQUAL & ALWAYS the stored depth can move either way,
+        // so only ProcessFragment() can decide
+        if (depthFunc == FAKEGL_EQUAL or depthFunc == FAKEGL_NOTEQUAL or depthFunc == FAKEGL_ALWAYS)
+            return true;
+
+        // otherwise the stored depth only ever gets nearer (or further), so a fragment
+        // failing now will fail again in ProcessFragment() - and after a pre-pass,
+        // only the fragments at the final depth get through
+        return DepthPasses(fragDepth, storedDepth);
+    } // EarlyDepthTest()
+
+// hands a fragment from the rasteriser to the fragment stage
+void FakeGL::EmitFragment(const fragmentWithAttributes &fragment)
+    { // EmitFragment()
+        if (countFragments)
+            fragmentCount++;
+        // with no blending, fragments only need to reach the frame buffer in the
+        // order they were generated, which processing them immediately already does
+        if (deferFragments)
+            fragmentQueue.push_back(fragment);
+        else
+            ProcessFragment(fragment);
+    } // EmitFragment()
 
 // process a single fragment
-void FakeGL::ProcessFragment()
+void FakeGL::ProcessFragment(const fragmentWithAttributes &frag)
     { // ProcessFragment()
-        // Get fragment from queue
-        fragmentWithAttributes frag = fragmentQueue.front();
-        fragmentQueue.pop_front();
-
         // If the fragment is too near or too far from the camera
         if (frag.depth < dNear or frag.depth > dFar) {
             // Stop processing the fragment
@@ -870,19 +3139,13 @@ void FakeGL::ProcessFragment()
             // Find the index into the framebuffer of the fragment
             size_t fragIndex = (frag.row * frameBuffer.width)+frag.col;
 
-            if (dBufferingEnabled) {
-                // Map from [dNear,dFar]->[0,255]
-
-                // Find the fragment depth mapped from [0,255]
-                unsigned char cFragDepth = (unsigned char)(((frag.depth - dNear)/(dFar-dNear))*255.);
-                
-                // If the fragment is behind an already drawn fragment
-                if (cFragDepth > depthBuffer.block[fragIndex].alpha)
-                    // Stop processing the fragment
-                    return;
-                else 
-                    depthBuffer.block[fragIndex].alpha = cFragDepth;
-            }
+            // If the fragment fails the depth test, stop processing it
+            if (dBufferingEnabled and !DepthTestAndWrite(frag))
+                return;
+
+            // a pixel drawn over one waiting for deferred shading isn't lit after all
+            if (deferredPending and frag.row < gBuffer.height and frag.col < gBuffer.width)
+                gBuffer.material[(size_t) frag.row * gBuffer.width + frag.col] = FAKEGL_NO_MATERIAL;
 
             // Draw the fragment to screen
             frameBuffer.block[fragIndex].red = frag.colour.red;
@@ -22,9 +22,13 @@
 #include "Homogeneous4.h"
 #include "Matrix4.h"
 #include "RGBAImage.h"
+#include "DepthBuffer.h"
+#include "RenderThreadPool.h"
 #include <vector>
-#include <deque>
 #include <stack>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
 
 // we will store all of the FakeGL context in a class object
 // this is similar to the real OpenGL which handles multiple windows
@@ -33,6 +37,12 @@
 //
 // We have simplified the calls, so the code is not *identical* to
 // the OpenGL calls, but it's pretty close
+//
+// Contexts share no state, so several can render at once, each used
+// by one thread at a time - a quad view, say, or a thumbnail for each
+// model.  Textures & vertex arrays are referenced rather than copied,
+// so any number of contexts can draw from the same ones, as long as
+// nothing changes them meanwhile.
 
 // class constants
 // constants for Begin()
@@ -47,6 +57,23 @@ const unsigned int FAKEGL_LIGHTING = 1;
 const unsigned int FAKEGL_TEXTURE_2D = 2;
 const unsigned int FAKEGL_DEPTH_TEST = 3;
 const unsigned int FAKEGL_PHONG_SHADING = 4;
+const unsigned int FAKEGL_DEPTH_PREPASS = 5;
+const unsigned int FAKEGL_HIERARCHICAL_Z = 6;
+const unsigned int FAKEGL_COLOR_MATERIAL = 7;
+const unsigned int FAKEGL_DEFERRED_SHADING = 8;
+const unsigned int FAKEGL_CULL_FACE = 9;
+// constants for CullFace() - bit flags, so FRONT_AND_BACK is both
+const unsigned int FAKEGL_FRONT = 1;
+const unsigned int FAKEGL_BACK = 2;
+const unsigned int FAKEGL_FRONT_AND_BACK = 3;
+// constants for FrontFace(): the winding of front facing triangles on the screen
+const unsigned int FAKEGL_CW = 1;
+const unsigned int FAKEGL_CCW = 2;
+// constants for EnableClientState()/DisableClientState()
+const unsigned int FAKEGL_VERTEX_ARRAY = 1;
+const unsigned int FAKEGL_NORMAL_ARRAY = 2;
+const unsigned int FAKEGL_COLOR_ARRAY = 3;
+const unsigned int FAKEGL_TEXTURE_COORD_ARRAY = 4;
 // constants for Light() - actually bit flags
 const unsigned int FAKEGL_POSITION = 1;
 const unsigned int FAKEGL_AMBIENT = 2;
@@ -62,6 +89,72 @@ const unsigned int FAKEGL_PROJECTION = 2;
 // constants for texture operations
 const unsigned int FAKEGL_MODULATE = 1;
 const unsigned int FAKEGL_REPLACE = 2;
+// constants for DepthFunc() - bit flags for which of less, equal & greater pass
+const unsigned int FAKEGL_NEVER = 0;
+const unsigned int FAKEGL_LESS = 1;
+const unsigned int FAKEGL_EQUAL = 2;
+const unsigned int FAKEGL_LEQUAL = 3;
+const unsigned int FAKEGL_GREATER = 4;
+const unsigned int FAKEGL_NOTEQUAL = 5;
+const unsigned int FAKEGL_GEQUAL = 6;
+const unsigned int FAKEGL_ALWAYS = 7;
+// constants for DepthFormat()
+const unsigned int FAKEGL_DEPTH_COMPONENT16 = DEPTH_FORMAT_16;
+const unsigned int FAKEGL_DEPTH_COMPONENT24 = DEPTH_FORMAT_24;
+const unsigned int FAKEGL_DEPTH_COMPONENT32F = DEPTH_FORMAT_32F;
+// constants for NewList()
+const unsigned int FAKEGL_COMPILE = 1;
+const unsigned int FAKEGL_COMPILE_AND_EXECUTE = 2;
+// CallList() goes no deeper than this, so a list that calls itself stops
+const unsigned int FAKEGL_MAX_LIST_NESTING = 64;
+// LevelOfDetail() gives every triangle of the level it picks at least this many pixels
+// of the object's bounding sphere on screen (only about half face the eye, so those drawn
+// get twice that) - with smaller triangles than this, more of them add time but not detail
+const float FAKEGL_LOD_PIXELS_PER_TRIANGLE = 2.0f;
+// rasteriser constants
+// triangles are snapped to 1/256th of a pixel
+const int FAKEGL_SUBPIXEL_BITS = 8;
+// lines are stepped a pixel at a time in fixed point with this many bits after the point,
+// enough that the error added up along a line across the whole guard band stays far below a pixel
+const int FAKEGL_LINE_FRACTION_BITS = 32;
+// beyond this many pixels from the origin the fixed point values would overflow
+const float FAKEGL_FIXED_POINT_LIMIT = 16384.0f;
+// primitives are clipped to the near & far planes, and to a guard band this many pixels
+// either side of the origin rather than to the screen edges - the rasterisers only visit
+// pixels on the screen anyway, so all clipping at the sides has to do is keep the fixed
+// point values from overflowing (and the frame buffer is at most 4096 pixels across)
+const float FAKEGL_GUARD_BAND = 8192.0f;
+// near, far, then the guard band's left, right, bottom & top
+const int FAKEGL_CLIP_PLANES = 6;
+// clipping a triangle to each plane in turn adds at most one vertex per plane
+const int FAKEGL_MAX_CLIPPED_VERTICES = 3 + FAKEGL_CLIP_PLANES;
+// coverage is tested 8x8 pixels at a time, one bit per pixel of a 64-bit mask
+// which is also the block size of the depth buffer, so a raster block is a depth block
+const int FAKEGL_RASTER_BLOCK = DEPTH_BLOCK_SIZE;
+// with several render threads, the screen is split into tiles this many pixels square
+// - the size of a Hi-Z tile, so no two threads share one
+const int FAKEGL_TILE_SIZE = DEPTH_BLOCK_SIZE * DEPTH_TILE_BLOCKS;
+// Hi-Z tests are made this much (as a fraction of the depth range) in favour of drawing,
+// so that rounding in the rasteriser's depths can never get something wrongly culled
+const double FAKEGL_HIZ_MARGIN = 1.0e-5;
+// and vertices are transformed in chunks of this many
+const size_t FAKEGL_TRANSFORM_CHUNK = 1024;
+// and within a chunk, transformed & lit this many at a time, laid out as a structure of arrays
+// so that the compiler can work on several vertices at once
+const size_t FAKEGL_TRANSFORM_BATCH = 16;
+// triangles are shaded by kernels specialised for the state that changes what a fragment
+// needs - these flags say which, and are added together to index the kernel
+const unsigned int FAKEGL_KERNEL_DEPTH_TEST = 1;
+const unsigned int FAKEGL_KERNEL_PHONG = 2;
+const unsigned int FAKEGL_KERNEL_REPLACE = 4;
+const unsigned int FAKEGL_KERNEL_MODULATE = 8;
+// REPLACE & MODULATE never go together, so the last index is 1 + 2 + 8
+const unsigned int FAKEGL_KERNELS = 12;
+// with deferred shading, Phong triangles use a kernel that only fills in the G-buffer - it
+// needs no other flags than the depth test, as lighting & texturing are left until Flush()
+const unsigned int FAKEGL_KERNEL_DEFERRED = 16;
+// a G-buffer pixel with nothing waiting to be lit, or a triangle that can't be deferred
+const uint32_t FAKEGL_NO_MATERIAL = 0xFFFFFFFFu;
 
 // class with vertex attributes
 class vertexWithAttributes
@@ -88,35 +181,133 @@ class vertexWithAttributes
 
     }; // class vertexWithAttributes
 
+// the material properties of a vertex, which Phong shading needs at every pixel
+class vertexMaterial
+    { // class vertexMaterial
+    public:
+    float spec[4];
+    float amb[4];
+    float diff[4];
+    float emiss[4];
+    float shin;
+    }; // class vertexMaterial
+
 // class for a vertex after transformation to screen space
+// the raster queue copies these about (clipping, culling, DrawElements()), so they only hold
+// what every draw needs - everything else is in FakeGL's varyings & drawMaterials
 class screenVertexWithAttributes
     { // class screenVertexWithAttributes
     public:
 	// Position in DCS
     Cartesian3 position;
 
-    // Position in eye coordinates
-    Homogeneous4 ePos;
+    // Position in CCS, which clipping interpolates
+    Homogeneous4 clipPosition;
+    // one bit for each clip plane the vertex is outside
+    unsigned int clipCode;
 
-    Cartesian3 normal;
-    
 	// Colour
     RGBAValue colour;
 
-    // Material properties
-    float spec[4];
-    float amb[4];
-    float diff[4];
-    float emiss[4];
-    float shin;
+    // the vertex's record in FakeGL::varyings - vertices that DrawElements() shares have one between them
+    uint32_t varying;
+    // and its material in FakeGL::drawMaterials, if the draw's vertices carry them
+    uint32_t material;
 
-    // Texture properties
-    Cartesian3 texCoord;
+    // with deferred shading, the first vertex of each triangle says which of the
+    // deferred materials it has, or FAKEGL_NO_MATERIAL if it is shaded as usual
+    uint32_t materialId;
 
 	// you may need to add more state here
 
     }; // class screenVertexWithAttributes
 
+// a rectangle of pixels the rasteriser may write, inclusive at both ends
+class rasterRectangle
+    { // class rasterRectangle
+    public:
+    int minCol, minRow, maxCol, maxRow;
+    }; // class rasterRectangle
+
+// a client vertex array: floats the application owns, read a vertex at a time by DrawArrays() & DrawElements()
+class clientArray
+    { // class clientArray
+    public:
+    bool enabled = false;
+    // floats per vertex
+    int size = 0;
+    // bytes from one vertex to the next, or 0 if they are packed together
+    size_t stride = 0;
+    const float *pointer = nullptr;
+
+    // the first float of a vertex
+    inline const float *Element(size_t index) const
+        { return (const float *) ((const char *) pointer + index * (stride ? stride : size * sizeof(float))); }
+    }; // class clientArray
+
+// a display list: what was recorded between NewList() & EndList(), as a stream of 32 bit
+// words - an opcode, then its arguments - with the vertices of its primitives kept apart,
+// complete with their attributes, so that replaying a primitive is a single draw
+class displayList
+    { // class displayList
+    public:
+    // true once NewList() has recorded it
+    bool defined = false;
+    std::vector<uint32_t> commands;
+    std::vector<vertexWithAttributes> vertices;
+    // the images TexImage2D() was given, which the commands refer to by index
+    std::vector<const RGBAImage *> textures;
+
+    // appends an argument to the stream
+    inline void Put(uint32_t word)
+        { commands.push_back(word); }
+    inline void Put(int value)
+        { commands.push_back((uint32_t) value); }
+    inline void Put(float value)
+        { uint32_t word; memcpy(&word, &value, sizeof(word)); commands.push_back(word); }
+    inline void PutFloats(const float *values, size_t count)
+        { for (size_t i = 0; i < count; i++) Put(values[i]); }
+    }; // class displayList
+
+// what deferred shading needs to light a surface once its visible pixels are known
+class deferredMaterial
+    { // class deferredMaterial
+    public:
+    float amb[4];
+    float diff[4];
+    float spec[4];
+    float emiss[4];
+    float shin;
+    // FAKEGL_KERNEL_REPLACE, FAKEGL_KERNEL_MODULATE or neither
+    unsigned int texturing;
+    const RGBAImage *texture;
+    }; // class deferredMaterial
+
+// the G-buffer for deferred shading: one attribute per array, so the lighting pass
+// can work along a row of pixels with vector instructions
+class deferredGBuffer
+    { // class deferredGBuffer
+    public:
+    long width = 0, height = 0;
+    // normal & position in VCS, and texture coordinates
+    std::vector<float> normalX, normalY, normalZ;
+    std::vector<float> eyeX, eyeY, eyeZ;
+    std::vector<float> texU, texV;
+    // an index into FakeGL::deferredMaterials, or FAKEGL_NO_MATERIAL
+    std::vector<uint32_t> material;
+
+    // resizes the buffer, leaving nothing waiting to be lit
+    inline void Resize(long Width, long Height)
+        { // Resize()
+        width = Width;
+        height = Height;
+        size_t nPixels = (size_t) width * height;
+        for (std::vector<float> *attribute : { &normalX, &normalY, &normalZ, &eyeX, &eyeY, &eyeZ, &texU, &texV })
+            attribute->resize(nPixels);
+        material.assign(nPixels, FAKEGL_NO_MATERIAL);
+        } // Resize()
+    }; // class deferredGBuffer
+
 // class for a fragment with attributes
 class fragmentWithAttributes
     { // class fragmentWithAttributes
@@ -124,8 +315,6 @@ class fragmentWithAttributes
     // the row & column address in the framebuffer
     int row, col;
 
-    Cartesian3 normal;
-
     float depth;
     // the RGBA colour of the fragment
     RGBAValue colour;
@@ -155,6 +344,31 @@ class FakeGL
     //-----------------------------
 
     bool dBufferingEnabled = false;
+    // lays down the depth of every triangle before any of them are shaded
+    bool depthPrePassEnabled = false;
+    // true while that first, depth-only, pass is running
+    bool depthOnlyPass = false;
+    // which comparisons with the stored depth pass - FakeGL has always kept
+    // fragments at the same depth, so the default is LEQUAL rather than LESS
+    unsigned int depthFunc = FAKEGL_LEQUAL;
+    float depthClearValue = 1.f;
+    // skips triangles, draw calls & blocks that the depth buffer's Hi-Z pyramid shows are hidden
+    bool hiZEnabled = true;
+
+    // drops triangles facing the way CullFace() names before they are rasterised
+    bool cullFaceEnabled = false;
+    unsigned int cullFaceMode = FAKEGL_BACK;
+    unsigned int frontFace = FAKEGL_CCW;
+
+    // triangles dropped before rasterising, for facing the wrong way or covering no pixel centre
+    unsigned long long setupCulledTriangles = 0;
+    // what Hi-Z has culled - with several threads, a triangle counts once for each tile it was culled in
+    std::atomic<unsigned long long> hiZCulledTriangles{0};
+    std::atomic<unsigned long long> hiZCulledBlocks{0};
+    // fragments that passed the early depth test & went on to be written (or left in the G-buffer)
+    // - only counted while countFragments is set, as adding them up costs time on every thread
+    bool countFragments = false;
+    std::atomic<unsigned long long> fragmentCount{0};
     RGBAValue drawColor;
 
     float windowX=0 , windowY=0,
@@ -167,7 +381,9 @@ class FakeGL
     //-----------------------------
 
     // we want a queue of vertices with attributes for passing to the rasteriser
-    std::deque<vertexWithAttributes> vertexQueue;
+    // the pipeline buffers are flat arrays processed a whole batch at a time in End()
+    // clear() keeps their capacity, so once warmed up a frame allocates nothing
+    std::vector<vertexWithAttributes> vertexQueue;
 
     //-----------------------------
     // TRANSFORM/LIGHTING STATE
@@ -188,11 +404,57 @@ class FakeGL
     float matEmission[4] = {0.,0.,0.,1.};
     float matShininess = 0.;
 
+    // makes the colour set the material parameters named by ColorMaterial() as well
+    bool colorMaterialEnabled = false;
+    unsigned int colorMaterialParameter = FAKEGL_AMBIENT_AND_DIFFUSE;
+
+    //-----------------------------
+    // VERTEX ARRAY STATE
+    //-----------------------------
+
+    // where DrawArrays() & DrawElements() read attributes from - disabled ones come from the current state
+    clientArray vertexArray, normalArray, colorArray, texCoordArray;
+
+    // DrawElements() transforms each vertex it uses once, into here, and the raster queue takes copies
+    std::vector<screenVertexWithAttributes> transformedVertices;
+
     //-----------------------------
     // OUTPUT FROM TRANSFORM STAGE
     // INPUT TO RASTER STAGE
     //-----------------------------
-    std::deque<screenVertexWithAttributes> rasterQueue;
+    std::vector<screenVertexWithAttributes> rasterQueue;
+
+    //-----------------------------
+    // VARYING STATE
+    //-----------------------------
+
+    // what the vertices of a draw carry besides position & colour, declared at its start by
+    // DeclareVaryings() from the state: varyingStride floats a vertex, packed together, and
+    // only the ones the shading kernel reads - so Gouraud shading carries none at all
+    std::vector<float> varyings;
+    size_t varyingStride = 0;
+    // where each is in a vertex's record: the normal in OCS & the position in VCS for Phong
+    // shading, the texture coordinates (two floats) for texturing, and the normal in VCS
+    // that DeferTriangles() works out for deferred shading
+    size_t varyingNormal = 0, varyingEye = 0, varyingTexCoord = 0, varyingNormalVCS = 0;
+    // true if the draw's triangles are deferred
+    bool varyingsDeferred = false;
+
+    // Phong shading also needs the material at every pixel, which nearly always stays the same
+    // for a whole draw - so the vertices refer to these rather than each having a copy
+    bool varyingMaterials = false;
+    std::vector<vertexMaterial> drawMaterials;
+
+    //-----------------------------
+    // CLIPPING STATE
+    //-----------------------------
+
+    // the clip planes, worked out from the viewport at the start of End()
+    // a position is inside plane i when clipPlanes[i] . (x, y, z, w) >= 0
+    float clipPlanes[FAKEGL_CLIP_PLANES][4] = {};
+
+    // when some primitives need clipping, the batch is rebuilt here & swapped with the raster queue
+    std::vector<screenVertexWithAttributes> clippedQueue;
 
     //-----------------------------
     // RASTERISE STATE
@@ -202,11 +464,75 @@ class FakeGL
     unsigned int pointSize=1;
     unsigned int lineWidth=1;
 
+    // forces the original floating point rasteriser for every triangle (for comparison)
+    bool floatRasteriser = false;
+
+    // the FAKEGL_KERNEL_ flags for the current draw, set once by SelectShadingKernel()
+    unsigned int shadingKernel = 0;
+    // and what Phong shading needs that can't change during a draw
+    Matrix4 shadingModelView;
+    Cartesian3 shadingLightDirection, shadingLightUnit;
+
+    //-----------------------------
+    // DEFERRED SHADING STATE
+    //-----------------------------
+
+    // Phong triangles only fill in the G-buffer, and Flush() lights the pixels that are left
+    bool deferredShadingEnabled = false;
+    // true for a draw whose triangles are being deferred
+    bool shadingDeferred = false;
+    // true while the G-buffer has pixels waiting to be lit
+    bool deferredPending = false;
+    // and the rows they are in
+    long deferredFirstRow = 0, deferredLastRow = -1;
+
+    deferredGBuffer gBuffer;
+    // the surfaces the G-buffer's pixels refer to
+    std::vector<deferredMaterial> deferredMaterials;
+    // the light they are all lit by - a draw with a different light flushes what came before
+    Cartesian3 deferredLightDirection, deferredLightUnit;
+    float deferredLightAmbient[4], deferredLightDiffuse[4], deferredLightSpecular[4];
+
+    //-----------------------------
+    // DISPLAY LIST STATE
+    //-----------------------------
+
+    // list n is displayLists[n - 1]
+    std::vector<displayList> displayLists;
+    // the list NewList() is recording, or 0, and whether its commands run as well
+    unsigned int compilingList = 0;
+    bool compileAndExecute = false;
+    // while recording, true between Begin() & End(), with the primitive type & its first vertex
+    bool compilingPrimitive = false;
+    unsigned int compilingPrimType = FAKEGL_POINTS;
+    size_t compilingFirstVertex = 0;
+    // the attributes current at NewList(), which FAKEGL_COMPILE puts back at EndList()
+    vertexWithAttributes compileSavedAttributes;
+    bool compileSavedColorMaterial = false;
+    unsigned int compileSavedColorMaterialParameter = FAKEGL_AMBIENT_AND_DIFFUSE;
+    // how deeply CallList() is nested
+    unsigned int callListDepth = 0;
+
+    //-----------------------------
+    // THREADING STATE
+    //-----------------------------
+
+    // the threads that share the work of End()
+    RenderThreadPool threadPool;
+
+    // with more than one thread, the primitives that might touch each screen tile, in order
+    std::vector<std::vector<uint32_t> > tileBins;
+    int nTileCols = 0, nTileRows = 0;
+
     //-----------------------------
     // OUTPUT FROM RASTER STAGE
     // INPUT TO FRAGMENT STAGE
     //-----------------------------
-    std::deque<fragmentWithAttributes> fragmentQueue;
+    // fragments normally go straight from the rasteriser to ProcessFragment()
+    // since there is no blending to order them by; set deferFragments to
+    // collect them here instead (e.g. to inspect them in a context dump)
+    bool deferFragments = false;
+    std::vector<fragmentWithAttributes> fragmentQueue;
 
     //-----------------------------
     // TEXTURE STATE
@@ -224,12 +550,20 @@ class FakeGL
     
     RGBAValue fbClearColor;
 
-	// the frame buffer itself
+	// the frame buffer itself - call Flush() before reading it
     RGBAImage frameBuffer;
      
-    // rather than define an extra class, we will cheat and use 
-    // a second RGBAImage in which the alpha stores the depth buffer
-    RGBAImage depthBuffer;
+    // the depth buffer - 24 bit unless DepthFormat() says otherwise
+    DepthBuffer depthBuffer;
+
+    // Clear() only marks the screen tiles of the frame buffer as waiting for the clear colour,
+    // and the pixels of each are filled in when something is first drawn there, or by Flush()
+    std::vector<char> colourClearPending;
+    RGBAValue colourClearValue;
+    // the frame buffer size they were marked for - a resized frame buffer has lost them
+    long colourClearWidth = 0, colourClearHeight = 0;
+    // true once tiles of either buffer have been marked, so draws have to look at theirs
+    bool clearPending = false;
     
     //-------------------------------------------------//
     //                                                 //
@@ -322,6 +656,74 @@ class FakeGL
     // sets the vertex & launches it down the pipeline
     void Vertex3f(float x, float y, float z);
 
+    //-------------------------------------------------//
+    //                                                 //
+    // VERTEX ARRAY ROUTINES                           //
+    //                                                 //
+    // Arrays are floats only, and are read when       //
+    // DrawArrays() or DrawElements() is called        //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // sets the array of positions: size (2, 3 or 4) floats per vertex, stride bytes apart (0 if packed)
+    void VertexPointer(int size, size_t stride, const float *pointer);
+
+    // sets the array of normals: 3 floats per vertex
+    void NormalPointer(size_t stride, const float *pointer);
+
+    // sets the array of colours: size (3 or 4) floats in [0, 1] per vertex
+    void ColorPointer(int size, size_t stride, const float *pointer);
+
+    // sets the array of texture coordinates: size (1, 2 or 3) floats per vertex
+    void TexCoordPointer(int size, size_t stride, const float *pointer);
+
+    // turns one of the arrays on
+    void EnableClientState(unsigned int array);
+
+    // turns one of the arrays off, so that attribute comes from the current state again
+    void DisableClientState(unsigned int array);
+
+    // draws primitives from count vertices of the arrays in turn, starting at first
+    void DrawArrays(unsigned int mode, size_t first, size_t count);
+
+    // draws primitives from the array vertices that count indices name
+    // each vertex is lit & transformed once, however many primitives share it - every vertex
+    // between the lowest & highest index is, so the indices should use most of that range
+    void DrawElements(unsigned int mode, size_t count, const unsigned int *indices);
+
+    //-------------------------------------------------//
+    //                                                 //
+    // DISPLAY LIST ROUTINES                           //
+    //                                                 //
+    // A list records the drawing & state calls        //
+    // between NewList() & EndList().  The vertex      //
+    // array, display list, threading, DepthFormat()   //
+    // & Flush() calls are not recorded, but run       //
+    // at once.  Unlike OpenGL, a vertex is recorded   //
+    // with all of its attributes, including any that  //
+    // were set before NewList()                       //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // reserves range unused list names, returning the first (0 if range is 0)
+    unsigned int GenLists(unsigned int range);
+
+    // starts recording list, replacing whatever it held, with mode FAKEGL_COMPILE
+    // or FAKEGL_COMPILE_AND_EXECUTE (which also runs the calls as they are made)
+    void NewList(unsigned int list, unsigned int mode);
+
+    // stops recording
+    void EndList();
+
+    // replays a list: its primitives go straight to the transform stage, without per vertex calls
+    void CallList(unsigned int list);
+
+    // frees range lists starting at list
+    void DeleteLists(unsigned int list, unsigned int range);
+
+    // true if NewList() has recorded list
+    bool IsList(unsigned int list);
+
     //-------------------------------------------------//
     //                                                 //
     // STATE VARIABLE ROUTINES                         //
@@ -333,6 +735,12 @@ class FakeGL
     
     // enables a specific flag in the library
     void Enable(unsigned int property);
+
+    // sets which triangles FAKEGL_CULL_FACE drops: FAKEGL_FRONT, FAKEGL_BACK or FAKEGL_FRONT_AND_BACK
+    void CullFace(unsigned int mode);
+
+    // sets which winding on the screen faces the front: FAKEGL_CCW (the default) or FAKEGL_CW
+    void FrontFace(unsigned int mode);
     
     //-------------------------------------------------//
     //                                                 //
@@ -343,6 +751,9 @@ class FakeGL
     // sets properties for the one and only light
     void Light(int parameterName, const float *parameterValues);
 
+    // sets which material parameters follow the colour while FAKEGL_COLOR_MATERIAL is enabled
+    void ColorMaterial(unsigned int parameterName);
+
     //-------------------------------------------------//
     //                                                 //
     // TEXTURE PROCESSING ROUTINES                     //
@@ -369,6 +780,15 @@ class FakeGL
     
     // sets the clear colour for the frame buffer
     void ClearColor(float red, float green, float blue, float alpha);
+
+    // sets the depth the depth buffer is cleared to
+    void ClearDepth(float depth);
+
+    // sets the comparison that decides whether a fragment is drawn
+    void DepthFunc(unsigned int func);
+
+    // sets the precision of the depth buffer, which is left at the far plane
+    void DepthFormat(unsigned int format);
     
     //-------------------------------------------------//
     //                                                 //
@@ -376,32 +796,230 @@ class FakeGL
     //                                                 //
     //-------------------------------------------------//
     
-    // flushes the pipeline
+    // flushes the pipeline, filling in clears still waiting & lighting anything deferred
+    // shading has left in the G-buffer - so call it before reading the frame buffer
     void Flush();
 
+    //-------------------------------------------------//
+    //                                                 //
+    // THREADING ROUTINES                              //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // sets how many threads render, counting the calling thread
+    // 0 uses one per core; 1 (the default) renders everything on the calling thread
+    void RenderThreads(unsigned int nThreads);
+
+    //-------------------------------------------------//
+    //                                                 //
+    // CULLING & LEVEL OF DETAIL ROUTINES              //
+    //                                                 //
+    // These let the application skip objects that    //
+    // can't be seen, or draw simpler versions of      //
+    // small ones, using bounding volumes in OCS       //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // true if a sphere is wholly outside what the current matrices show of the frame buffer
+    // - between the near & far planes, and on the screen - so nothing inside it can be drawn
+    bool CullSphere(float x, float y, float z, float radius);
+
+    // the same for an axis aligned box
+    bool CullBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ);
+
+    // roughly the radius on screen, in pixels, of a sphere - infinite if it reaches the eye
+    float ProjectedRadius(float x, float y, float z, float radius);
+
+    // picks which of nLevels versions of an object inside a sphere to draw: the most detailed
+    // whose triangles each have FAKEGL_LOD_PIXELS_PER_TRIANGLE pixels of the sphere on screen
+    // triangleCounts holds the size of each version, the most detailed (level 0) first
+    unsigned int LevelOfDetail(float x, float y, float z, float radius, const size_t *triangleCounts, unsigned int nLevels);
+
     //-------------------------------------------------//
     //                                                 //
     // MAJOR PROCESSING ROUTINES                       //
     //                                                 //
     //-------------------------------------------------//
 
-    // transform one vertex & shift to the transformed queue
-    void TransformVertex();
+    // fills in a vertex with the current state, as Vertex3f() would
+    void CurrentVertex(vertexWithAttributes &vert);
+
+    // makes a vertex's attributes the current ones, as CurrentVertex() would have made it
+    void SetCurrentAttributes(const vertexWithAttributes &vert);
+
+    // sets the current material parameters named by a Materialfv() style bit mask
+    void SetMaterial(unsigned int parameterName, const float *parameterValues);
+
+    // fills in vertex index of the enabled arrays, taking anything else from the current state
+    void FetchVertex(size_t index, vertexWithAttributes &vert);
+
+    // while a list is being recorded, adds a command to it
+    // returns true if the call is only recorded, and shouldn't run as well
+    template <typename... Arguments> inline bool Record(uint32_t opcode, Arguments... arguments)
+        { // Record()
+        if (compilingList == 0)
+            return false;
+        displayList &list = displayLists[compilingList - 1];
+        list.Put(opcode);
+        (list.Put(arguments), ...);
+        return !compileAndExecute;
+        } // Record()
+
+    // replays the commands of a list
+    void ReplayList(const displayList &list);
+
+    // empties the queues for a new primitive, which Begin() & the draw calls share
+    void StartPrimitive(unsigned int PrimitiveType);
 
-    // rasterise a single primitive if there are enough vertices on the queue
-    bool RasterisePrimitive();
+    // transforms vertices onto the end of the raster queue - the first half of End()
+    void TransformVertices(const vertexWithAttributes *vertices, size_t nVertices);
+
+    // clips & rasterises the complete primitives in the raster queue, and then
+    // processes any fragments held back - the second half of End()
+    void DrawRasterQueue();
+
+    // picks the shading kernel, and the varyings & materials the draw's vertices carry for it
+    // called by each draw before any of its vertices are transformed
+    void DeclareVaryings();
+
+    // transforms & lights up to FAKEGL_TRANSFORM_BATCH vertices into their raster queue entries,
+    // with their varyings going into records firstRecord onwards
+    void TransformBatch(const vertexWithAttributes *vertices, size_t nVertices, screenVertexWithAttributes *transformed, size_t firstRecord);
+
+    // fetches & transforms nVertices vertices of the arrays, starting at first, into transformed
+    // - records 0 to nVertices - 1 - with a material each only if the colour array changes it
+    void TransformArrayVertices(size_t first, size_t nVertices, screenVertexWithAttributes *transformed);
+
+    // converts a position in CCS to DCS
+    Cartesian3 WindowCoordinates(const Homogeneous4 &vertCCS);
+
+    // works out the clip planes for the current viewport
+    void SetClipPlanes();
+
+    // works out the planes bounding what can be drawn, in OCS, for culling
+    // a position is inside plane i when planes[i] . (x, y, z, 1) >= 0
+    void CullPlanes(float planes[FAKEGL_CLIP_PLANES][4]);
+
+    // the clip planes a position in CCS is outside, one bit each
+    unsigned int ClipCode(const Homogeneous4 &vertCCS);
+
+    // the vertex a fraction t of the way from one vertex to another, in CCS
+    void InterpolateVertex(const screenVertexWithAttributes &from, const screenVertexWithAttributes &to, float t, screenVertexWithAttributes &result);
+
+    // clips the complete primitives in the raster queue, dropping the ones wholly outside
+    // a clip plane & replacing the ones that cross one with the parts inside
+    void ClipPrimitives();
+
+    // clips a convex polygon to the planes in clipCode, returning the number of vertices left
+    int ClipPolygon(screenVertexWithAttributes *polygon, int nVertices, unsigned int clipCode);
+
+    // drops the complete triangles in the raster queue that face the way CullFace() names,
+    // have no area, or are too thin or too small to cover a pixel centre, from their signed area
+    // & bounding box alone - so nothing later in the draw spends any time on them
+    void CullTriangles();
+
+    // rasterise the primitive starting at rasterQueue[nextVertex] if there are enough vertices
+    // and advance nextVertex past it; only pixels inside the clip rectangle are drawn
+    bool RasterisePrimitive(size_t &nextVertex, const rasterRectangle &clip);
+
+    // the number of queued vertices each primitive uses
+    size_t VerticesPerPrimitive();
+
+    // the pixels of one screen tile
+    rasterRectangle TileRectangle(size_t tile);
+
+    // sorts the complete primitives in the raster queue into the tiles they might cover
+    // returns the number of primitives
+    size_t BinPrimitives();
+
+    // how far the pixels of a primitive can reach beyond its vertices
+    float PrimitiveReach();
+
+    // fills in any clear still waiting in a screen tile, of both buffers
+    void ResolveTileClear(long tileRow, long tileCol);
+
+    // fills in any clear still waiting in a screen tile of the frame buffer
+    void ResolveColourTileClear(long tileRow, long tileCol);
+
+    // fills in the clears still waiting in the tiles the raster queue might cover
+    void ResolveQueueClears();
+
+    // fills in the clears still waiting in the frame buffer - the depth buffer's go on waiting
+    void ResolveColourClears();
 
     // rasterises a single point
-    void RasterisePoint(screenVertexWithAttributes &vertex0);
+    void RasterisePoint(screenVertexWithAttributes &vertex0, const rasterRectangle &clip);
 
     // rasterises a single line segment
-    void RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1);
+    void RasteriseLineSegment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, const rasterRectangle &clip);
+
+    // rasterises a single line segment as two triangles, for lines lit or textured per pixel
+    void RasteriseLineQuad(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, const rasterRectangle &clip);
+
+    // writes a run of pixels of one depth & colour, in a row or a column, as ProcessFragment() would one at a time
+    void WriteSpan(long row, long col, long count, bool vertical, float depth, const RGBAValue &colour);
     
+    // picks the shading kernel for the current state, at the start of a draw
+    void SelectShadingKernel();
+
+    // with deferred shading, sets up a draw's triangles to fill in the G-buffer
+    // and moves their normals into VCS, so the rasteriser doesn't have to per pixel
+    void DeferTriangles();
+
+    // lights the pixels waiting in the G-buffer, a band of rows at a time
+    void ResolveDeferredShading();
+
     // rasterises a single triangle
-    void RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2);
+    void RasteriseTriangle(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip);
+
+    // the rasterisers & shading below are compiled once for each combination of FAKEGL_KERNEL_ flags,
+    // so a pixel neither tests state nor interpolates anything that state doesn't use
+
+    // rasterises a single triangle with whichever rasteriser suits it
+    template <unsigned int kernel>
+    void RasteriseTriangleKernel(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip);
+
+    // rasterises a single triangle with fixed point edge functions, a block of pixels at a time
+    // returns false without drawing anything if the triangle is too large for fixed point
+    template <unsigned int kernel>
+    bool RasteriseTriangleFixed(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip);
+
+    // rasterises a single triangle by testing every pixel of its bounding box in floating point
+    template <unsigned int kernel>
+    void RasteriseTriangleFloat(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2, const rasterRectangle &clip);
+
+    // shades one covered pixel of a triangle given its barycentric coordinates
+    template <unsigned int kernel>
+    void ShadeTriangleFragment(screenVertexWithAttributes &vertex0, screenVertexWithAttributes &vertex1, screenVertexWithAttributes &vertex2,
+            float alpha, float beta, float gamma, fragmentWithAttributes &rasterFragment);
     
+    // whether the Hi-Z pyramid can be relied on for the current depth test
+    bool HiZUsable();
+
+    // what the depth buffer would store for a depth in DCS, clamped to the depth range
+    uint32_t QuantiseDepth(double depth);
+
+    // whether the Hi-Z pyramid shows a depth fails the depth test everywhere in a rectangle of pixels
+    bool HiZHidden(const rasterRectangle &rectangle, uint32_t nearest);
+
+    // whether every complete triangle in the raster queue is hidden, tested together
+    bool BatchHidden();
+
+    // compares a fragment's depth with the stored one using depthFunc
+    bool DepthPasses(uint32_t fragDepth, uint32_t storedDepth);
+
+    // the depth test for a fragment on the screen, storing its depth if it passes
+    bool DepthTestAndWrite(const fragmentWithAttributes &frag);
+
+    // tests a fragment against the depth buffer before it is shaded
+    // returns false if it can never reach the frame buffer
+    bool EarlyDepthTest(const fragmentWithAttributes &frag);
+
+    // hands a fragment from the rasteriser to the fragment stage
+    void EmitFragment(const fragmentWithAttributes &fragment);
+
     // process a single fragment
-    void ProcessFragment();
+    void ProcessFragment(const fragmentWithAttributes &frag);
     
     }; // class FakeGL
 
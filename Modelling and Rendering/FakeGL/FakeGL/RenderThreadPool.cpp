@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  ------------------------
+//  RenderThreadPool.cpp
+//  ------------------------
+//
+//  A fixed set of worker threads that FakeGL hands its pipeline
+//  stages to.  Run() splits a job into numbered pieces, which the
+//  workers & the calling thread take in turn until none are left.
+//
+///////////////////////////////////////////////////
+
+#include "RenderThreadPool.h"
+
+// constructor - starts with no workers, so jobs run on the calling thread
+RenderThreadPool::RenderThreadPool()
+    :
+    generation(0),
+    stopping(false),
+    nBusy(0),
+    currentJob(nullptr),
+    nCurrentPieces(0),
+    nextPiece(0)
+    { // constructor
+    } // constructor
+
+// destructor - stops the workers
+RenderThreadPool::~RenderThreadPool()
+    { // destructor
+    Resize(1);
+    } // destructor
+
+// sets the number of threads, counting the one that calls Run()
+void RenderThreadPool::Resize(unsigned int nThreads)
+    { // Resize()
+    if (nThreads < 1)
+        nThreads = 1;
+    if (nThreads == Size())
+        return;
+
+    // simplest to stop them all & start again - this only happens when the setting changes
+    { // locked
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    } // locked
+    jobReady.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+
+    // the workers are told the current generation, rather than reading it once they get going,
+    // or one that starts late could mistake the first job for one it has already done
+    stopping = false;
+    for (unsigned int worker = 1; worker < nThreads; worker++)
+        workers.emplace_back(&RenderThreadPool::Work, this, generation);
+    } // Resize()
+
+// the number of threads, counting the one that calls Run()
+unsigned int RenderThreadPool::Size() const
+    { // Size()
+    return (unsigned int) workers.size() + 1;
+    } // Size()
+
+// calls job(piece) once for every piece in [0, nPieces), spread over the threads
+void RenderThreadPool::Run(size_t nPieces, const std::function<void(size_t)> &job)
+    { // Run()
+    if (nPieces == 0)
+        return;
+
+    // not worth waking anybody for a single piece
+    if (workers.empty() || nPieces == 1)
+        { // on this thread
+        for (size_t piece = 0; piece < nPieces; piece++)
+            job(piece);
+        return;
+        } // on this thread
+
+    { // locked
+    std::lock_guard<std::mutex> lock(mutex);
+    currentJob = &job;
+    nCurrentPieces = nPieces;
+    nextPiece = 0;
+    nBusy = (unsigned int) workers.size();
+    generation++;
+    } // locked
+    jobReady.notify_all();
+
+    // the calling thread works too, rather than waiting idle
+    TakePieces();
+
+    // and then waits for the workers to finish their last pieces
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this]() { return nBusy == 0; });
+    currentJob = nullptr;
+    } // Run()
+
+// the workers' loop
+void RenderThreadPool::Work(unsigned long seenGeneration)
+    { // Work()
+    while (true)
+        { // per job
+        { // locked
+        std::unique_lock<std::mutex> lock(mutex);
+        jobReady.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+        if (stopping)
+            return;
+        seenGeneration = generation;
+        } // locked
+
+        TakePieces();
+
+        { // locked
+        std::lock_guard<std::mutex> lock(mutex);
+        nBusy--;
+        } // locked
+        jobDone.notify_one();
+        } // per job
+    } // Work()
+
+// takes pieces of the current job until there are none left
+void RenderThreadPool::TakePieces()
+    { // TakePieces()
+    const std::function<void(size_t)> &job = *currentJob;
+    for (size_t piece = nextPiece++; piece < nCurrentPieces; piece = nextPiece++)
+        job(piece);
+    } // TakePieces()
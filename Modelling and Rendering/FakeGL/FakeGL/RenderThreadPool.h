@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  ------------------------
+//  RenderThreadPool.h
+//  ------------------------
+//
+//  A fixed set of worker threads that FakeGL hands its pipeline
+//  stages to.  Run() splits a job into numbered pieces, which the
+//  workers & the calling thread take in turn until none are left.
+//
+///////////////////////////////////////////////////
+
+#ifndef RENDERTHREADPOOL_H
+#define RENDERTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class RenderThreadPool
+    { // class RenderThreadPool
+    public:
+    // constructor - starts with no workers, so jobs run on the calling thread
+    RenderThreadPool();
+
+    // destructor - stops the workers
+    ~RenderThreadPool();
+
+    // sets the number of threads, counting the one that calls Run()
+    void Resize(unsigned int nThreads);
+
+    // the number of threads, counting the one that calls Run()
+    unsigned int Size() const;
+
+    // calls job(piece) once for every piece in [0, nPieces), spread over the threads
+    // returns once all of them are done; a job must not call Run() itself
+    void Run(size_t nPieces, const std::function<void(size_t)> &job);
+
+    private:
+    // the workers' loop, starting from the job generation they were created in
+    void Work(unsigned long seenGeneration);
+    // takes pieces of the current job until there are none left
+    void TakePieces();
+
+    std::vector<std::thread> workers;
+
+    // guards everything below except nextPiece
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    // bumped for every job, so the workers can tell a new one has arrived
+    unsigned long generation;
+    bool stopping;
+    // the workers still busy with the current job
+    unsigned int nBusy;
+
+    const std::function<void(size_t)> *currentJob;
+    size_t nCurrentPieces;
+    std::atomic<size_t> nextPiece;
+    }; // class RenderThreadPool
+
+#endif
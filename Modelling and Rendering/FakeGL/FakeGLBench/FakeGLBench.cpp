@@ -0,0 +1,1256 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  FakeGLBench.cpp
+//  -----------------------------
+//
+//  Times FakeGL on synthetic scenes without any window, so that changes
+//  to the pipeline can be measured on their own.  Each benchmark prints
+//  one line per case: ms/frame & throughput, best of several frames.
+//  A frame ends with Flush(), as it would before being shown.
+//
+//  Usage: FakeGLBench [options]
+//      --size WxH          frame buffer size (default 1024x768)
+//      --repeats n         most frames timed per case, the fastest counts (default 5)
+//      --bench name        only runs the named benchmark (default all)
+//      --models dir        where the scenes find the bundled .obj files
+//                          (default ../../Raytracer/objects)
+//      --texture file      the texture the scenes use
+//                          (default ../FakeGLRenderer/textures/earth.ppm)
+//      --record dir        writes each scene's image to dir/<scene>.ppm
+//      --golden dir        compares each scene's image with dir/<scene>.ppm,
+//                          and exits with 1 if any differ (default goldens)
+//      --tolerance n       how far (0-255) a channel of a pixel may be from
+//                          the golden image and still match (default 2)
+//
+//  The golden images in goldens/ were recorded from a build known to be
+//  right, and every change to the pipeline is checked against them.  The
+//  scenes are always drawn at their size, 320x240, whatever --size says.
+//  Only record them again for a change that is meant to alter the images.
+//
+//  Benchmarks:
+//      fill    unlit, untextured triangles of a range of sizes tiling the
+//              frame buffer several times over, with the fixed point and
+//              the floating point rasterisers.  Drawn once with every
+//              layer visible, and once with the first layer in front so
+//              that the rest are only rasterised & depth tested
+//      threads a Phong shaded, depth tested sphere filling most of the frame
+//              buffer, drawn with 1, 2, 4 ... threads up to the number of
+//              cores, with the speedup over a single thread
+//      lists   small triangles drawn with a call per vertex, first straight
+//              through the API, then recorded once into a display list &
+//              replayed: the cost of recording, of replaying & the speedup
+//      objects a grid of spheres seen from one side, so that most are off
+//              the screen & most of the rest far away: every sphere drawn,
+//              only those CullSphere() keeps, and those at the level of
+//              detail LevelOfDetail() picks
+//      viewports   a textured, Phong shaded mesh seen from N directions, in
+//              N contexts of a quarter of the frame buffer each, drawing
+//              from the same arrays & texture: in turn on one thread,
+//              then on a thread each, checking the images are the same
+//      wireframe   the edges of a triangulated grid over the frame buffer,
+//              drawn as depth tested lines of a range of widths, in lines
+//              per second
+//      scenes  the bundled models drawn with each part of the pipeline in
+//              turn - lighting, Phong shading, textures, no depth test,
+//              lines & points - in ms/frame, triangles & fragments per
+//              second, checked against the golden images
+//      maths   dot & cross products, matrix-vector & matrix-matrix
+//              products over arrays, in ns per operation: the inline
+//              Maths classes against the same sums as calls the compiler
+//              can't see into, as they were before the Maths became
+//              inline, checking the answers are the same to the bit; then
+//              Matrix4's batched transforms against a product at a time,
+//              and that TransformNormals() keeps normals perpendicular
+//
+////////////////////////////////////////////////////////////////////////
+
+// for M_PI in Visual Studio
+#define _USE_MATH_DEFINES
+
+// system libraries
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// local includes
+#include "FakeGL.h"
+
+// cases are only repeated while they have taken less than this in total
+static const double repeatBudgetMilliseconds = 500.0;
+
+// the size of the golden images, which the scenes are drawn at
+static const int goldenWidth = 320;
+static const int goldenHeight = 240;
+
+// settings shared by every benchmark
+class BenchSettings
+    { // class BenchSettings
+    public:
+    int width = 1024;
+    int height = 768;
+    int repeats = 5;
+    // the scenes' models & texture, relative to the project folder
+    std::string modelDirectory = "../../Raytracer/objects";
+    std::string texturePath = "../FakeGLRenderer/textures/earth.ppm";
+    // golden images are written to recordDirectory, and compared with those in goldenDirectory
+    std::string recordDirectory;
+    std::string goldenDirectory = "goldens";
+    int tolerance = 2;
+    }; // class BenchSettings
+
+// how many scenes didn't match their golden images
+static int failedScenes = 0;
+// and how many maths operations didn't match the out of line versions
+static int failedMaths = 0;
+
+// sets up a context with a frame buffer of the given size
+// and a projection that makes vertex coordinates pixel coordinates
+static void SetUpContext(FakeGL &fakeGL, const BenchSettings &settings)
+    { // SetUpContext()
+    fakeGL.Viewport(0, 0, settings.width, settings.height);
+    fakeGL.frameBuffer.Resize(settings.width, settings.height);
+    fakeGL.depthBuffer.Resize(settings.width, settings.height);
+    fakeGL.MatrixMode(FAKEGL_PROJECTION);
+    fakeGL.LoadIdentity();
+    fakeGL.Ortho(0.0, settings.width, 0.0, settings.height, -1.0, 1.0);
+    fakeGL.MatrixMode(FAKEGL_MODELVIEW);
+    fakeGL.LoadIdentity();
+    fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
+    } // SetUpContext()
+
+// times a frame, repeating it within the budget, and returns the fastest in milliseconds
+template <class DrawFrame> static double TimeFrame(const BenchSettings &settings, DrawFrame drawFrame)
+    { // TimeFrame()
+    double best = 0.0, spent = 0.0;
+    for (int repeat = 0; repeat < settings.repeats && (repeat == 0 || spent < repeatBudgetMilliseconds); repeat++)
+        { // per repeat
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        drawFrame();
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        spent += milliseconds;
+        if (repeat == 0 || milliseconds < best)
+            best = milliseconds;
+        } // per repeat
+    return best;
+    } // TimeFrame()
+
+// fill rate: triangles of a given area, in pairs making squares, tiling the frame buffer
+static void FillBench(const BenchSettings &settings)
+    { // FillBench()
+    // triangle areas in pixels - from a couple of pixels to a large part of the screen
+    static const float triangleAreas[] = { 2.0f, 8.0f, 32.0f, 128.0f, 512.0f, 2048.0f, 8192.0f, 32768.0f };
+    // every case covers the frame buffer this many times, so they all write the same number of pixels
+    const int layers = 4;
+
+    std::cout << "fill: " << settings.width << "x" << settings.height << ", " << layers << " layers" << std::endl;
+    std::cout << std::left << std::setw(10) << "area"
+              << std::setw(9) << "layers"
+              << std::right << std::setw(10) << "triangles"
+              << std::setw(12) << "float ms"
+              << std::setw(12) << "fixed ms"
+              << std::setw(10) << "Mtri/s"
+              << std::setw(12) << "Mpixel/s"
+              << std::setw(10) << "speedup" << std::endl;
+
+    for (float area : triangleAreas)
+        { // per area
+        // squares of side s hold two triangles of area s^2 / 2
+        float side = sqrt(2.0f * area);
+        // the grid is offset by a fraction of a pixel, so edges don't line up with pixel centres
+        // each row of squares is one Begin()/End(), so the pipeline's queues stay a sensible size
+        // x, y & z of each vertex; each layer is further away than the one before
+        std::vector<std::vector<float> > rows;
+        long nTriangles = 0;
+        for (int layer = 0; layer < layers; layer++)
+            for (float y = 0.37f * layer; y < settings.height; y += side)
+                { // per row
+                rows.push_back(std::vector<float>());
+                std::vector<float> &vertices = rows.back();
+                float z = 0.5f - 0.25f * layer;
+                for (float x = 0.61f * layer; x < settings.width; x += side)
+                    { // per square
+                    float square[6][2] = { {x, y}, {x + side, y}, {x + side, y + side},
+                                           {x, y}, {x + side, y + side}, {x, y + side} };
+                    for (int vertex = 0; vertex < 6; vertex++)
+                        { // per vertex
+                        vertices.push_back(square[vertex][0]);
+                        vertices.push_back(square[vertex][1]);
+                        vertices.push_back(z);
+                        } // per vertex
+                    nTriangles += 2;
+                    } // per square
+                } // per row
+
+        // with the depth test on, the nearest layer is drawn first and hides the others
+        for (int hidden = 0; hidden < 2; hidden++)
+            { // visible / hidden
+            double milliseconds[2];
+            for (int rasteriser = 0; rasteriser < 2; rasteriser++)
+                { // per rasteriser
+                FakeGL fakeGL;
+                SetUpContext(fakeGL, settings);
+                fakeGL.floatRasteriser = (rasteriser == 0);
+                if (hidden)
+                    fakeGL.Enable(FAKEGL_DEPTH_TEST);
+                milliseconds[rasteriser] = TimeFrame(settings, [&]()
+                    { // draw frame
+                    fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | (hidden ? FAKEGL_DEPTH_BUFFER_BIT : 0));
+                    for (const std::vector<float> &vertices : rows)
+                        { // per row
+                        fakeGL.Begin(FAKEGL_TRIANGLES);
+                        for (size_t vertex = 0; vertex < vertices.size(); vertex += 3)
+                            fakeGL.Vertex3f(vertices[vertex], vertices[vertex + 1], vertices[vertex + 2]);
+                        fakeGL.End();
+                        } // per row
+                    fakeGL.Flush();
+                    }); // draw frame
+                } // per rasteriser
+
+            double pixels = (double) settings.width * settings.height * layers;
+            std::cout << std::left << std::setw(10) << (int) area
+                      << std::setw(9) << (hidden ? "hidden" : "visible")
+                      << std::right << std::setw(10) << nTriangles
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(12) << milliseconds[0]
+                      << std::setw(12) << milliseconds[1]
+                      << std::setw(10) << nTriangles / milliseconds[1] / 1000.0
+                      << std::setw(12) << pixels / milliseconds[1] / 1000.0
+                      << std::setw(9) << milliseconds[0] / milliseconds[1] << "x"
+                      << std::defaultfloat << std::endl;
+            } // visible / hidden
+        } // per area
+    } // FillBench()
+
+// thread scaling: a lit sphere, drawn with more & more threads
+static void ThreadsBench(const BenchSettings &settings)
+    { // ThreadsBench()
+    // enough triangles that the vertex stage counts as well as the pixels
+    const int slices = 256, stacks = 128;
+    float radius = 0.45f * std::min(settings.width, settings.height);
+    float centreX = 0.5f * settings.width, centreY = 0.5f * settings.height;
+
+    // positions & normals of a triangle list, so the depth test has the back to throw away
+    std::vector<float> positions, normals;
+    for (int stack = 0; stack < stacks; stack++)
+        for (int slice = 0; slice < slices; slice++)
+            { // per quad
+            int corners[6][2] = { {slice, stack}, {slice + 1, stack}, {slice + 1, stack + 1},
+                                  {slice, stack}, {slice + 1, stack + 1}, {slice, stack + 1} };
+            for (int vertex = 0; vertex < 6; vertex++)
+                { // per vertex
+                float theta = 2.0f * (float) M_PI * corners[vertex][0] / slices;
+                float phi = (float) M_PI * corners[vertex][1] / stacks;
+                float normal[3] = { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) };
+                normals.insert(normals.end(), normal, normal + 3);
+                positions.push_back(centreX + radius * normal[0]);
+                positions.push_back(centreY + radius * normal[1]);
+                positions.push_back(0.9f * normal[2]);
+                } // per vertex
+            } // per quad
+    long nTriangles = (long) positions.size() / 9;
+
+    // 1, 2, 4 ... and the number of cores, if that isn't a power of two
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < cores; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(cores);
+
+    std::cout << "threads: " << settings.width << "x" << settings.height << ", " << nTriangles << " triangles, Phong shaded, " << cores << " cores" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads"
+              << std::right << std::setw(12) << "ms"
+              << std::setw(10) << "Mtri/s"
+              << std::setw(10) << "speedup" << std::endl;
+
+    double single = 0.0;
+    for (unsigned int threads : threadCounts)
+        { // per thread count
+        FakeGL fakeGL;
+        SetUpContext(fakeGL, settings);
+        fakeGL.RenderThreads(threads);
+        fakeGL.Enable(FAKEGL_DEPTH_TEST);
+        fakeGL.Enable(FAKEGL_LIGHTING);
+        fakeGL.Enable(FAKEGL_PHONG_SHADING);
+        float lightPosition[4] = { 0.3f, 0.5f, 1.0f, 0.0f };
+        float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f }, diffuse[4] = { 0.6f, 0.6f, 0.6f, 1.0f }, specular[4] = { 0.3f, 0.3f, 0.3f, 1.0f };
+        fakeGL.Light(FAKEGL_POSITION, lightPosition);
+        fakeGL.Light(FAKEGL_AMBIENT, ambient);
+        fakeGL.Light(FAKEGL_DIFFUSE, diffuse);
+        fakeGL.Light(FAKEGL_SPECULAR, specular);
+
+        double milliseconds = TimeFrame(settings, [&]()
+            { // draw frame
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+            fakeGL.Begin(FAKEGL_TRIANGLES);
+            fakeGL.Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, diffuse);
+            fakeGL.Materialfv(FAKEGL_SPECULAR, specular);
+            fakeGL.Materialf(FAKEGL_SHININESS, 8.0f);
+            for (size_t vertex = 0; vertex < positions.size(); vertex += 3)
+                { // per vertex
+                fakeGL.Normal3f(normals[vertex], normals[vertex + 1], normals[vertex + 2]);
+                fakeGL.Vertex3f(positions[vertex], positions[vertex + 1], positions[vertex + 2]);
+                } // per vertex
+            fakeGL.End();
+            fakeGL.Flush();
+            }); // draw frame
+        if (threads == 1)
+            single = milliseconds;
+
+        std::cout << std::left << std::setw(10) << threads
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << milliseconds
+                  << std::setw(10) << nTriangles / milliseconds / 1000.0
+                  << std::setw(9) << single / milliseconds << "x"
+                  << std::defaultfloat << std::endl;
+        } // per thread count
+    } // ThreadsBench()
+
+// display lists: the same small triangles drawn immediately & from a list
+static void ListsBench(const BenchSettings &settings)
+    { // ListsBench()
+    // triangles of a few pixels each, so the calls per vertex cost as much as the pixels
+    const float side = 4.0f;
+    std::vector<float> positions, colours;
+    for (float y = 0.25f; y + side < settings.height; y += side)
+        for (float x = 0.25f; x + side < settings.width; x += side)
+            { // per square
+            float square[6][2] = { {x, y}, {x + side, y}, {x + side, y + side},
+                                   {x, y}, {x + side, y + side}, {x, y + side} };
+            for (int vertex = 0; vertex < 6; vertex++)
+                { // per vertex
+                positions.push_back(square[vertex][0]);
+                positions.push_back(square[vertex][1]);
+                positions.push_back(0.0f);
+                colours.push_back(x / settings.width);
+                colours.push_back(y / settings.height);
+                colours.push_back(0.5f);
+                } // per vertex
+            } // per square
+    long nTriangles = (long) positions.size() / 9;
+
+    std::cout << "lists: " << settings.width << "x" << settings.height << ", " << nTriangles << " triangles" << std::endl;
+    std::cout << std::left << std::setw(10) << "shading"
+              << std::right << std::setw(14) << "immediate ms"
+              << std::setw(12) << "record ms"
+              << std::setw(12) << "replay ms"
+              << std::setw(10) << "speedup" << std::endl;
+
+    for (int lit = 0; lit < 2; lit++)
+        { // unlit / lit
+        FakeGL fakeGL;
+        SetUpContext(fakeGL, settings);
+        if (lit)
+            { // lighting
+            fakeGL.Enable(FAKEGL_LIGHTING);
+            float lightPosition[4] = { 0.3f, 0.5f, 1.0f, 0.0f };
+            fakeGL.Light(FAKEGL_POSITION, lightPosition);
+            } // lighting
+
+        // a colour & a normal for every vertex, as a model read from a file would have
+        auto drawTriangles = [&]()
+            { // draw triangles
+            fakeGL.Begin(FAKEGL_TRIANGLES);
+            for (size_t vertex = 0; vertex < positions.size(); vertex += 3)
+                { // per vertex
+                fakeGL.Color3f(colours[vertex], colours[vertex + 1], colours[vertex + 2]);
+                fakeGL.Normal3f(0.0f, 0.0f, 1.0f);
+                fakeGL.Vertex3f(positions[vertex], positions[vertex + 1], positions[vertex + 2]);
+                } // per vertex
+            fakeGL.End();
+            }; // draw triangles
+
+        double immediate = TimeFrame(settings, [&]()
+            { // draw frame
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT);
+            drawTriangles();
+            fakeGL.Flush();
+            }); // draw frame
+
+        unsigned int list = fakeGL.GenLists(1);
+        double record = TimeFrame(settings, [&]()
+            { // record list
+            fakeGL.NewList(list, FAKEGL_COMPILE);
+            drawTriangles();
+            fakeGL.EndList();
+            }); // record list
+
+        double replay = TimeFrame(settings, [&]()
+            { // draw frame
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT);
+            fakeGL.CallList(list);
+            fakeGL.Flush();
+            }); // draw frame
+
+        std::cout << std::left << std::setw(10) << (lit ? "Gouraud" : "unlit")
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(14) << immediate
+                  << std::setw(12) << record
+                  << std::setw(12) << replay
+                  << std::setw(9) << immediate / replay << "x"
+                  << std::defaultfloat << std::endl;
+        } // unlit / lit
+    } // ListsBench()
+
+// culling & level of detail: a field of spheres seen from just above it, most of them off the screen
+static void ObjectsBench(const BenchSettings &settings)
+    { // ObjectsBench()
+    // three versions of the sphere, each with about a quarter of the triangles of the one before
+    static const int tessellations[] = { 64, 32, 16 };
+    const unsigned int nLevels = 3;
+    std::vector<float> positions[nLevels], normals[nLevels];
+    std::vector<unsigned int> indices[nLevels];
+    size_t triangleCounts[nLevels];
+    for (unsigned int level = 0; level < nLevels; level++)
+        { // per level
+        int slices = tessellations[level], stacks = tessellations[level] / 2;
+        for (int stack = 0; stack <= stacks; stack++)
+            for (int slice = 0; slice <= slices; slice++)
+                { // per vertex
+                float theta = 2.0f * (float) M_PI * slice / slices;
+                float phi = (float) M_PI * stack / stacks;
+                float normal[3] = { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) };
+                normals[level].insert(normals[level].end(), normal, normal + 3);
+                positions[level].insert(positions[level].end(), normal, normal + 3);
+                } // per vertex
+        for (int stack = 0; stack < stacks; stack++)
+            for (int slice = 0; slice < slices; slice++)
+                { // per quad
+                unsigned int corner = stack * (slices + 1) + slice;
+                unsigned int quad[6] = { corner, corner + 1, corner + slices + 2, corner, corner + slices + 2, corner + slices + 1 };
+                indices[level].insert(indices[level].end(), quad, quad + 6);
+                } // per quad
+        triangleCounts[level] = indices[level].size() / 3;
+        } // per level
+
+    // a square grid of unit spheres on the ground, the camera at one edge looking across it
+    const int across = 48;
+    const float spacing = 4.0f;
+    const float eyeHeight = 3.0f;
+
+    std::cout << "objects: " << settings.width << "x" << settings.height << ", " << across * across << " spheres of "
+              << triangleCounts[0] << "/" << triangleCounts[1] << "/" << triangleCounts[2] << " triangles, Gouraud shaded" << std::endl;
+    std::cout << std::left << std::setw(12) << "objects"
+              << std::right << std::setw(12) << "ms"
+              << std::setw(10) << "drawn"
+              << std::setw(12) << "triangles"
+              << std::setw(10) << "speedup" << std::endl;
+
+    static const char *caseNames[] = { "all", "culled", "culled+LOD" };
+    double all = 0.0;
+    for (int culling = 0; culling < 3; culling++)
+        { // per case
+        FakeGL fakeGL;
+        SetUpContext(fakeGL, settings);
+        fakeGL.Enable(FAKEGL_DEPTH_TEST);
+        fakeGL.Enable(FAKEGL_LIGHTING);
+        float lightPosition[4] = { 0.3f, 1.0f, 0.5f, 0.0f };
+        fakeGL.Light(FAKEGL_POSITION, lightPosition);
+
+        // a 30 degree field of view across the width, so most of the grid is to the sides
+        float aspect = (float) settings.width / settings.height;
+        float halfWidth = 0.1f * tanf((float) M_PI / 12.0f);
+        fakeGL.MatrixMode(FAKEGL_PROJECTION);
+        fakeGL.LoadIdentity();
+        fakeGL.Frustum(-halfWidth, halfWidth, -halfWidth / aspect, halfWidth / aspect, 0.1f, 1000.0f);
+        fakeGL.MatrixMode(FAKEGL_MODELVIEW);
+        fakeGL.EnableClientState(FAKEGL_VERTEX_ARRAY);
+        fakeGL.EnableClientState(FAKEGL_NORMAL_ARRAY);
+
+        long drawn = 0, triangles = 0;
+        double milliseconds = TimeFrame(settings, [&]()
+            { // draw frame
+            drawn = triangles = 0;
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+            for (int row = 0; row < across; row++)
+                for (int column = 0; column < across; column++)
+                    { // per sphere
+                    fakeGL.LoadIdentity();
+                    fakeGL.Translatef(spacing * (column - across / 2), -eyeHeight, -spacing * (row + 1));
+                    if (culling > 0 && fakeGL.CullSphere(0.0f, 0.0f, 0.0f, 1.0f))
+                        continue;
+                    unsigned int level = 0;
+                    if (culling > 1)
+                        level = fakeGL.LevelOfDetail(0.0f, 0.0f, 0.0f, 1.0f, triangleCounts, nLevels);
+                    fakeGL.VertexPointer(3, 0, &positions[level][0]);
+                    fakeGL.NormalPointer(0, &normals[level][0]);
+                    fakeGL.DrawElements(FAKEGL_TRIANGLES, indices[level].size(), &indices[level][0]);
+                    drawn++;
+                    triangles += (long) triangleCounts[level];
+                    } // per sphere
+            fakeGL.Flush();
+            }); // draw frame
+        if (culling == 0)
+            all = milliseconds;
+
+        std::cout << std::left << std::setw(12) << caseNames[culling]
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << milliseconds
+                  << std::setw(10) << drawn
+                  << std::setw(12) << triangles
+                  << std::setw(9) << all / milliseconds << "x"
+                  << std::defaultfloat << std::endl;
+        } // per case
+    } // ObjectsBench()
+
+// independent contexts: several views of one mesh, in turn & then each on its own thread
+static void ViewportsBench(const BenchSettings &settings)
+    { // ViewportsBench()
+    // one indexed sphere & one texture, which every context refers to rather than copying
+    const int slices = 128, stacks = 64;
+    std::vector<float> positions, normals, texCoords;
+    std::vector<unsigned int> indices;
+    for (int stack = 0; stack <= stacks; stack++)
+        for (int slice = 0; slice <= slices; slice++)
+            { // per vertex
+            float theta = 2.0f * (float) M_PI * slice / slices;
+            float phi = (float) M_PI * stack / stacks;
+            float normal[3] = { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) };
+            normals.insert(normals.end(), normal, normal + 3);
+            positions.insert(positions.end(), normal, normal + 3);
+            texCoords.push_back((float) slice / slices);
+            texCoords.push_back((float) stack / stacks);
+            } // per vertex
+    for (int stack = 0; stack < stacks; stack++)
+        for (int slice = 0; slice < slices; slice++)
+            { // per quad
+            unsigned int corner = stack * (slices + 1) + slice;
+            unsigned int quad[6] = { corner, corner + 1, corner + slices + 2, corner, corner + slices + 2, corner + slices + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+            } // per quad
+    RGBAImage texture;
+    texture.Resize(256, 256);
+    for (long row = 0; row < texture.height; row++)
+        for (long col = 0; col < texture.width; col++)
+            texture[row][col] = ((row / 32 + col / 32) % 2) ? RGBAValue(240, 200, 80) : RGBAValue(60, 90, 200);
+
+    // each view is a quarter of the frame buffer, as in a quad view
+    int viewWidth = std::max(1, settings.width / 2), viewHeight = std::max(1, settings.height / 2);
+    float aspect = (float) viewWidth / viewHeight;
+
+    // 1, 2, 4 ... and the number of cores, if that isn't a power of two
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> viewCounts;
+    for (unsigned int views = 1; views < cores; views *= 2)
+        viewCounts.push_back(views);
+    viewCounts.push_back(cores);
+
+    std::cout << "viewports: " << viewWidth << "x" << viewHeight << " each, " << indices.size() / 3
+              << " triangles, textured & Phong shaded, " << cores << " cores" << std::endl;
+    std::cout << std::left << std::setw(10) << "views"
+              << std::right << std::setw(12) << "in turn ms"
+              << std::setw(13) << "parallel ms"
+              << std::setw(10) << "views/s"
+              << std::setw(10) << "speedup"
+              << std::setw(10) << "images" << std::endl;
+
+    for (unsigned int nViews : viewCounts)
+        { // per view count
+        // FakeGL can't be copied or moved, so the contexts are made all together
+        std::unique_ptr<FakeGL[]> contexts(new FakeGL[nViews]);
+        for (unsigned int view = 0; view < nViews; view++)
+            { // per context
+            FakeGL &fakeGL = contexts[view];
+            fakeGL.Viewport(0, 0, viewWidth, viewHeight);
+            fakeGL.frameBuffer.Resize(viewWidth, viewHeight);
+            fakeGL.depthBuffer.Resize(viewWidth, viewHeight);
+            fakeGL.MatrixMode(FAKEGL_PROJECTION);
+            fakeGL.LoadIdentity();
+            fakeGL.Ortho(-1.1 * aspect, 1.1 * aspect, -1.1, 1.1, -1.1, 1.1);
+            fakeGL.MatrixMode(FAKEGL_MODELVIEW);
+            fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
+            fakeGL.Enable(FAKEGL_DEPTH_TEST);
+            fakeGL.Enable(FAKEGL_LIGHTING);
+            fakeGL.Enable(FAKEGL_PHONG_SHADING);
+            float lightPosition[4] = { 0.3f, 0.5f, 1.0f, 0.0f };
+            fakeGL.Light(FAKEGL_POSITION, lightPosition);
+            fakeGL.Enable(FAKEGL_TEXTURE_2D);
+            fakeGL.TexEnvMode(FAKEGL_MODULATE);
+            fakeGL.TexImage2D(texture);
+            fakeGL.VertexPointer(3, 0, &positions[0]);
+            fakeGL.NormalPointer(0, &normals[0]);
+            fakeGL.TexCoordPointer(2, 0, &texCoords[0]);
+            fakeGL.EnableClientState(FAKEGL_VERTEX_ARRAY);
+            fakeGL.EnableClientState(FAKEGL_NORMAL_ARRAY);
+            fakeGL.EnableClientState(FAKEGL_TEXTURE_COORD_ARRAY);
+            } // per context
+
+        // every view looks at the sphere from its own direction
+        auto drawView = [&](unsigned int view)
+            { // draw view
+            FakeGL &fakeGL = contexts[view];
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+            fakeGL.LoadIdentity();
+            fakeGL.Rotatef(20.0f, 1.0f, 0.0f, 0.0f);
+            fakeGL.Rotatef(360.0f * view / nViews, 0.0f, 1.0f, 0.0f);
+            fakeGL.DrawElements(FAKEGL_TRIANGLES, indices.size(), &indices[0]);
+            fakeGL.Flush();
+            }; // draw view
+
+        double inTurn = TimeFrame(settings, [&]()
+            { // draw frame
+            for (unsigned int view = 0; view < nViews; view++)
+                drawView(view);
+            }); // draw frame
+        size_t nPixels = (size_t) viewWidth * viewHeight;
+        std::vector<std::vector<RGBAValue> > images(nViews);
+        for (unsigned int view = 0; view < nViews; view++)
+            images[view].assign(contexts[view].frameBuffer.block, contexts[view].frameBuffer.block + nPixels);
+
+        double parallel = TimeFrame(settings, [&]()
+            { // draw frame
+            // the calling thread draws the first view
+            std::vector<std::thread> threads;
+            for (unsigned int view = 1; view < nViews; view++)
+                threads.emplace_back(drawView, view);
+            drawView(0);
+            for (std::thread &thread : threads)
+                thread.join();
+            }); // draw frame
+
+        bool same = true;
+        for (unsigned int view = 0; view < nViews; view++)
+            same = same && memcmp(&images[view][0], contexts[view].frameBuffer.block, nPixels * sizeof(RGBAValue)) == 0;
+
+        std::cout << std::left << std::setw(10) << nViews
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << inTurn
+                  << std::setw(13) << parallel
+                  << std::setw(10) << nViews / parallel * 1000.0
+                  << std::setw(9) << inTurn / parallel << "x"
+                  << std::setw(10) << (same ? "same" : "DIFFERENT")
+                  << std::defaultfloat << std::endl;
+        } // per view count
+    } // ViewportsBench()
+
+// wireframe: the edges of a grid of triangles, as lines
+static void WireframeBench(const BenchSettings &settings)
+    { // WireframeBench()
+    // cells a little larger than the widest line, with the depth varying so the test has work to do
+    const float side = 12.0f;
+    std::vector<float> positions, colours;
+    for (float y = 0.5f; y + side < settings.height; y += side)
+        for (float x = 0.5f; x + side < settings.width; x += side)
+            { // per cell
+            // across the top, down the left & along the diagonal of each cell
+            float edges[6][2] = { {x, y}, {x + side, y}, {x, y}, {x, y + side}, {x, y}, {x + side, y + side} };
+            for (int vertex = 0; vertex < 6; vertex++)
+                { // per vertex
+                positions.push_back(edges[vertex][0]);
+                positions.push_back(edges[vertex][1]);
+                positions.push_back(0.5f * sinf(edges[vertex][0] * 0.01f) * cosf(edges[vertex][1] * 0.01f));
+                colours.push_back(edges[vertex][0] / settings.width);
+                colours.push_back(edges[vertex][1] / settings.height);
+                colours.push_back(0.5f);
+                } // per vertex
+            } // per cell
+    long nLines = (long) positions.size() / 6;
+
+    std::cout << "wireframe: " << settings.width << "x" << settings.height << ", " << nLines << " lines" << std::endl;
+    std::cout << std::left << std::setw(10) << "width"
+              << std::right << std::setw(12) << "ms"
+              << std::setw(12) << "Mlines/s" << std::endl;
+
+    static const unsigned int widths[] = { 1, 2, 4, 8 };
+    for (unsigned int width : widths)
+        { // per width
+        FakeGL fakeGL;
+        SetUpContext(fakeGL, settings);
+        fakeGL.Enable(FAKEGL_DEPTH_TEST);
+        fakeGL.LineWidth(width);
+
+        double milliseconds = TimeFrame(settings, [&]()
+            { // draw frame
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+            fakeGL.Begin(FAKEGL_LINES);
+            for (size_t vertex = 0; vertex < positions.size(); vertex += 3)
+                { // per vertex
+                fakeGL.Color3f(colours[vertex], colours[vertex + 1], colours[vertex + 2]);
+                fakeGL.Vertex3f(positions[vertex], positions[vertex + 1], positions[vertex + 2]);
+                } // per vertex
+            fakeGL.End();
+            fakeGL.Flush();
+            }); // draw frame
+
+        std::cout << std::left << std::setw(10) << width
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << milliseconds
+                  << std::setw(12) << nLines / milliseconds / 1000.0
+                  << std::defaultfloat << std::endl;
+        } // per width
+    } // WireframeBench()
+
+// a model read from a .obj file, as triangles ready for DrawArrays()
+class SceneModel
+    { // class SceneModel
+    public:
+    // three corners per triangle, centred on the origin & scaled to fit in the unit sphere
+    std::vector<float> positions, normals, texCoords;
+    // the triangles' edges, two ends each, for drawing as lines
+    std::vector<float> edges;
+
+    // reads the faces of a .obj file, as the renderer does: each corner is vertex/texture/normal
+    bool Read(const std::string &path)
+        { // Read()
+        std::ifstream inStream(path.c_str());
+        if (!inStream.good())
+            return false;
+
+        std::vector<float> vertices, vertexNormals, vertexTexCoords;
+        std::string line;
+        while (std::getline(inStream, line))
+            { // per line
+            std::istringstream lineStream(line);
+            std::string code, x, y, z;
+            lineStream >> code;
+            // some of the models have a "nan" or two, which >> won't read as a float but strtof() will
+            if (code == "v" && lineStream >> x >> y >> z)
+                vertices.insert(vertices.end(), { strtof(x.c_str(), NULL), strtof(y.c_str(), NULL), strtof(z.c_str(), NULL) });
+            else if (code == "vn" && lineStream >> x >> y >> z)
+                vertexNormals.insert(vertexNormals.end(), { strtof(x.c_str(), NULL), strtof(y.c_str(), NULL), strtof(z.c_str(), NULL) });
+            else if (code == "vt" && lineStream >> x >> y)
+                vertexTexCoords.insert(vertexTexCoords.end(), { strtof(x.c_str(), NULL), strtof(y.c_str(), NULL) });
+            else if (code == "f")
+                { // face
+                std::vector<unsigned int> corners;
+                unsigned int vertex, texCoord, normal;
+                char slash;
+                while (lineStream >> vertex >> slash >> texCoord >> slash >> normal)
+                    corners.insert(corners.end(), { vertex - 1, texCoord - 1, normal - 1 });
+                // a fan of triangles from the first corner
+                for (size_t corner = 6; corner < corners.size(); corner += 3)
+                    { // per triangle
+                    unsigned int triangle[3] = { 0, (unsigned int) corner - 3, (unsigned int) corner };
+                    for (unsigned int first : triangle)
+                        { // per corner
+                        if (3 * corners[first] + 2 >= vertices.size() || 2 * corners[first + 1] + 1 >= vertexTexCoords.size()
+                            || 3 * corners[first + 2] + 2 >= vertexNormals.size())
+                            return false;
+                        positions.insert(positions.end(), &vertices[3 * corners[first]], &vertices[3 * corners[first]] + 3);
+                        texCoords.insert(texCoords.end(), &vertexTexCoords[2 * corners[first + 1]], &vertexTexCoords[2 * corners[first + 1]] + 2);
+                        normals.insert(normals.end(), &vertexNormals[3 * corners[first + 2]], &vertexNormals[3 * corners[first + 2]] + 3);
+                        } // per corner
+                    } // per triangle
+                } // face
+            } // per line
+        if (positions.empty())
+            return false;
+
+        // centre on the middle of the bounding box & scale to fit
+        float lowest[3] = { INFINITY, INFINITY, INFINITY }, highest[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (size_t coordinate = 0; coordinate < positions.size(); coordinate++)
+            { // per coordinate
+            lowest[coordinate % 3] = std::min(lowest[coordinate % 3], positions[coordinate]);
+            highest[coordinate % 3] = std::max(highest[coordinate % 3], positions[coordinate]);
+            } // per coordinate
+        float centre[3], radius = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+            centre[axis] = 0.5f * (lowest[axis] + highest[axis]);
+        for (size_t corner = 0; corner < positions.size(); corner += 3)
+            radius = std::max(radius, sqrtf((positions[corner] - centre[0]) * (positions[corner] - centre[0])
+                                            + (positions[corner + 1] - centre[1]) * (positions[corner + 1] - centre[1])
+                                            + (positions[corner + 2] - centre[2]) * (positions[corner + 2] - centre[2])));
+        for (size_t coordinate = 0; coordinate < positions.size(); coordinate++)
+            positions[coordinate] = (positions[coordinate] - centre[coordinate % 3]) / std::max(radius, 1.0e-6f);
+
+        for (size_t triangle = 0; triangle < positions.size(); triangle += 9)
+            for (int side = 0; side < 3; side++)
+                { // per edge
+                const float *from = &positions[triangle + 3 * side], *to = &positions[triangle + 3 * ((side + 1) % 3)];
+                edges.insert(edges.end(), from, from + 3);
+                edges.insert(edges.end(), to, to + 3);
+                } // per edge
+        return true;
+        } // Read()
+    }; // class SceneModel
+
+// what a scene turns on
+const unsigned int SCENE_LIGHTING = 1;
+const unsigned int SCENE_PHONG = 2;
+const unsigned int SCENE_REPLACE = 4;
+const unsigned int SCENE_MODULATE = 8;
+const unsigned int SCENE_NO_DEPTH = 16;
+// coloured axes drawn as 4 pixel wide lines
+const unsigned int SCENE_AXES = 32;
+// the model's edges as lines, and its corners as points, instead of its triangles
+const unsigned int SCENE_WIREFRAME = 64;
+const unsigned int SCENE_POINTS = 128;
+
+// a model and the state it is drawn with
+class SceneDescription
+    { // class SceneDescription
+    public:
+    const char *name;
+    const char *model;
+    unsigned int flags;
+    }; // class SceneDescription
+
+static const SceneDescription scenes[] =
+    {
+    { "cube_axes",          "cube_flat",            SCENE_AXES                                      },
+    { "sphere_gouraud",     "sphere20x20",          SCENE_LIGHTING                                  },
+    { "torus_phong",        "torus_smooth",         SCENE_LIGHTING | SCENE_PHONG                    },
+    { "earth_replace",      "sphere20x20",          SCENE_REPLACE                                   },
+    { "cow_phong_textured", "cow2_smooth",          SCENE_LIGHTING | SCENE_PHONG | SCENE_MODULATE   },
+    { "tree_no_depth",      "cherrytree_smooth",    SCENE_LIGHTING | SCENE_NO_DEPTH | SCENE_AXES    },
+    { "biplane_phong_axes", "biplane_flat",         SCENE_LIGHTING | SCENE_PHONG | SCENE_AXES       },
+    { "747_wireframe",      "747_smooth",           SCENE_WIREFRAME                                 },
+    { "bitorus_points",     "bitorus_smooth",       SCENE_POINTS                                    },
+    };
+
+// conformance: the bundled models through each part of the pipeline, against golden images
+static void ScenesBench(const BenchSettings &benchSettings)
+    { // ScenesBench()
+    // the golden images are only good for the size they were recorded at
+    BenchSettings settings = benchSettings;
+    settings.width = goldenWidth;
+    settings.height = goldenHeight;
+
+    RGBAImage texture;
+    std::ifstream textureStream(settings.texturePath.c_str());
+    if (!textureStream.good() || !texture.ReadPPM(textureStream))
+        { // no texture
+        std::cout << "scenes: cannot read texture " << settings.texturePath << std::endl;
+        failedScenes++;
+        return;
+        } // no texture
+
+    std::cout << "scenes: " << settings.width << "x" << settings.height;
+    if (!settings.goldenDirectory.empty())
+        std::cout << ", against " << settings.goldenDirectory << " to within " << settings.tolerance;
+    std::cout << std::endl;
+    std::cout << std::left << std::setw(20) << "scene"
+              << std::right << std::setw(10) << "ms"
+              << std::setw(10) << "ktri/s"
+              << std::setw(10) << "Mfrag/s"
+              << std::setw(12) << "golden" << std::endl;
+
+    for (const SceneDescription &scene : scenes)
+        { // per scene
+        SceneModel model;
+        if (!model.Read(settings.modelDirectory + "/" + scene.model + ".obj"))
+            { // no model
+            std::cout << std::left << std::setw(20) << scene.name << " cannot read " << settings.modelDirectory << "/" << scene.model << ".obj" << std::endl;
+            failedScenes++;
+            continue;
+            } // no model
+        size_t nTriangles = model.positions.size() / 9;
+
+        FakeGL fakeGL;
+        SetUpContext(fakeGL, settings);
+        float aspect = (float) settings.width / settings.height;
+        fakeGL.MatrixMode(FAKEGL_PROJECTION);
+        fakeGL.LoadIdentity();
+        fakeGL.Ortho(-1.1 * aspect, 1.1 * aspect, -1.1, 1.1, -1.1, 1.1);
+        fakeGL.MatrixMode(FAKEGL_MODELVIEW);
+
+        if (scene.flags & SCENE_NO_DEPTH)
+            fakeGL.Disable(FAKEGL_DEPTH_TEST);
+        else
+            fakeGL.Enable(FAKEGL_DEPTH_TEST);
+        float lightPosition[4] = { 0.3f, 0.5f, 1.0f, 0.0f };
+        float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f }, diffuse[4] = { 0.6f, 0.6f, 0.6f, 1.0f }, specular[4] = { 0.3f, 0.3f, 0.3f, 1.0f };
+        fakeGL.Light(FAKEGL_POSITION, lightPosition);
+        fakeGL.Light(FAKEGL_AMBIENT, ambient);
+        fakeGL.Light(FAKEGL_DIFFUSE, diffuse);
+        fakeGL.Light(FAKEGL_SPECULAR, specular);
+        if (scene.flags & SCENE_PHONG)
+            fakeGL.Enable(FAKEGL_PHONG_SHADING);
+        fakeGL.TexImage2D(texture);
+        fakeGL.TexEnvMode((scene.flags & SCENE_REPLACE) ? FAKEGL_REPLACE : FAKEGL_MODULATE);
+        fakeGL.PointSize(3.0f);
+
+        auto drawFrame = [&]()
+            { // draw frame
+            fakeGL.Clear(FAKEGL_COLOR_BUFFER_BIT | FAKEGL_DEPTH_BUFFER_BIT);
+            fakeGL.LoadIdentity();
+            fakeGL.Rotatef(30.0f, 1.0f, 1.0f, 0.0f);
+
+            if (scene.flags & SCENE_AXES)
+                { // axes
+                fakeGL.LineWidth(4.0f);
+                fakeGL.Begin(FAKEGL_LINES);
+                fakeGL.Color3f(1.0f, 0.0f, 0.0f); fakeGL.Vertex3f(0.0f, 0.0f, 0.0f); fakeGL.Vertex3f(1.0f, 0.0f, 0.0f);
+                fakeGL.Color3f(0.0f, 1.0f, 0.0f); fakeGL.Vertex3f(0.0f, 0.0f, 0.0f); fakeGL.Vertex3f(0.0f, 1.0f, 0.0f);
+                fakeGL.Color3f(0.0f, 0.0f, 1.0f); fakeGL.Vertex3f(0.0f, 0.0f, 0.0f); fakeGL.Vertex3f(0.0f, 0.0f, 1.0f);
+                fakeGL.End();
+                fakeGL.LineWidth(1.0f);
+                } // axes
+
+            if (scene.flags & SCENE_LIGHTING)
+                fakeGL.Enable(FAKEGL_LIGHTING);
+            if (scene.flags & (SCENE_REPLACE | SCENE_MODULATE))
+                fakeGL.Enable(FAKEGL_TEXTURE_2D);
+            fakeGL.Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, diffuse);
+            fakeGL.Materialfv(FAKEGL_SPECULAR, specular);
+            fakeGL.Materialf(FAKEGL_SHININESS, 8.0f);
+            fakeGL.Color3f(0.7f, 0.5f, 0.3f);
+
+            fakeGL.EnableClientState(FAKEGL_VERTEX_ARRAY);
+            if (scene.flags & SCENE_WIREFRAME)
+                { // edges
+                fakeGL.VertexPointer(3, 0, &model.edges[0]);
+                fakeGL.DrawArrays(FAKEGL_LINES, 0, model.edges.size() / 3);
+                } // edges
+            else if (scene.flags & SCENE_POINTS)
+                { // corners
+                fakeGL.VertexPointer(3, 0, &model.positions[0]);
+                fakeGL.DrawArrays(FAKEGL_POINTS, 0, model.positions.size() / 3);
+                } // corners
+            else
+                { // triangles
+                fakeGL.VertexPointer(3, 0, &model.positions[0]);
+                fakeGL.NormalPointer(0, &model.normals[0]);
+                fakeGL.TexCoordPointer(2, 0, &model.texCoords[0]);
+                fakeGL.EnableClientState(FAKEGL_NORMAL_ARRAY);
+                fakeGL.EnableClientState(FAKEGL_TEXTURE_COORD_ARRAY);
+                fakeGL.DrawArrays(FAKEGL_TRIANGLES, 0, model.positions.size() / 3);
+                fakeGL.DisableClientState(FAKEGL_NORMAL_ARRAY);
+                fakeGL.DisableClientState(FAKEGL_TEXTURE_COORD_ARRAY);
+                } // triangles
+            fakeGL.DisableClientState(FAKEGL_VERTEX_ARRAY);
+
+            fakeGL.Disable(FAKEGL_LIGHTING);
+            fakeGL.Disable(FAKEGL_TEXTURE_2D);
+            fakeGL.Flush();
+            }; // draw frame
+
+        // the fragments are counted on a frame of their own, as counting takes time
+        fakeGL.countFragments = true;
+        fakeGL.fragmentCount = 0;
+        drawFrame();
+        fakeGL.countFragments = false;
+        unsigned long long nFragments = fakeGL.fragmentCount;
+        double milliseconds = TimeFrame(settings, drawFrame);
+
+        // every frame draws the same, so the last one is as good as any
+        std::string golden = "-";
+        if (!settings.recordDirectory.empty())
+            { // record
+            std::ofstream goldenStream((settings.recordDirectory + "/" + scene.name + ".ppm").c_str());
+            fakeGL.frameBuffer.WritePPM(goldenStream);
+            golden = goldenStream.good() ? "recorded" : "NOT WRITTEN";
+            } // record
+        if (!settings.goldenDirectory.empty())
+            { // compare
+            RGBAImage expected;
+            std::ifstream goldenStream((settings.goldenDirectory + "/" + scene.name + ".ppm").c_str());
+            if (!goldenStream.good() || !expected.ReadPPM(goldenStream))
+                golden = "MISSING";
+            else if (expected.width != fakeGL.frameBuffer.width || expected.height != fakeGL.frameBuffer.height)
+                golden = "WRONG SIZE";
+            else
+                { // per pixel
+                // the golden images have no alpha, so only colour is compared
+                long wrong = 0;
+                for (long pixel = 0; pixel < expected.width * expected.height; pixel++)
+                    { // per pixel
+                    const RGBAValue &want = expected.block[pixel], &got = fakeGL.frameBuffer.block[pixel];
+                    if (abs(want.red - got.red) > settings.tolerance || abs(want.green - got.green) > settings.tolerance
+                        || abs(want.blue - got.blue) > settings.tolerance)
+                        wrong++;
+                    } // per pixel
+                golden = wrong == 0 ? "match" : std::to_string(wrong) + " WRONG";
+                } // per pixel
+            if (golden != "match")
+                failedScenes++;
+            } // compare
+
+        std::cout << std::left << std::setw(20) << scene.name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << milliseconds
+                  << std::setw(10) << nTriangles / milliseconds
+                  << std::setw(10) << nFragments / milliseconds / 1000.0
+                  << std::setw(12) << golden
+                  << std::defaultfloat << std::endl;
+        } // per scene
+    } // ScenesBench()
+
+// the Maths as it was before it became inline: the same sums, but each operation a call
+// that the compiler can't see into, and the products looping from zero a coordinate at a time
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+static BENCH_NOINLINE float OutOfLineDot(const Cartesian3 &left, const Cartesian3 &right)
+    { // OutOfLineDot()
+    return left.x * right.x + left.y * right.y + left.z * right.z;
+    } // OutOfLineDot()
+
+static BENCH_NOINLINE Cartesian3 OutOfLineCross(const Cartesian3 &left, const Cartesian3 &right)
+    { // OutOfLineCross()
+    return Cartesian3(left.y * right.z - left.z * right.y, left.z * right.x - left.x * right.z, left.x * right.y - left.y * right.x);
+    } // OutOfLineCross()
+
+static BENCH_NOINLINE Homogeneous4 OutOfLineMatrixVector(const Matrix4 &matrix, const Homogeneous4 &vector)
+    { // OutOfLineMatrixVector()
+    Homogeneous4 productVector;
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            productVector[row] += matrix.coordinates[row][col] * vector[col];
+    return productVector;
+    } // OutOfLineMatrixVector()
+
+static BENCH_NOINLINE Matrix4 OutOfLineMatrixMatrix(const Matrix4 &left, const Matrix4 &right)
+    { // OutOfLineMatrixMatrix()
+    Matrix4 productMatrix;
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            for (int entry = 0; entry < 4; entry++)
+                productMatrix.coordinates[row][col] += left.coordinates[row][entry] * right.coordinates[entry][col];
+    return productMatrix;
+    } // OutOfLineMatrixMatrix()
+
+// maths: each operation over arrays of operands, out of line & inline
+static void MathsBench(const BenchSettings &settings)
+    { // MathsBench()
+    // enough operands to take a while, few enough to stay in the cache
+    const size_t nOperands = 4096;
+    const int passes = 64;
+
+    // the same pseudo-random operands every run, with a model view matrix's range of values
+    unsigned int seed = 5812;
+    auto random = [&seed]()
+        { // random()
+        seed = seed * 1664525u + 1013904223u;
+        return (float) (seed >> 8) / (float) (1u << 24) * 4.0f - 2.0f;
+        }; // random()
+    std::vector<Cartesian3> points(nOperands), others(nOperands);
+    std::vector<Homogeneous4> vectors(nOperands);
+    std::vector<Matrix4> matrices(nOperands), otherMatrices(nOperands);
+    for (size_t operand = 0; operand < nOperands; operand++)
+        { // per operand
+        points[operand] = Cartesian3(random(), random(), random());
+        others[operand] = Cartesian3(random(), random(), random());
+        vectors[operand] = Homogeneous4(random(), random(), random(), random());
+        for (int row = 0; row < 4; row++)
+            for (int col = 0; col < 4; col++)
+                { // per entry
+                matrices[operand].coordinates[row][col] = random();
+                otherMatrices[operand].coordinates[row][col] = random();
+                } // per entry
+        } // per operand
+
+    std::cout << "maths: " << nOperands << " operands, " << passes << " passes" << std::endl;
+    std::cout << std::left << std::setw(16) << "operation"
+              << std::right << std::setw(16) << "out of line ns"
+              << std::setw(12) << "inline ns"
+              << std::setw(10) << "speedup"
+              << std::setw(12) << "answers" << std::endl;
+
+    // prints one operation's line
+    auto report = [&](const char *name, double outOfLineMilliseconds, double inlineMilliseconds, bool same)
+        { // report()
+        if (!same)
+            failedMaths++;
+        double operations = (double) nOperands * passes;
+        std::cout << std::left << std::setw(16) << name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << outOfLineMilliseconds * 1.0e6 / operations
+                  << std::setw(12) << inlineMilliseconds * 1.0e6 / operations
+                  << std::setw(9) << outOfLineMilliseconds / inlineMilliseconds << "x"
+                  << std::setw(12) << (same ? "same" : "DIFFERENT")
+                  << std::defaultfloat << std::endl;
+        }; // report()
+
+    // times one operation both ways, writing the answers to arrays so neither can be skipped
+    auto timeOperation = [&](const char *name, auto outOfLine, auto inlined)
+        { // timeOperation()
+        typedef decltype(outOfLine(0)) Answer;
+        std::vector<Answer> outOfLineAnswers(nOperands), inlineAnswers(nOperands);
+        double outOfLineMilliseconds = TimeFrame(settings, [&]()
+            { // out of line
+            for (int pass = 0; pass < passes; pass++)
+                for (size_t operand = 0; operand < nOperands; operand++)
+                    outOfLineAnswers[operand] = outOfLine(operand);
+            }); // out of line
+        double inlineMilliseconds = TimeFrame(settings, [&]()
+            { // inline
+            for (int pass = 0; pass < passes; pass++)
+                for (size_t operand = 0; operand < nOperands; operand++)
+                    inlineAnswers[operand] = inlined(operand);
+            }); // inline
+
+        // the inline versions add up in the same order, so the answers should be the same to the bit
+        report(name, outOfLineMilliseconds, inlineMilliseconds,
+            memcmp(outOfLineAnswers.data(), inlineAnswers.data(), nOperands * sizeof(Answer)) == 0);
+        }; // timeOperation()
+
+    timeOperation("dot",
+        [&](size_t operand) { return OutOfLineDot(points[operand], others[operand]); },
+        [&](size_t operand) { return points[operand].dot(others[operand]); });
+    timeOperation("cross",
+        [&](size_t operand) { return OutOfLineCross(points[operand], others[operand]); },
+        [&](size_t operand) { return points[operand].cross(others[operand]); });
+    timeOperation("matrix-vector",
+        [&](size_t operand) { return OutOfLineMatrixVector(matrices[operand], vectors[operand]); },
+        [&](size_t operand) { return matrices[operand] * vectors[operand]; });
+    timeOperation("matrix-point",
+        [&](size_t operand) { return OutOfLineMatrixVector(matrices[operand], Homogeneous4(points[operand])).Point(); },
+        [&](size_t operand) { return matrices[operand] * points[operand]; });
+    timeOperation("matrix-matrix",
+        [&](size_t operand) { return OutOfLineMatrixMatrix(matrices[operand], otherMatrices[operand]); },
+        [&](size_t operand) { return matrices[operand] * otherMatrices[operand]; });
+
+    // the batched transforms, with one model view matrix for the whole array, against a product
+    // at a time through the same inline operators - the answers should still be the same
+    Matrix4 modelView, translation;
+    modelView.SetRotation(Cartesian3(1.0f, 2.0f, 3.0f), 0.7f);
+    translation.SetTranslation(Cartesian3(0.5f, -1.0f, -5.0f));
+    modelView = translation * modelView;
+    auto timeBatch = [&](const char *name, auto oneAtATime, auto batched)
+        { // timeBatch()
+        typedef decltype(oneAtATime(0)) Answer;
+        std::vector<Answer> oneAtATimeAnswers(nOperands), batchedAnswers(nOperands);
+        double oneAtATimeMilliseconds = TimeFrame(settings, [&]()
+            { // one at a time
+            for (int pass = 0; pass < passes; pass++)
+                for (size_t operand = 0; operand < nOperands; operand++)
+                    oneAtATimeAnswers[operand] = oneAtATime(operand);
+            }); // one at a time
+        double batchedMilliseconds = TimeFrame(settings, [&]()
+            { // batched
+            for (int pass = 0; pass < passes; pass++)
+                batched(batchedAnswers.data());
+            }); // batched
+        report(name, oneAtATimeMilliseconds, batchedMilliseconds,
+            memcmp(oneAtATimeAnswers.data(), batchedAnswers.data(), nOperands * sizeof(Answer)) == 0);
+        }; // timeBatch()
+
+    std::cout << std::left << std::setw(16) << "batched"
+              << std::right << std::setw(16) << "one at a time"
+              << std::setw(12) << "batched" << std::endl;
+    timeBatch("vectors",
+        [&](size_t operand) { return modelView * vectors[operand]; },
+        [&](Homogeneous4 *answers) { modelView.TransformPoints(vectors.data(), answers, nOperands); });
+    timeBatch("points",
+        [&](size_t operand) { return modelView * points[operand]; },
+        [&](Cartesian3 *answers) { modelView.TransformPoints(points.data(), answers, nOperands); });
+
+    // normals should stay at right angles to the surface through a scale that differs along the axes,
+    // checked here against a tangent of each - which are not the same sums, so only roughly
+    Matrix4 scale;
+    scale.SetScale(1.0f, 3.0f, 0.25f);
+    Matrix4 squash = modelView * scale;
+    std::vector<Cartesian3> normals(nOperands), tangents(nOperands);
+    for (size_t operand = 0; operand < nOperands; operand++)
+        tangents[operand] = points[operand].cross(others[operand]);
+    squash.TransformNormals(points.data(), normals.data(), nOperands);
+    squash.TransformDirections(tangents.data(), tangents.data(), nOperands);
+    float worstCosine = 0.0f;
+    for (size_t operand = 0; operand < nOperands; operand++)
+        worstCosine = std::max(worstCosine, fabsf(normals[operand].unit().dot(tangents[operand].unit())));
+    bool perpendicular = worstCosine < 1.0e-4f;
+    if (!perpendicular)
+        failedMaths++;
+    std::cout << std::left << std::setw(16) << "normals"
+              << std::right << std::setw(40) << (perpendicular ? "perpendicular" : "NOT PERPENDICULAR") << std::endl;
+    } // MathsBench()
+
+// a benchmark that can be selected by name
+class Benchmark
+    { // class Benchmark
+    public:
+    const char *name;
+    void (*run)(const BenchSettings &settings);
+    }; // class Benchmark
+
+static const Benchmark benchmarks[] =
+    {
+    { "fill",       FillBench       },
+    { "threads",    ThreadsBench    },
+    { "lists",      ListsBench      },
+    { "objects",    ObjectsBench    },
+    { "viewports",  ViewportsBench  },
+    { "wireframe",  WireframeBench  },
+    { "scenes",     ScenesBench     },
+    { "maths",      MathsBench      },
+    };
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    BenchSettings settings;
+    std::string only;
+
+    for (int arg = 1; arg < argc; arg++)
+        { // per argument
+        std::string option = argv[arg];
+        if (arg + 1 >= argc)
+            { // missing value
+            std::cout << "Usage: " << argv[0] << " [--size WxH] [--repeats n] [--bench name] [--models dir] [--texture file]"
+                      << " [--record dir] [--golden dir] [--tolerance n]" << std::endl;
+            return 1;
+            } // missing value
+        std::string value = argv[++arg];
+        if (option == "--size")
+            { // size
+            size_t cross = value.find('x');
+            settings.width = std::max(1, atoi(value.substr(0, cross).c_str()));
+            settings.height = (cross == std::string::npos) ? settings.width : std::max(1, atoi(value.substr(cross + 1).c_str()));
+            } // size
+        else if (option == "--repeats")
+            settings.repeats = std::max(1, atoi(value.c_str()));
+        else if (option == "--bench")
+            only = value;
+        else if (option == "--models")
+            settings.modelDirectory = value;
+        else if (option == "--texture")
+            settings.texturePath = value;
+        else if (option == "--record")
+            settings.recordDirectory = value;
+        else if (option == "--golden")
+            settings.goldenDirectory = value;
+        else if (option == "--tolerance")
+            settings.tolerance = std::max(0, atoi(value.c_str()));
+        else
+            { // bad option
+            std::cout << "Unknown option " << option << std::endl;
+            return 1;
+            } // bad option
+        } // per argument
+
+    bool ranAny = false;
+    for (const Benchmark &benchmark : benchmarks)
+        { // per benchmark
+        if (!only.empty() && only != benchmark.name)
+            continue;
+        benchmark.run(settings);
+        std::cout << std::endl;
+        ranAny = true;
+        } // per benchmark
+
+    if (!ranAny)
+        { // no such benchmark
+        std::cout << "No benchmark called " << only << std::endl;
+        return 1;
+        } // no such benchmark
+
+    if (failedScenes > 0 || failedMaths > 0)
+        { // conformance failure
+        if (failedScenes > 0)
+            std::cout << failedScenes << " scene(s) failed" << std::endl;
+        if (failedMaths > 0)
+            std::cout << failedMaths << " maths operation(s) failed" << std::endl;
+        return 1;
+        } // conformance failure
+    return 0;
+    } // main()
@@ -31,6 +31,12 @@ class ArcBall
     Quaternion currentRotation;
     // originating point for a rotation
     Quaternion dragFrom;
+
+    // the current rotation followed by the base one, as one quaternion, and as a
+    // matrix in both forms: worked out when a drag changes them, not when asked for
+    Quaternion rotation;
+    Matrix4 rotationMatrix;
+    columnMajorMatrix rotationColumns;
     
     // constructor - initializes to a zero rotation
     ArcBall();
@@ -47,8 +53,11 @@ class ArcBall
     // stop dragging
     void EndDrag(float x, float y);
     
+    // works out the combined rotation again
+    void UpdateRotation();
+
     // extract the rotation matrix for rendering purposes
-    Matrix4 GetRotation();
+    const Matrix4 &GetRotation() const;
     }; // class ArcBall
 
 #endif
\ No newline at end of file
@@ -114,11 +114,11 @@ ArcBallWidget::ArcBallWidget(QWidget *parent)
     setFixedSize(QSize(ARCBALL_WIDGET_SIZE, ARCBALL_WIDGET_SIZE));
     } // ArcBallWidget()
     
-// routine to copy rotation matrix
-Matrix4 ArcBallWidget::RotationMatrix()
-    { // ArcBallWidget::RotationMatrix()
-    return theBall.GetRotation();
-    } // ArcBallWidget::RotationMatrix()
+// routine to return the rotation
+const Quaternion &ArcBallWidget::Rotation() const
+    { // ArcBallWidget::Rotation()
+    return theBall.rotation;
+    } // ArcBallWidget::Rotation()
         
 // called when OpenGL context is set up
 void ArcBallWidget::initializeGL()
@@ -172,8 +172,7 @@ void ArcBallWidget::paintGL()
     glEnd();
     
     // retrieve rotation from arcball & apply
-    Matrix4 rotMatrix = theBall.GetRotation();
-    glMultMatrixf(rotMatrix.columnMajor().coordinates);
+    glMultMatrixf(theBall.rotationColumns.coordinates);
 
     // loop through verticals of sphere
     for (int i = 0; i < 12; i++)
@@ -34,8 +34,8 @@ class ArcBallWidget : public QOpenGLWidget
     //  constructor
     ArcBallWidget(QWidget *parent);
 
-    // routine to return rotation matrix
-    Matrix4 RotationMatrix();
+    // routine to return the rotation
+    const Quaternion &Rotation() const;
 
     protected:
     // called when OpenGL context is set up
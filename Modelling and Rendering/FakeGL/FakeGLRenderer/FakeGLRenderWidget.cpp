@@ -36,6 +36,36 @@
 // include the header file
 #include "FakeGLRenderWidget.h"
 
+// returns true if two sets of parameters would produce the same image
+// the transforms are the same if they are the same version, without comparing matrices
+static bool SameParameters(const RenderParameters &a, const RenderParameters &b)
+    { // SameParameters()
+    for (int i = 0; i < 4; i++)
+        if (a.lightPosition[i] != b.lightPosition[i])
+            return false;
+
+    return  a.xTranslate            == b.xTranslate             &&
+            a.yTranslate            == b.yTranslate             &&
+            a.zoomScale             == b.zoomScale              &&
+            a.modelTransform.version == b.modelTransform.version &&
+            a.lightTransform.version == b.lightTransform.version &&
+            a.emissiveLight         == b.emissiveLight          &&
+            a.ambientLight          == b.ambientLight           &&
+            a.diffuseLight          == b.diffuseLight           &&
+            a.specularLight         == b.specularLight          &&
+            a.specularExponent      == b.specularExponent       &&
+            a.useLighting           == b.useLighting            &&
+            a.texturedRendering     == b.texturedRendering      &&
+            a.textureModulation     == b.textureModulation      &&
+            a.depthTestOn           == b.depthTestOn            &&
+            a.phongShadingOn        == b.phongShadingOn         &&
+            a.showAxes              == b.showAxes               &&
+            a.showObject            == b.showObject             &&
+            a.centreObject          == b.centreObject           &&
+            a.scaleObject           == b.scaleObject            &&
+            a.mapUVWToRGB           == b.mapUVWToRGB;
+    } // SameParameters()
+
 // constructor
 FakeGLRenderWidget::FakeGLRenderWidget
         (   
@@ -53,7 +83,8 @@ FakeGLRenderWidget::FakeGLRenderWidget
     QOpenGLWidget(parent),
     // then store the pointers that were passed in
     texturedObject(newTexturedObject),
-    renderParameters(newRenderParameters)
+    renderParameters(newRenderParameters),
+    framePainted(false)
     { // constructor
     // leaves nothing to put into the constructor body
     } // constructor    
@@ -76,6 +107,9 @@ void FakeGLRenderWidget::initializeGL()
     // background is yellowish-grey
     fakeGL.ClearColor(0.8, 0.8, 0.6, 1.0);
 
+    // render with one thread per core
+    fakeGL.RenderThreads(0);
+
     // now transfer assets (ie texture) to the library
     texturedObject->TransferAssetsToFakeGL(&fakeGL);
     } // FakeGLRenderWidget::initializeGL()
@@ -89,6 +123,8 @@ void FakeGLRenderWidget::resizeGL(int w, int h)
     // resize the render image
     fakeGL.frameBuffer.Resize(w, h);
     fakeGL.depthBuffer.Resize(w, h);
+    // which loses the frame that was there
+    framePainted = false;
 
     // set projection matrix to be fakeGL.Ortho based on zoom & window size
     fakeGL.MatrixMode(FAKEGL_PROJECTION);
@@ -115,8 +151,17 @@ void FakeGLRenderWidget::paintGL()
     glClearColor(1.0, 1.0, 1.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // call the paintFakeGL() routine to prepare the image
-    paintFakeGL();
+    // the frame buffer still holds the last frame, so it is only drawn again if that is out of date
+    if (!framePainted || !SameParameters(paintedParameters, *renderParameters))
+        { // draw the frame
+        // call the paintFakeGL() routine to prepare the image
+        paintFakeGL();
+        // and finish off anything FakeGL has left undone
+        fakeGL.Flush();
+
+        paintedParameters = *renderParameters;
+        framePainted = true;
+        } // draw the frame
     
     // and display the image
     glDrawPixels(fakeGL.frameBuffer.width, fakeGL.frameBuffer.height, GL_RGBA, GL_UNSIGNED_BYTE, fakeGL.frameBuffer.block);
@@ -151,7 +196,7 @@ void FakeGLRenderWidget::paintFakeGL()
         // set light position first, pushing/popping matrix so that it the transformation does
         // not affect the position of the geometric object
         fakeGL.PushMatrix();
-        fakeGL.MultMatrixf(renderParameters->lightMatrix.columnMajor().coordinates);
+        fakeGL.MultMatrixf(renderParameters->lightTransform.columnMajor.coordinates);
         fakeGL.Light(FAKEGL_POSITION, renderParameters->lightPosition);
         fakeGL.PopMatrix();
         
@@ -182,11 +227,16 @@ void FakeGLRenderWidget::paintFakeGL()
         	fakeGL.Disable(FAKEGL_PHONG_SHADING);       
         } // use lighting
 
-    // translate by the visual translation
-    fakeGL.Translatef(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f);
+    // per-pixel lighting is expensive enough that it is only worth doing for the visible surface:
+    // deferred shading lights each pixel once at the end, so the depth pre-pass is not needed too
+    if (renderParameters->useLighting && renderParameters->phongShadingOn)
+        fakeGL.Enable(FAKEGL_DEFERRED_SHADING);
+    else
+        fakeGL.Disable(FAKEGL_DEFERRED_SHADING);
+    fakeGL.Disable(FAKEGL_DEPTH_PREPASS);
 
-    // apply rotation matrix from arcball
-    fakeGL.MultMatrixf(renderParameters->rotationMatrix.columnMajor().coordinates);
+    // apply the rotation from the arcball & the visual translation, as one matrix
+    fakeGL.MultMatrixf(renderParameters->modelTransform.columnMajor.coordinates);
 
     // now we start using the render parameters
     if (renderParameters->showAxes)
@@ -64,6 +64,11 @@ class FakeGLRenderWidget : public QOpenGLWidget
 	// the fakeGL context to use when rendering
 	FakeGL fakeGL;
 
+	// the parameters the frame buffer was last drawn with, so that a repaint
+	// with nothing changed shows the same frame again without drawing it
+	RenderParameters paintedParameters;
+	bool framePainted;
+
 	public:
 	// constructor
 	FakeGLRenderWidget
@@ -135,16 +135,16 @@ RenderController::RenderController
     QObject::connect(   renderWindow->scaleObjectBox,               SIGNAL(stateChanged(int)),
                         this,                                       SLOT(scaleObjectCheckChanged(int)));
 
-    // copy the rotation matrix from the widgets to the model
-    renderParameters->rotationMatrix = renderWindow->modelRotator->RotationMatrix();
-    renderParameters->lightMatrix = renderWindow->lightRotator->RotationMatrix();
+    // copy the rotations from the widgets to the model
+    renderParameters->modelTransform.SetRotation(renderWindow->modelRotator->Rotation());
+    renderParameters->lightTransform.SetRotation(renderWindow->lightRotator->Rotation());
     } // RenderController::RenderController()
 
 // slot for responding to arcball rotation for object
 void RenderController::objectRotationChanged()
     { // RenderController::objectRotationChanged()
-    // copy the rotation matrix from the widget to the model
-    renderParameters->rotationMatrix = renderWindow->modelRotator->RotationMatrix();
+    // copy the rotation from the widget to the model
+    renderParameters->modelTransform.SetRotation(renderWindow->modelRotator->Rotation());
     
     // reset the interface
     renderWindow->ResetInterface();
@@ -153,8 +153,8 @@ void RenderController::objectRotationChanged()
 // slot for responding to arcball rotation for light
 void RenderController::lightRotationChanged()
     { // RenderController::lightRotationChanged()
-    // copy the rotation matrix from the widget to the model
-    renderParameters->lightMatrix = renderWindow->lightRotator->RotationMatrix();
+    // copy the rotation from the widget to the model
+    renderParameters->lightTransform.SetRotation(renderWindow->lightRotator->Rotation());
     
     // reset the interface
     renderWindow->ResetInterface();
@@ -190,7 +190,10 @@ void RenderController::xTranslateChanged(int value)
         renderParameters->xTranslate = TRANSLATE_MIN;
     else if (renderParameters->xTranslate > TRANSLATE_MAX)
         renderParameters->xTranslate = TRANSLATE_MAX;
-    
+
+    // and the model's transform with it
+    renderParameters->modelTransform.SetTranslation(Cartesian3(renderParameters->xTranslate, renderParameters->yTranslate, 0.0));
+
     // reset the interface
     renderWindow->ResetInterface();
     } // RenderController::xTranslateChanged()
@@ -206,7 +209,10 @@ void RenderController::yTranslateChanged(int value)
         renderParameters->yTranslate = TRANSLATE_MIN;
     else if (renderParameters->yTranslate > TRANSLATE_MAX)
         renderParameters->yTranslate = TRANSLATE_MAX;
-    
+
+    // and the model's transform with it
+    renderParameters->modelTransform.SetTranslation(Cartesian3(renderParameters->xTranslate, renderParameters->yTranslate, 0.0));
+
     // reset the interface
     renderWindow->ResetInterface();
     } // RenderController::yTranslateChanged()
@@ -136,7 +136,7 @@ void RenderWidget::paintGL()
         // set light position first, pushing/popping matrix so that it the transformation does
         // not affect the position of the geometric object
         glPushMatrix();
-        glMultMatrixf(renderParameters->lightMatrix.columnMajor().coordinates);
+        glMultMatrixf(renderParameters->lightTransform.columnMajor.coordinates);
         glLightfv(GL_LIGHT0, GL_POSITION, renderParameters->lightPosition);
         glPopMatrix();
         
@@ -162,11 +162,8 @@ void RenderWidget::paintGL()
         
         } // use lighting
 
-    // translate by the visual translation
-    glTranslatef(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f);
-
-    // apply rotation matrix from arcball
-    glMultMatrixf(renderParameters->rotationMatrix.columnMajor().coordinates);
+    // apply the rotation from the arcball & the visual translation, as one matrix
+    glMultMatrixf(renderParameters->modelTransform.columnMajor.coordinates);
 
     // now we start using the render parameters
     if (renderParameters->showAxes)
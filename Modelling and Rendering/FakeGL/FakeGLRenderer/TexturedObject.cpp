@@ -32,15 +32,23 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <limits>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <math.h>
 
 // include the Cartesian 3- vector class
 #include "Cartesian3.h"
 
 #define MAXIMUM_LINE_LENGTH 1024
+// levels of detail, counting the full mesh
+#define MAXIMUM_LOD_LEVELS 5
 
 // constructor will initialise to safe values
 TexturedObject::TexturedObject()
-	: centreOfGravity(0.0, 0.0, 0.0)
+	: centreOfGravity(0.0, 0.0, 0.0),
+	arrayScale(0.0)
 { // TexturedObject()
 // force arrays to size 0
 	vertices.resize(0);
@@ -178,6 +186,15 @@ bool TexturedObject::ReadObjectStream(std::istream& geometryStream, std::istream
 
 		} // switch on first character
 
+	// a value that >> can't read (some exporters write "nan") leaves the stream failed
+	// but not at eof, so every get() after it would fail too: skip the rest of the line
+	// the value has already been stored, with zero for whatever couldn't be read
+		if (geometryStream.fail() && !geometryStream.eof())
+		{ // unreadable value
+			geometryStream.clear();
+			geometryStream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		} // unreadable value
+
 	} // not eof
 
 // compute centre of gravity
@@ -210,6 +227,10 @@ bool TexturedObject::ReadObjectStream(std::istream& geometryStream, std::istream
 		} // per vertex
 	} // non-empty vertex set
 
+// the vertex arrays are built now, so that rendering never changes the object
+	BuildVertexArrays();
+	BuildLevelsOfDetail();
+
 // now read in the texture file
 	texture.ReadPPM(textureStream);
 
@@ -291,6 +312,91 @@ void TexturedObject::TransferAssetsToFakeGL(FakeGL* fakeGL)
 	fakeGL->TexImage2D(texture);
 } // TransferAssetsToFakeGL()
 
+// routine to build the vertex arrays from the faces
+void TexturedObject::BuildVertexArrays()
+{ // BuildVertexArrays()
+	arrayPositions.clear();
+	arrayNormals.clear();
+	arrayTexCoords.clear();
+	arrayIndices.clear();
+	arrayScaledPositions.reset();
+
+	// the array vertex already made for each combination of IDs
+	std::map<std::array<unsigned int, 3>, unsigned int> arrayVertexIDs;
+
+	// the faces are split into the same triangle fans as immediate mode uses, in the same order
+	for (unsigned int face = 0; face < faceVertices.size(); face++)
+		for (unsigned int triangle = 0; triangle < faceVertices[face].size() - 2; triangle++)
+			for (unsigned int vertex = 0; vertex < 3; vertex++)
+			{ // per vertex
+				int faceVertex = (vertex == 0) ? 0 : triangle + vertex;
+				std::array<unsigned int, 3> IDs = { faceVertices[face][faceVertex], faceNormals[face][faceVertex], faceTexCoords[face][faceVertex] };
+
+				// look the combination up, adding it if it is new
+				std::map<std::array<unsigned int, 3>, unsigned int>::iterator found = arrayVertexIDs.find(IDs);
+				if (found == arrayVertexIDs.end())
+				{ // new combination
+					found = arrayVertexIDs.insert(std::make_pair(IDs, (unsigned int)arrayPositions.size())).first;
+					arrayPositions.push_back(vertices[IDs[0]]);
+					arrayNormals.push_back(normals[IDs[1]]);
+					arrayTexCoords.push_back(textureCoords[IDs[2]]);
+				} // new combination
+				arrayIndices.push_back(found->second);
+			} // per vertex
+} // BuildVertexArrays()
+
+// routine to build the simpler levels of detail from the vertex arrays
+void TexturedObject::BuildLevelsOfDetail()
+{ // BuildLevelsOfDetail()
+	lodIndices.clear();
+	lodTriangleCounts.assign(1, arrayIndices.size() / 3);
+	if (arrayPositions.empty())
+		return;
+
+	// the bounding box of the vertices, which the grids cover
+	Cartesian3 lowest = arrayPositions[0], highest = arrayPositions[0];
+	for (unsigned int vertex = 1; vertex < arrayPositions.size(); vertex++)
+	{ // per vertex
+		lowest = Cartesian3(std::min(lowest.x, arrayPositions[vertex].x), std::min(lowest.y, arrayPositions[vertex].y), std::min(lowest.z, arrayPositions[vertex].z));
+		highest = Cartesian3(std::max(highest.x, arrayPositions[vertex].x), std::max(highest.y, arrayPositions[vertex].y), std::max(highest.z, arrayPositions[vertex].z));
+	} // per vertex
+	float extent = std::max(highest.x - lowest.x, std::max(highest.y - lowest.y, highest.z - lowest.z));
+
+	// a closed mesh of n triangles has about sqrt(n / 12) along each side of its box, so a grid
+	// a little finer than that merges the smallest details first, and each level halves it again
+	float cellsAcross = sqrtf(arrayIndices.size() / 16.0f);
+	for (int level = 1; level < MAXIMUM_LOD_LEVELS && cellsAcross >= 2.0f && extent > 0.0f; level++, cellsAcross /= 2.0f)
+	{ // per level
+		float cellSize = extent / cellsAcross;
+
+		// every vertex in a cell becomes the first one found in it
+		std::map<std::array<int, 3>, unsigned int> cellVertices;
+		std::vector<unsigned int> clustered(arrayPositions.size());
+		for (unsigned int vertex = 0; vertex < arrayPositions.size(); vertex++)
+		{ // per vertex
+			std::array<int, 3> cell = { (int)((arrayPositions[vertex].x - lowest.x) / cellSize),
+									   (int)((arrayPositions[vertex].y - lowest.y) / cellSize),
+									   (int)((arrayPositions[vertex].z - lowest.z) / cellSize) };
+			clustered[vertex] = cellVertices.insert(std::make_pair(cell, vertex)).first->second;
+		} // per vertex
+
+		// and the triangles that still have three corners are kept
+		std::vector<unsigned int> indices;
+		for (unsigned int index = 0; index + 2 < arrayIndices.size(); index += 3)
+		{ // per triangle
+			unsigned int corners[3] = { clustered[arrayIndices[index]], clustered[arrayIndices[index + 1]], clustered[arrayIndices[index + 2]] };
+			if (corners[0] != corners[1] && corners[1] != corners[2] && corners[2] != corners[0])
+				indices.insert(indices.end(), corners, corners + 3);
+		} // per triangle
+
+		// a level that hardly saves anything, or has next to nothing left, isn't worth having
+		if (indices.size() / 3 < 4 || indices.size() / 3 * 4 > lodTriangleCounts.back() * 3)
+			break;
+		lodTriangleCounts.push_back(indices.size() / 3);
+		lodIndices.push_back(indices);
+	} // per level
+} // BuildLevelsOfDetail()
+
 // routine to render
 void TexturedObject::Render(RenderParameters* renderParameters)
 { // Render()
@@ -475,9 +581,6 @@ void TexturedObject::FakeGLRender(RenderParameters* renderParameters, FakeGL* fa
 	emissiveColour[0] = emissiveColour[1] = emissiveColour[2] = renderParameters->emissiveLight;
 	emissiveColour[3] = 1.0; // don't forget alpha
 
-	// start rendering
-	fakeGL->Begin(FAKEGL_TRIANGLES);
-
 	// we assume a single material for the entire object
 	fakeGL->Materialfv(FAKEGL_EMISSION, emissiveColour);
 	fakeGL->Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, surfaceColour);
@@ -487,61 +590,73 @@ void TexturedObject::FakeGLRender(RenderParameters* renderParameters, FakeGL* fa
 	// repeat this for colour - extra call, but saves if statements
 	fakeGL->Color3f(surfaceColour[0], surfaceColour[1], surfaceColour[2]);
 
-	// loop through the faces: note that they may not be triangles, which complicates life
-	for (unsigned int face = 0; face < faceVertices.size(); face++)
-	{ // per face
-	// on each face, treat it as a triangle fan starting with the first vertex on the face
-		for (unsigned int triangle = 0; triangle < faceVertices[face].size() - 2; triangle++)
-		{ // per triangle
-		// now do a loop over three vertices
-			for (unsigned int vertex = 0; vertex < 3; vertex++)
-			{ // per vertex
-			// we always use the face's vertex 0
-				int faceVertex = 0;
-				// so if it isn't 0, we want to add the triangle base ID
-				if (vertex != 0)
-					faceVertex = triangle + vertex;
-
-				// now we use that ID to lookup
-				fakeGL->Normal3f
-				(
-					normals[faceNormals[face][faceVertex]].x,
-					normals[faceNormals[face][faceVertex]].y,
-					normals[faceNormals[face][faceVertex]].z
-				);
-
-				// if we're using UVW colours, set both colour and material
-				if (renderParameters->mapUVWToRGB)
-				{ // set colour and material
-					float* colourPointer = (float*)&(textureCoords[faceTexCoords[face][faceVertex]]);
-					fakeGL->Materialfv(FAKEGL_AMBIENT_AND_DIFFUSE, colourPointer);
-					fakeGL->Materialfv(FAKEGL_SPECULAR, colourPointer);
-					fakeGL->Color3f(colourPointer[0], colourPointer[1], colourPointer[2]);
-				} // set colour and material
-
-			// set the texture coordinate
-				fakeGL->TexCoord2f
-				(
-					textureCoords[faceTexCoords[face][faceVertex]].x,
-					textureCoords[faceTexCoords[face][faceVertex]].y
-				);
-
-				// and set the vertex position
-				fakeGL->Vertex3f
-				(
-					scale * vertices[faceVertices[face][faceVertex]].x,
-					scale * vertices[faceVertices[face][faceVertex]].y,
-					scale * vertices[faceVertices[face][faceVertex]].z
-				);
-			} // per vertex
-		} // per triangle
-	} // per face
-
-// close off the triangles
-	fakeGL->End();
+	// the faces are drawn from vertex arrays, so that a vertex shared by several
+	// triangles is only lit & transformed once
+	// (an empty object has nothing to draw)
+	if (!arrayIndices.empty())
+	{ // draw arrays
+		// we scale the positions rather than the matrix, as above - held on to until the draw is done
+		std::shared_ptr<const std::vector<Cartesian3> > scaledPositions = ScaledPositions(scale);
+
+		// Cartesian3 is three floats, so the arrays can be read in place
+		fakeGL->VertexPointer(3, sizeof(Cartesian3), &(*scaledPositions)[0].x);
+		fakeGL->NormalPointer(sizeof(Cartesian3), &arrayNormals[0].x);
+		fakeGL->TexCoordPointer(2, sizeof(Cartesian3), &arrayTexCoords[0].x);
+		fakeGL->EnableClientState(FAKEGL_VERTEX_ARRAY);
+		fakeGL->EnableClientState(FAKEGL_NORMAL_ARRAY);
+		fakeGL->EnableClientState(FAKEGL_TEXTURE_COORD_ARRAY);
+
+		// if we're using UVW colours, set both colour and material from them
+		if (renderParameters->mapUVWToRGB)
+		{ // set colour and material
+			fakeGL->ColorPointer(3, sizeof(Cartesian3), &arrayTexCoords[0].x);
+			fakeGL->EnableClientState(FAKEGL_COLOR_ARRAY);
+			fakeGL->ColorMaterial(FAKEGL_AMBIENT_AND_DIFFUSE | FAKEGL_SPECULAR);
+			fakeGL->Enable(FAKEGL_COLOR_MATERIAL);
+		} // set colour and material
+
+		// the object is inside the sphere around its centre of gravity, which
+		// decides whether it can be seen at all, and how much detail is worth drawing
+		Cartesian3 centre = scale * centreOfGravity;
+		float radius = scale * objectSize;
+		if (!fakeGL->CullSphere(centre.x, centre.y, centre.z, radius))
+		{ // visible
+			unsigned int level = fakeGL->LevelOfDetail(centre.x, centre.y, centre.z, radius, &lodTriangleCounts[0], (unsigned int) lodTriangleCounts.size());
+			const std::vector<unsigned int> &indices = (level == 0) ? arrayIndices : lodIndices[level - 1];
+			fakeGL->DrawElements(FAKEGL_TRIANGLES, indices.size(), &indices[0]);
+		} // visible
+
+		// and put the state back
+		fakeGL->Disable(FAKEGL_COLOR_MATERIAL);
+		fakeGL->DisableClientState(FAKEGL_COLOR_ARRAY);
+		fakeGL->DisableClientState(FAKEGL_TEXTURE_COORD_ARRAY);
+		fakeGL->DisableClientState(FAKEGL_NORMAL_ARRAY);
+		fakeGL->DisableClientState(FAKEGL_VERTEX_ARRAY);
+	} // draw arrays
 
 	// if we have texturing enabled, turn texturing back off 
 	if (renderParameters->texturedRendering)
 		fakeGL->Disable(FAKEGL_TEXTURE_2D);
 } // FakeGLRender()
 
+// the positions multiplied by a scale, made again only when the scale changes
+std::shared_ptr<const std::vector<Cartesian3> > TexturedObject::ScaledPositions(float scale)
+{ // ScaledPositions()
+	std::lock_guard<std::mutex> lock(arrayScaleMutex);
+	if (arrayScaledPositions == nullptr || scale != arrayScale)
+	{ // rescale
+		// a new array, as other contexts may still be drawing from the old one
+		std::shared_ptr<std::vector<Cartesian3> > scaled = std::make_shared<std::vector<Cartesian3> >(arrayPositions.size());
+		for (unsigned int vertex = 0; vertex < arrayPositions.size(); vertex++)
+			(*scaled)[vertex] = Cartesian3
+			(
+				scale * arrayPositions[vertex].x,
+				scale * arrayPositions[vertex].y,
+				scale * arrayPositions[vertex].z
+			);
+		arrayScaledPositions = scaled;
+		arrayScale = scale;
+	} // rescale
+	return arrayScaledPositions;
+} // ScaledPositions()
+
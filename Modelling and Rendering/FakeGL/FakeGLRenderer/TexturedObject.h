@@ -31,6 +31,8 @@
 // include the C++ standard libraries we need for the header
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <windows.h>
 #include <GL/gl.h>
 
@@ -77,6 +79,28 @@ class TexturedObject
     // size of object - i.e. radius of circumscribing sphere centred at centre of gravity
     float objectSize;
 
+    // the object as vertex arrays for FakeGL: one array vertex for each distinct
+    // combination of vertex, normal & texture coordinate the faces use, so that each
+    // is only lit & transformed once, and three indices for each triangle
+    std::vector<Cartesian3> arrayPositions;
+    std::vector<Cartesian3> arrayNormals;
+    std::vector<Cartesian3> arrayTexCoords;
+    std::vector<unsigned int> arrayIndices;
+
+    // simpler versions of the mesh for when it is small on screen: each level's triangles
+    // use the same array vertices, clustered on a grid half as fine as the level before's
+    // level 0 is arrayIndices itself, so lodIndices[level - 1] holds level 1 onwards
+    std::vector<std::vector<unsigned int> > lodIndices;
+    // the number of triangles at each level, from level 0
+    std::vector<size_t> lodTriangleCounts;
+
+    // the positions multiplied by the scale they were last rendered at - held by pointer, so a
+    // context still drawing at an earlier scale keeps its copy while another context makes a new one
+    std::shared_ptr<const std::vector<Cartesian3> > arrayScaledPositions;
+    float arrayScale;
+    // FakeGLRender() may be called from several threads at once, each with its own context
+    std::mutex arrayScaleMutex;
+
     // constructor will initialise to safe values
     TexturedObject();
     
@@ -91,12 +115,22 @@ class TexturedObject
     
     // routine to transfer assets to Fake GL
     void TransferAssetsToFakeGL(FakeGL *fakeGL);
+
+    // routine to build the vertex arrays from the faces
+    void BuildVertexArrays();
+
+    // routine to build the simpler levels of detail from the vertex arrays
+    void BuildLevelsOfDetail();
     
     // routine to render
     void Render(RenderParameters *renderParameters);
 
     // routine for students to use when rendering
+    // it only reads the object, so several contexts can render it at once from their own threads
     void FakeGLRender(RenderParameters *renderParameters, FakeGL *fakeGL);
+
+    // the positions multiplied by a scale, made again only when the scale changes
+    std::shared_ptr<const std::vector<Cartesian3> > ScaledPositions(float scale);
     }; // class TexturedObject
 
 // end of include guard for TexturedObject
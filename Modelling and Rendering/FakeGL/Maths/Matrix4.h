@@ -9,9 +9,19 @@
 //  ------------------------
 //  Matrix4.h
 //  ------------------------
-//  
+//
 //  A minimal class for a homogeneous 4x4 matrix
-//  
+//
+//  Everything but the stream I/O & SetRotation() (which needs the
+//  quaternions) is inline.  Where SSE2 is there, the matrix-vector &
+//  matrix-matrix products work on a row at a time with it, adding the
+//  products up in the same order as the plain loops, so the results are
+//  the same to the last bit either way
+//
+//  The Transform...() routines do whole arrays of points, directions or
+//  normals at once, loading the matrix just once, and leave out the
+//  division by w when the matrix is affine, as w is then always 1
+//
 ///////////////////////////////////////////////////
 
 // include guard
@@ -19,22 +29,29 @@
 #define MATRIX4_H
 
 #include <iostream>
+#include <stddef.h>
 #include "Cartesian3.h"
 #include "Homogeneous4.h"
 
+// SSE2 is always there on x64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATRIX4_SSE2
+#include <emmintrin.h>
+#endif
+
 // forward declaration
 class Matrix4;
 
 #include "Quaternion.h"
 
-// this allows us to get a matrix in the 
+// this allows us to get a matrix in the
 // column-major form preferred by OpenGL
 class columnMajorMatrix
     { // class columnMajorMatrix
     public:
     float coordinates[16];
     }; // class columnMajorMatrix
-    
+
 // the class itself, stored in row-major form
 class Matrix4
     { // Matrix4
@@ -43,17 +60,18 @@ class Matrix4
     float coordinates[4][4];
 
     // constructor - default to the zero matrix
-    Matrix4();
+    constexpr Matrix4();
     // copy constructor
-    Matrix4(const Matrix4 &other);
-    
+    Matrix4(const Matrix4 &other) = default;
+    Matrix4 &operator =(const Matrix4 &other) = default;
+
     // equality operator
     bool operator ==(const Matrix4 &other) const;
 
     // indexing - retrieves the beginning of a line
     // array indexing will then retrieve an element
     float * operator [](const int rowIndex);
-    
+
     // similar routine for const pointers
     const float * operator [](const int rowIndex) const;
 
@@ -74,15 +92,33 @@ class Matrix4
     // subtraction operator
     Matrix4 operator -(const Matrix4 &other) const;
     // multiplication operator
-    Matrix4 operator *(const Matrix4 &other) const; 
-    
+    Matrix4 operator *(const Matrix4 &other) const;
+
     // matrix transpose
     Matrix4 transpose() const;
-    
+
     // returns a column-major array of 16 values
     // for use with OpenGL
     columnMajorMatrix columnMajor() const;
 
+    // whether the bottom row is (0, 0, 0, 1), as it is for all but projections
+    bool IsAffine() const;
+
+    // the inverse transpose of the upper 3x3, for normals, with the rest zero
+    Matrix4 NormalMatrix() const;
+
+    // batched transforms of count points etc., which may be transformed in place:
+    // the same answers as multiplying each in turn
+    // homogeneous points, as operator *()
+    void TransformPoints(const Homogeneous4 *points, Homogeneous4 *transformed, size_t count) const;
+    // Cartesian points, as operator *(), with no division when the matrix is affine
+    void TransformPoints(const Cartesian3 *points, Cartesian3 *transformed, size_t count) const;
+    // directions, by the upper 3x3 alone, as if w were 0
+    void TransformDirections(const Cartesian3 *directions, Cartesian3 *transformed, size_t count) const;
+    // normals, by NormalMatrix(), so they stay at right angles to the surface even under
+    // scales that differ along the axes - they are not made unit length again
+    void TransformNormals(const Cartesian3 *normals, Cartesian3 *transformed, size_t count) const;
+
     // methods that set to particular matrices
     void SetZero();
     // the identity matrix
@@ -101,5 +137,357 @@ std::istream & operator >> (std::istream &inStream, Matrix4 &value);
 
 // stream output
 std::ostream & operator << (std::ostream &outStream, const Matrix4 &value);
-        
+
+#ifdef MATRIX4_SSE2
+// loads the columns of a matrix, for the products below
+inline void Matrix4Columns(const Matrix4 &matrix, __m128 columns[4])
+    { // Matrix4Columns()
+    for (int row = 0; row < 4; row++)
+        columns[row] = _mm_loadu_ps(matrix.coordinates[row]);
+    _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+    } // Matrix4Columns()
+#endif
+
+// constructor - default to the zero matrix
+constexpr Matrix4::Matrix4()
+    : coordinates()
+    { // default constructor
+    } // default constructor
+
+// equality operator
+inline bool Matrix4::operator ==(const Matrix4 &other) const
+    { // operator ==()
+    // loop through, testing for mismatches
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            if (coordinates[row][col] != other.coordinates[row][col])
+                return false;
+    // if no mismatches, matrices are the same
+    return true;
+    } // operator ==()
+
+// indexing - retrieves the beginning of a line
+// array indexing will then retrieve an element
+inline float * Matrix4::operator [](const int rowIndex)
+    { // operator *()
+    // return the corresponding row
+    return coordinates[rowIndex];
+    } // operator *()
+
+// similar routine for const pointers
+inline const float * Matrix4::operator [](const int rowIndex) const
+    { // operator *()
+    // return the corresponding row
+    return coordinates[rowIndex];
+    } // operator *()
+
+// scalar operations
+// multiplication operator (no division operator)
+inline Matrix4 Matrix4::operator *(float factor) const
+    { // operator *()
+    Matrix4 returnMatrix;
+    // multiply by the factor
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            returnMatrix.coordinates[row][col] = coordinates[row][col] * factor;
+    // and return it
+    return returnMatrix;
+    } // operator *()
+
+// vector operations on homogeneous coordinates
+// multiplication is the only operator we use
+inline Homogeneous4 Matrix4::operator *(const Homogeneous4 &vector) const
+    { // operator *()
+#ifdef MATRIX4_SSE2
+    // the columns, each scaled by one coordinate of the vector & added up in turn:
+    // each lane is then one row's sum, in the same order as the loop below
+    __m128 columns[4];
+    Matrix4Columns(*this, columns);
+
+    // starting from zero, as the loop does, so that a sum of -0s still comes out as +0
+    __m128 product = _mm_setzero_ps();
+    product = _mm_add_ps(product, _mm_mul_ps(columns[0], _mm_set1_ps(vector.x)));
+    product = _mm_add_ps(product, _mm_mul_ps(columns[1], _mm_set1_ps(vector.y)));
+    product = _mm_add_ps(product, _mm_mul_ps(columns[2], _mm_set1_ps(vector.z)));
+    product = _mm_add_ps(product, _mm_mul_ps(columns[3], _mm_set1_ps(vector.w)));
+
+    float productCoordinates[4];
+    _mm_storeu_ps(productCoordinates, product);
+    return Homogeneous4(productCoordinates[0], productCoordinates[1], productCoordinates[2], productCoordinates[3]);
+#else
+    // get a zero-initialised vector
+    Homogeneous4 productVector;
+
+    // now loop, adding products
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            productVector[row] += coordinates[row][col] * vector[col];
+
+    // return the result
+    return productVector;
+#endif
+    } // operator *()
+
+// and on Cartesian coordinates
+inline Cartesian3 Matrix4::operator *(const Cartesian3 &vector) const
+    { // cartesian multiplication
+    // convert to Homogeneous coords and multiply
+    Homogeneous4 productVector = (*this) * Homogeneous4(vector);
+
+    // then divide back through
+    return productVector.Point();
+    } // cartesian multiplication
+
+// matrix operations
+// addition operator
+inline Matrix4 Matrix4::operator +(const Matrix4 &other) const
+    { // operator +()
+    Matrix4 sumMatrix;
+
+    // now loop, adding
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            sumMatrix.coordinates[row][col] = coordinates[row][col] + other.coordinates[row][col];
+
+    // return the result
+    return sumMatrix;
+    } // operator +()
+
+// subtraction operator
+inline Matrix4 Matrix4::operator -(const Matrix4 &other) const
+    { // operator -()
+    Matrix4 differenceMatrix;
+
+    // now loop, subtracting
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            differenceMatrix.coordinates[row][col] = coordinates[row][col] - other.coordinates[row][col];
+
+    // return the result
+    return differenceMatrix;
+    } // operator -()
+
+// multiplication operator
+inline Matrix4 Matrix4::operator *(const Matrix4 &other) const
+    { // operator *()
+    // start with a zero matrix
+    Matrix4 productMatrix;
+
+#ifdef MATRIX4_SSE2
+    // a row of the product is the rows of the other matrix, scaled by this row's entries
+    // & added up in turn - each lane in the same order as the loop below
+    __m128 otherRows[4];
+    for (int entry = 0; entry < 4; entry++)
+        otherRows[entry] = _mm_loadu_ps(other.coordinates[entry]);
+    for (int row = 0; row < 4; row++)
+        { // per row
+        __m128 productRow = _mm_setzero_ps();
+        for (int entry = 0; entry < 4; entry++)
+            productRow = _mm_add_ps(productRow, _mm_mul_ps(_mm_set1_ps(coordinates[row][entry]), otherRows[entry]));
+        _mm_storeu_ps(productMatrix.coordinates[row], productRow);
+        } // per row
+#else
+    // now loop, adding products
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            for (int entry = 0; entry < 4; entry++)
+                productMatrix.coordinates[row][col] += coordinates[row][entry] * other.coordinates[entry][col];
+#endif
+
+    // return the result
+    return productMatrix;
+    } // operator *()
+
+// matrix transpose
+inline Matrix4 Matrix4::transpose() const
+    { // transpose()
+    Matrix4 transposeMatrix;
+
+    // now loop, swapping rows & columns
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            transposeMatrix.coordinates[row][col] = coordinates[col][row];
+
+    // return the result
+    return transposeMatrix;
+    } // transpose()
+
+// returns a column-major array of 16 values
+// for use with OpenGL
+inline columnMajorMatrix Matrix4::columnMajor() const
+    { // columnMajor()
+    // start off with an unitialised array
+    columnMajorMatrix returnArray;
+    // loop to fill in
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            returnArray.coordinates[4 * col + row] = coordinates[row][col];
+    // now return the array
+    return returnArray;
+    } // columnMajor()
+
+// whether the bottom row is (0, 0, 0, 1), as it is for all but projections
+inline bool Matrix4::IsAffine() const
+    { // IsAffine()
+    return coordinates[3][0] == 0.0f && coordinates[3][1] == 0.0f && coordinates[3][2] == 0.0f && coordinates[3][3] == 1.0f;
+    } // IsAffine()
+
+// the inverse transpose of the upper 3x3, for normals, with the rest zero
+inline Matrix4 Matrix4::NormalMatrix() const
+    { // NormalMatrix()
+    Cartesian3 row0(coordinates[0][0], coordinates[0][1], coordinates[0][2]);
+    Cartesian3 row1(coordinates[1][0], coordinates[1][1], coordinates[1][2]);
+    Cartesian3 row2(coordinates[2][0], coordinates[2][1], coordinates[2][2]);
+
+    // the rows of the cofactors are cross products of the other two rows,
+    // and the inverse transpose is the cofactors over the determinant
+    Cartesian3 cofactors[3] = { row1.cross(row2), row2.cross(row0), row0.cross(row1) };
+    float determinant = row0.dot(cofactors[0]);
+
+    // a singular matrix has no inverse, but the cofactors still point the right way
+    Matrix4 normalMatrix;
+    for (int row = 0; row < 3; row++)
+        for (int col = 0; col < 3; col++)
+            normalMatrix.coordinates[row][col] = determinant != 0.0f ? cofactors[row][col] / determinant : cofactors[row][col];
+    return normalMatrix;
+    } // NormalMatrix()
+
+// batched transform of homogeneous points, as operator *()
+inline void Matrix4::TransformPoints(const Homogeneous4 *points, Homogeneous4 *transformed, size_t count) const
+    { // TransformPoints()
+#ifdef MATRIX4_SSE2
+    __m128 columns[4];
+    Matrix4Columns(*this, columns);
+    for (size_t point = 0; point < count; point++)
+        { // per point
+        // the same sum as operator *(), with the columns kept in registers
+        __m128 product = _mm_setzero_ps();
+        product = _mm_add_ps(product, _mm_mul_ps(columns[0], _mm_set1_ps(points[point].x)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[1], _mm_set1_ps(points[point].y)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[2], _mm_set1_ps(points[point].z)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[3], _mm_set1_ps(points[point].w)));
+        _mm_storeu_ps(&transformed[point].x, product);
+        } // per point
+#else
+    for (size_t point = 0; point < count; point++)
+        transformed[point] = (*this) * points[point];
+#endif
+    } // TransformPoints()
+
+// batched transform of Cartesian points, as operator *(), with no division when the matrix is affine
+inline void Matrix4::TransformPoints(const Cartesian3 *points, Cartesian3 *transformed, size_t count) const
+    { // TransformPoints()
+    // w comes out as exactly 1 if the matrix is affine, so dividing by it changes nothing
+    bool affine = IsAffine();
+#ifdef MATRIX4_SSE2
+    __m128 columns[4];
+    Matrix4Columns(*this, columns);
+    for (size_t point = 0; point < count; point++)
+        { // per point
+        // w is 1, and multiplying the last column by it changes nothing
+        __m128 product = _mm_setzero_ps();
+        product = _mm_add_ps(product, _mm_mul_ps(columns[0], _mm_set1_ps(points[point].x)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[1], _mm_set1_ps(points[point].y)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[2], _mm_set1_ps(points[point].z)));
+        product = _mm_add_ps(product, columns[3]);
+        if (!affine)
+            product = _mm_div_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(3, 3, 3, 3)));
+        float productCoordinates[4];
+        _mm_storeu_ps(productCoordinates, product);
+        transformed[point] = Cartesian3(productCoordinates[0], productCoordinates[1], productCoordinates[2]);
+        } // per point
+#else
+    for (size_t point = 0; point < count; point++)
+        { // per point
+        Homogeneous4 product = (*this) * Homogeneous4(points[point]);
+        transformed[point] = affine ? product.Vector() : product.Point();
+        } // per point
+#endif
+    } // TransformPoints()
+
+// batched transform of directions, by the upper 3x3 alone, as if w were 0
+inline void Matrix4::TransformDirections(const Cartesian3 *directions, Cartesian3 *transformed, size_t count) const
+    { // TransformDirections()
+#ifdef MATRIX4_SSE2
+    __m128 columns[4];
+    Matrix4Columns(*this, columns);
+    for (size_t direction = 0; direction < count; direction++)
+        { // per direction
+        __m128 product = _mm_setzero_ps();
+        product = _mm_add_ps(product, _mm_mul_ps(columns[0], _mm_set1_ps(directions[direction].x)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[1], _mm_set1_ps(directions[direction].y)));
+        product = _mm_add_ps(product, _mm_mul_ps(columns[2], _mm_set1_ps(directions[direction].z)));
+        float productCoordinates[4];
+        _mm_storeu_ps(productCoordinates, product);
+        transformed[direction] = Cartesian3(productCoordinates[0], productCoordinates[1], productCoordinates[2]);
+        } // per direction
+#else
+    for (size_t direction = 0; direction < count; direction++)
+        { // per direction
+        Cartesian3 product;
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                product[row] += coordinates[row][col] * directions[direction][col];
+        transformed[direction] = product;
+        } // per direction
+#endif
+    } // TransformDirections()
+
+// batched transform of normals, by NormalMatrix()
+inline void Matrix4::TransformNormals(const Cartesian3 *normals, Cartesian3 *transformed, size_t count) const
+    { // TransformNormals()
+    // worked out once for the whole array
+    NormalMatrix().TransformDirections(normals, transformed, count);
+    } // TransformNormals()
+
+// factory methods that create specific matrices
+// the zero matrix
+inline void Matrix4::SetZero()
+    { // SetZero()
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            coordinates[row][col] = 0.0;
+    } // SetZero()
+
+// the identity matrix
+inline void Matrix4::SetIdentity()
+    { // SetIdentity()
+    // start with a zero matrix
+    SetZero();
+    // fill in the diagonal with 1's
+    for (int row = 0; row < 4; row++)
+            coordinates[row][row] = 1.0;
+    } // SetIdentity()
+
+inline void Matrix4::SetTranslation(const Cartesian3 &vector)
+    { // SetTranslation()
+    // start with an identity matrix
+    SetIdentity();
+
+    // put the translation in the w column
+    for (int entry = 0; entry < 3; entry++)
+        coordinates[entry][3] = vector[entry];
+    } // SetTranslation()
+
+inline void Matrix4::SetScale(float xScale, float yScale, float zScale)
+    { // SetScale()
+    // start off with a zero matrix
+    SetZero();
+
+    // set the scale factors
+    coordinates[0][0] = xScale;
+    coordinates[1][1] = yScale;
+    coordinates[2][2] = zScale;
+    coordinates[3][3] = 1.0;
+
+    } // SetScale()
+
+// scalar operations
+// additional scalar multiplication operator
+inline Matrix4 operator *(float factor, const Matrix4 &matrix)
+    { // operator *()
+    // since this is commutative, call the other version
+    return matrix * factor;
+    } // operator *()
+
 #endif
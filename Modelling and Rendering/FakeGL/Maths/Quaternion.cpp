@@ -12,9 +12,9 @@
 //  
 //  A class representing a quaternion
 //  
-//  Note: the emphasis here is on clarity, not efficiency
-//  A number of the routines could be implemented more
-//  efficiently but aren't
+//  Only what needs the whole of Matrix4, the angle & axis of the
+//  rotation, and the stream I/O are here - the rest is inline, in
+//  the header
 //  
 ///////////////////////////////////////////////////
 
@@ -22,50 +22,6 @@
 #include <math.h>
 #include "Quaternion.h"
 
-// constructor
-Quaternion::Quaternion()
-    { // constructor
-    coords[0] = coords[1] = coords[2] = 0.0;
-    coords[3] = 1.0;
-    } // constructor
-
-// constructor: sets the quaternion to (x, y, z, w)
-Quaternion::Quaternion(float x, float y, float z, float w)
-    { // constructor
-    coords[0] = x;
-    coords[1] = y;
-    coords[2] = z;
-    coords[3] = w;
-    } // constructor
-    
-// Set to a pure scalar value
-Quaternion::Quaternion(float scalar)
-    { // copy scalar
-    // set first three coords to 0.0
-    for (int i = 0; i < 3; i++)
-        coords[i] = 0.0;
-    // and the real part to the scalar
-    coords[3] = scalar;
-    } // copy scalar
-
-// Set to a pure vector value
-Quaternion::Quaternion(const Cartesian3 &vector)
-    { // copy vector
-    // copy vector part
-    for (int i = 0; i < 3; i++)
-        coords[i] = vector[i];
-    // set the real part to 0.0
-    coords[3] = 0.0;
-    } // copy vector
-    
-// Set to a homogeneous point
-Quaternion::Quaternion(const Homogeneous4 &point)
-    { // copy point
-    // just copy the coordinates
-    for (int i = 0; i < 4; i++)
-        coords[i] = point[i];
-    } // copy point
-    
 // Set to a rotation defined by a rotation matrix
 // WARNING: MATRIX MUST BE A VALID ROTATION MATRIX
 Quaternion::Quaternion(const Matrix4 &matrix)
@@ -93,151 +49,6 @@ Quaternion::Quaternion(const Matrix4 &matrix)
     coords[3] = w;
     } // copy rotation matrix
     
-// Set to a rotation defined by an axis and angle
-Quaternion::Quaternion(const Cartesian3 &axis, float theta)
-    { // Quaternion()
-    // convert the axis to a unit vector and multiply by sin theta
-    // then add cos theta as a scalar
-    (*this) = Quaternion(axis.unit() * sin(theta)) + Quaternion(cos(theta));
-    } // Quaternion()
-
-// Copy another Quaternion & return self
-Quaternion &Quaternion::operator = (const Quaternion &other)
-    { // copy quaternion
-    for (int i = 0; i < 4; i++)
-        coords[i] = other.coords[i];
-    return (*this); 
-    } // copy quaternion
-
-// Computes the norm (sum of squares)
-float Quaternion::Norm() const
-    { // Norm()
-    return (coords[0]*coords[0]+coords[1]*coords[1]+
-        coords[2]*coords[2]+coords[3]*coords[3]);
-    } // Norm()
-    
-// Reduce to unit quaternion
-Quaternion Quaternion::Unit() const
-    { // Unit()
-    Quaternion result;
-    // get the square root of the norm
-    float sqrtNorm = Norm();
-    // now divide by it
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = coords[i] / sqrtNorm;
-    return result;
-    } // Unit()
-    
-// Conjugate the quaternion
-Quaternion Quaternion::Conjugate() const
-    { // Conjugate()
-    Quaternion result;
-    for (int i = 0; i < 3; i++)
-        result.coords[i] = coords[i] * -1;
-    result.coords[3] = coords[3];
-    return result;
-    } // Conjugate()
-    
-// Invert the quaternion
-Quaternion Quaternion::Inverse() const
-    { // Invert()
-    Quaternion result = Conjugate() / Norm();
-    return result;
-    } // Invert()
-
-// Scalar left-multiplication
-Quaternion operator *(float scalar, const Quaternion &quat)
-    { // scalar left-multiplication
-    Quaternion result;
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = scalar * quat.coords[i];
-    return result;
-    } // scalar left-multiplication
-
-// Scalar right-multiplication
-Quaternion Quaternion::operator *(float scalar) const
-    { // scalar right-multiplication
-    Quaternion result;
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = coords[i] * scalar;
-    return result;
-    } // scalar right-multiplication
-    
-// Scalar right-division
-Quaternion Quaternion::operator /(float scalar) const
-    { // scalar right-division
-    Quaternion result;
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = coords[i] / scalar;
-    return result;
-    } // scalar right-division
-
-// Adds two quaternions together
-Quaternion Quaternion::operator +(const Quaternion &other) const
-    { // addition
-    Quaternion result;
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = coords[i] + other.coords[i];
-    return result;
-    } // addition
-
-// Subtracts one quaternion from another
-Quaternion Quaternion::operator -(const Quaternion &other) const
-    { // subtraction
-    Quaternion result;
-    for (int i = 0; i < 4; i++)
-        result.coords[i] = coords[i] - other.coords[i];
-    return result;
-    } // subtraction
-
-// Multiplies two quaternions together
-Quaternion Quaternion::operator *(const Quaternion &other) const
-    { // multiplication
-    Quaternion result;
-    // and compute each set of coords   
-    result.coords[0] =  + coords[0] * other.coords[3]  // i 1
-                        + coords[1] * other.coords[2]  // j k
-                        - coords[2] * other.coords[1]  // k j 
-                        + coords[3] * other.coords[0]; // 1 i
-                
-    result.coords[1] =  - coords[0] * other.coords[2]  // i k
-                        + coords[1] * other.coords[3]  // j 1
-                        + coords[2] * other.coords[0]  // k i 
-                        + coords[3] * other.coords[1]; // 1 j
-    
-    result.coords[2] =  + coords[0] * other.coords[1]  // i j
-                        - coords[1] * other.coords[0]  // j i
-                        + coords[2] * other.coords[3]  // k 1 
-                        + coords[3] * other.coords[2]; // 1 k
-
-    result.coords[3] =  - coords[0] * other.coords[0]  // i i
-                        - coords[1] * other.coords[1]  // j j
-                        - coords[2] * other.coords[2]  // k k 
-                        + coords[3] * other.coords[3]; // 1 1
-    return result;
-    } // multiplication
-
-// Acts on a vector
-Cartesian3 Quaternion::Act(const Cartesian3 &vector) const
-    { // Act()
-    // compute the result
-    Quaternion resultQuat = Inverse() * Quaternion(vector) * (*this);
-    Cartesian3 resultVector(resultQuat.coords[0], resultQuat.coords[1], 
-        resultQuat.coords[2]);
-    // and return the vector
-    return resultVector;
-    } // Act()
-    
-// Acts on a homogeneous point
-Homogeneous4 Quaternion::Act(const Homogeneous4 &point) const
-    { // Act()
-    Quaternion resultQuat = Inverse() * Quaternion(point) * (*this);
-    Homogeneous4 resultPoint(resultQuat.coords[0], resultQuat.coords[1], 
-        resultQuat.coords[2], resultQuat.coords[3]);
-    // and return the point
-    return resultPoint;
-    } // Act()
-    
 // Returns the angle 2*theta of the action in degrees
 float Quaternion::AngleOfAction() const
     { // AngleOfAction()
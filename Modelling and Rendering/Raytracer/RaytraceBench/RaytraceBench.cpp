@@ -0,0 +1,399 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  RaytraceBench.cpp
+//  -----------------------------
+//
+//  Renders every model in the objects directory at fixed sizes, with a
+//  fixed camera & light, under each combination of features, and reports
+//  ms/frame, Mrays/s & peak memory.  Each frame is checked against a
+//  golden checksum, and its time against a stored baseline.
+//
+//  Usage: RaytraceBench [options]
+//      --objects dir           models to render (default ../objects)
+//      --texture file          texture to use (default ../textures/earth.ppm)
+//      --baseline file         baseline to compare with (default baseline.json)
+//      --write-baseline file   writes the results as a new baseline
+//      --tolerance fraction    overrides the baseline's allowed slow-down
+//      --repeats n             most times a frame is rendered, the fastest counts (default 3)
+//      --filter text           only renders models whose names contain text
+//
+//  Exits with 1 if any checksum differs or any frame is slower than the
+//  baseline allows.
+//
+////////////////////////////////////////////////////////////////////////
+
+// system libraries
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+// local includes
+#include "TexturedObject.h"
+#include "RenderParameters.h"
+#include "Raytracer.h"
+
+// the fixed image sizes - kept small, as every ray is tested against every triangle
+static const int benchSizes[][2] = { {32, 24}, {64, 48} };
+static const int nBenchSizes = sizeof(benchSizes) / sizeof(benchSizes[0]);
+
+// frames are only repeated while they have taken less than this in total
+static const double repeatBudgetMilliseconds = 250.0;
+
+// a set of feature toggles
+class BenchConfig
+    { // class BenchConfig
+    public:
+    const char *name;
+    bool lighting, shadows, texture, impulse;
+    }; // class BenchConfig
+
+static const BenchConfig benchConfigs[] =
+    {
+    // name         lighting    shadows     texture     impulse
+    { "unlit",      false,      false,      false,      false   },
+    { "lit",        true,       false,      false,      false   },
+    { "shadows",    true,       true,       false,      false   },
+    { "textured",   true,       false,      true,       false   },
+    { "full",       true,       true,       true,       true    },
+    };
+static const int nBenchConfigs = sizeof(benchConfigs) / sizeof(benchConfigs[0]);
+
+// what we measured, or what the baseline says we should measure
+class BenchResult
+    { // class BenchResult
+    public:
+    double milliseconds;
+    std::string checksum;
+    }; // class BenchResult
+
+// the stored baseline
+class Baseline
+    { // class Baseline
+    public:
+    // allowed slow-down, as a fraction of the baseline time
+    double tolerance = 0.25;
+    // differences smaller than this are timer noise, whatever the fraction
+    double minimumMilliseconds = 2.0;
+    std::map<std::string, BenchResult> results;
+    }; // class Baseline
+
+// 64 bit FNV-1a hash of the image, as hex
+static std::string Checksum(const RGBAImage &image)
+    { // Checksum()
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char *bytes = (const unsigned char *) image.block;
+    for (long i = 0; i < image.width * image.height * (long) sizeof(RGBAValue); i++)
+        { // per byte
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+        } // per byte
+
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+    } // Checksum()
+
+// peak resident set size of the process so far, in kilobytes
+static long PeakRSSKilobytes()
+    { // PeakRSSKilobytes()
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // reported in bytes on macOS, kilobytes elsewhere
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+    } // PeakRSSKilobytes()
+
+// sorted list of the models in a directory
+static std::vector<std::string> ListModels(const std::string &directory)
+    { // ListModels()
+    std::vector<std::string> models;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return models;
+
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir))
+        { // per entry
+        std::string name(entry->d_name);
+        // skip hidden files, including the ._ files macOS leaves behind
+        if (name.empty() || name[0] == '.')
+            continue;
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos)
+            continue;
+        std::string extension = name.substr(dot);
+        if (extension == ".obj" || extension == ".obji")
+            models.push_back(name);
+        } // per entry
+    closedir(dir);
+
+    std::sort(models.begin(), models.end());
+    return models;
+    } // ListModels()
+
+// reads the baseline written by WriteBaseline() - one result per line
+static bool ReadBaseline(const std::string &fileName, Baseline &baseline)
+    { // ReadBaseline()
+    std::ifstream inFile(fileName.c_str());
+    if (!inFile.good())
+        return false;
+
+    std::string line;
+    while (std::getline(inFile, line))
+        { // per line
+        size_t field;
+        if ((field = line.find("\"tolerance\":")) != std::string::npos)
+            baseline.tolerance = atof(line.c_str() + field + 12);
+        else if ((field = line.find("\"minimum_ms\":")) != std::string::npos)
+            baseline.minimumMilliseconds = atof(line.c_str() + field + 13);
+        else if ((field = line.find("\"ms\":")) != std::string::npos)
+            { // result
+            // "key": {"ms": 1.234, "checksum": "0123456789abcdef"},
+            size_t keyStart = line.find('"');
+            size_t keyEnd = line.find('"', keyStart + 1);
+            size_t sumField = line.find("\"checksum\":");
+            if (keyEnd == std::string::npos || sumField == std::string::npos)
+                continue;
+            size_t sumStart = line.find('"', sumField + 11);
+            size_t sumEnd = line.find('"', sumStart + 1);
+            if (sumEnd == std::string::npos)
+                continue;
+
+            BenchResult result;
+            result.milliseconds = atof(line.c_str() + field + 5);
+            result.checksum = line.substr(sumStart + 1, sumEnd - sumStart - 1);
+            baseline.results[line.substr(keyStart + 1, keyEnd - keyStart - 1)] = result;
+            } // result
+        } // per line
+    return true;
+    } // ReadBaseline()
+
+// writes the results in a form ReadBaseline() can read back
+static void WriteBaseline(const std::string &fileName, const Baseline &baseline)
+    { // WriteBaseline()
+    std::ofstream outFile(fileName.c_str());
+    outFile << "{" << std::endl;
+    outFile << "    \"tolerance\": " << baseline.tolerance << "," << std::endl;
+    outFile << "    \"minimum_ms\": " << baseline.minimumMilliseconds << "," << std::endl;
+    outFile << "    \"results\": {" << std::endl;
+
+    for (std::map<std::string, BenchResult>::const_iterator i = baseline.results.begin(); i != baseline.results.end(); i++)
+        { // per result
+        if (i != baseline.results.begin())
+            outFile << "," << std::endl;
+        outFile << "        \"" << i->first << "\": {\"ms\": " << std::fixed << std::setprecision(3) << i->second.milliseconds
+                << ", \"checksum\": \"" << i->second.checksum << "\"}";
+        } // per result
+
+    outFile << std::endl << "    }" << std::endl << "}" << std::endl;
+    } // WriteBaseline()
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    std::string objectsDirectory = "../objects";
+    std::string textureName = "../textures/earth.ppm";
+    std::string baselineName = "baseline.json";
+    std::string writeBaselineName;
+    std::string filter;
+    double tolerance = -1.0;
+    int repeats = 3;
+
+    for (int arg = 1; arg < argc; arg++)
+        { // per arg
+        std::string option(argv[arg]);
+        if (arg + 1 >= argc)
+            { // missing value
+            std::cout << "Missing value for " << option << std::endl;
+            return 1;
+            } // missing value
+
+        std::string value(argv[++arg]);
+        if (option == "--objects")                  objectsDirectory = value;
+        else if (option == "--texture")             textureName = value;
+        else if (option == "--baseline")            baselineName = value;
+        else if (option == "--write-baseline")      writeBaselineName = value;
+        else if (option == "--tolerance")           tolerance = atof(value.c_str());
+        else if (option == "--repeats")             repeats = std::max(1, atoi(value.c_str()));
+        else if (option == "--filter")              filter = value;
+        else
+            { // bad option
+            std::cout << "Unknown option " << option << std::endl;
+            return 1;
+            } // bad option
+        } // per arg
+
+    std::vector<std::string> models = ListModels(objectsDirectory);
+    if (models.empty())
+        { // no models
+        std::cout << "No models found in " << objectsDirectory << std::endl;
+        return 1;
+        } // no models
+
+    Baseline baseline;
+    bool haveBaseline = ReadBaseline(baselineName, baseline);
+    if (tolerance >= 0.0)
+        baseline.tolerance = tolerance;
+    if (!haveBaseline)
+        std::cout << "No baseline in " << baselineName << ", nothing will be compared" << std::endl;
+
+    Baseline measured;
+    measured.tolerance = baseline.tolerance;
+    measured.minimumMilliseconds = baseline.minimumMilliseconds;
+
+    // the same camera & light for everything: a three-quarter view, lit from above left
+    RenderParameters fixedParameters;
+    Matrix4 modelRotation, lightRotation;
+    modelRotation.SetRotation(Cartesian3(1.0, 1.0, 0.0), 0.6);
+    lightRotation.SetRotation(Cartesian3(1.0, -1.0, 0.0), -0.8);
+    fixedParameters.modelTransform.SetRotation(modelRotation);
+    fixedParameters.lightTransform.SetRotation(lightRotation);
+    fixedParameters.showObject = true;
+    fixedParameters.centreObject = true;
+    fixedParameters.scaleObject = true;
+    fixedParameters.renderRT = true;
+    fixedParameters.textureModulation = true;
+
+    int failures = 0;
+    double totalMilliseconds = 0.0;
+    unsigned long long totalRays = 0;
+
+    std::cout << std::left << std::setw(32) << "model" << std::setw(9) << "size" << std::setw(10) << "features"
+              << std::right << std::setw(12) << "ms/frame" << std::setw(10) << "Mrays/s" << std::setw(12) << "peak KB"
+              << "  result" << std::endl;
+
+    for (size_t model = 0; model < models.size(); model++)
+        { // per model
+        if (models[model].find(filter) == std::string::npos)
+            continue;
+
+        TexturedObject texturedObject;
+        std::ifstream geometryFile((objectsDirectory + "/" + models[model]).c_str());
+        std::ifstream textureFile(textureName.c_str());
+        if (!(geometryFile.good()) || !(textureFile.good()) || (!texturedObject.ReadObjectStream(geometryFile, textureFile)))
+            { // object read failed
+            std::cout << "Read failed for object " << models[model] << " or texture " << textureName << std::endl;
+            failures++;
+            continue;
+            } // object read failed
+
+        for (int size = 0; size < nBenchSizes; size++)
+            for (int config = 0; config < nBenchConfigs; config++)
+                { // per frame
+                const BenchConfig &features = benchConfigs[config];
+                RenderParameters renderParameters = fixedParameters;
+                renderParameters.useLighting = features.lighting;
+                renderParameters.shadowsOn = features.shadows;
+                renderParameters.texturedRendering = features.texture;
+                renderParameters.impulseReflectionOn = features.impulse;
+
+                Raytracer raytracer;
+                texturedObject.TransferAssetsToRaytracer(&raytracer);
+                raytracer.frameBuffer.Resize(benchSizes[size][0], benchSizes[size][1]);
+                raytracer.depthBuffer.Resize(benchSizes[size][0], benchSizes[size][1]);
+
+                // time the trace itself, taking the fastest of the repeats
+                // slow frames are steady enough that they are only repeated within a time budget
+                double bestMilliseconds = 0.0;
+                double spentMilliseconds = 0.0;
+                unsigned long long rays = 0;
+                for (int repeat = 0; repeat < repeats && (repeat == 0 || spentMilliseconds < repeatBudgetMilliseconds); repeat++)
+                    { // per repeat
+                    texturedObject.SetUpRaytraceScene(&renderParameters, &raytracer);
+                    raytracer.raysCast = 0;
+
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    raytracer.drawScreenByPix();
+                    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                    spentMilliseconds += milliseconds;
+                    if (repeat == 0 || milliseconds < bestMilliseconds)
+                        bestMilliseconds = milliseconds;
+                    rays = raytracer.raysCast;
+                    } // per repeat
+
+                std::ostringstream keyStream;
+                keyStream << models[model] << " " << benchSizes[size][0] << "x" << benchSizes[size][1] << " " << features.name;
+                std::string key = keyStream.str();
+
+                BenchResult result;
+                result.milliseconds = bestMilliseconds;
+                result.checksum = Checksum(raytracer.frameBuffer);
+                measured.results[key] = result;
+
+                totalMilliseconds += bestMilliseconds;
+                totalRays += rays;
+
+                // compare against the baseline
+                std::string verdict = "new";
+                std::map<std::string, BenchResult>::iterator expected = baseline.results.find(key);
+                if (expected != baseline.results.end())
+                    { // have baseline
+                    double allowed = std::max(expected->second.milliseconds * (1.0 + baseline.tolerance),
+                                              expected->second.milliseconds + baseline.minimumMilliseconds);
+                    if (result.checksum != expected->second.checksum)
+                        { // wrong image
+                        verdict = "IMAGE CHANGED (expected " + expected->second.checksum + ", got " + result.checksum + ")";
+                        failures++;
+                        } // wrong image
+                    else if (result.milliseconds > allowed)
+                        { // too slow
+                        std::ostringstream slow;
+                        slow << "SLOWER (baseline " << std::fixed << std::setprecision(2) << expected->second.milliseconds << " ms)";
+                        verdict = slow.str();
+                        failures++;
+                        } // too slow
+                    else
+                        { // fine
+                        std::ostringstream fine;
+                        fine << "ok (" << std::showpos << std::fixed << std::setprecision(1)
+                             << 100.0 * (result.milliseconds / std::max(expected->second.milliseconds, 1e-6) - 1.0) << "%)";
+                        verdict = fine.str();
+                        } // fine
+                    } // have baseline
+
+                std::ostringstream sizeName;
+                sizeName << benchSizes[size][0] << "x" << benchSizes[size][1];
+                std::cout << std::left << std::setw(32) << models[model] << std::setw(9) << sizeName.str() << std::setw(10) << features.name
+                          << std::right << std::fixed << std::setprecision(2) << std::setw(12) << bestMilliseconds
+                          << std::setw(10) << (bestMilliseconds > 0.0 ? rays / (bestMilliseconds * 1000.0) : 0.0)
+                          << std::setw(12) << PeakRSSKilobytes() << "  " << verdict << std::endl;
+                } // per frame
+        } // per model
+
+    std::cout << "Total " << std::fixed << std::setprecision(1) << totalMilliseconds << " ms, "
+              << std::setprecision(2) << (totalMilliseconds > 0.0 ? totalRays / (totalMilliseconds * 1000.0) : 0.0) << " Mrays/s, "
+              << "peak " << PeakRSSKilobytes() << " KB" << std::endl;
+
+    if (!writeBaselineName.empty())
+        { // write baseline
+        WriteBaseline(writeBaselineName, measured);
+        std::cout << "Wrote baseline to " << writeBaselineName << std::endl;
+        } // write baseline
+
+    if (failures > 0)
+        { // failed
+        std::cout << failures << " frame(s) failed" << std::endl;
+        return 1;
+        } // failed
+    return 0;
+    } // main()
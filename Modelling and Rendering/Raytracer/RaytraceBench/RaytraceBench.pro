@@ -0,0 +1,33 @@
+######################################################################
+# Benchmark for the raytracer over the models in ../objects
+######################################################################
+
+# TexturedObject also draws through OpenGL, so we still link against it
+QT+=opengl
+CONFIG+=c++11 console release
+CONFIG-=app_bundle
+TEMPLATE = app
+TARGET = RaytraceBench
+INCLUDEPATH += . ../RaytraceRenderWindow
+
+# Input
+HEADERS += ../RaytraceRenderWindow/Cartesian3.h \
+           ../RaytraceRenderWindow/FRGBAValue.h \
+           ../RaytraceRenderWindow/Homogeneous4.h \
+           ../RaytraceRenderWindow/Matrix4.h \
+           ../RaytraceRenderWindow/Quaternion.h \
+           ../RaytraceRenderWindow/Raytracer.h \
+           ../RaytraceRenderWindow/RenderParameters.h \
+           ../RaytraceRenderWindow/RGBAImage.h \
+           ../RaytraceRenderWindow/RGBAValue.h \
+           ../RaytraceRenderWindow/TexturedObject.h
+SOURCES += RaytraceBench.cpp \
+           ../RaytraceRenderWindow/Cartesian3.cpp \
+           ../RaytraceRenderWindow/FRGBAValue.cpp \
+           ../RaytraceRenderWindow/Homogeneous4.cpp \
+           ../RaytraceRenderWindow/Matrix4.cpp \
+           ../RaytraceRenderWindow/Quaternion.cpp \
+           ../RaytraceRenderWindow/RayTracer.cpp \
+           ../RaytraceRenderWindow/RGBAImage.cpp \
+           ../RaytraceRenderWindow/RGBAValue.cpp \
+           ../RaytraceRenderWindow/TexturedObject.cpp
@@ -27,6 +27,8 @@ ArcBall::ArcBall()
     currentRotation = Quaternion(0, 0, 0, 1);
     // set dragLast to something predictable
     dragFrom = Quaternion(0, 0, 1, 0);
+    // and the combined rotation to match
+    UpdateRotation();
     } // constructor
 
 // convert an (x,y) point to a quaternion
@@ -62,6 +64,7 @@ void ArcBall::ContinueDrag(float x, float y)
     Quaternion fromInverse = dragFrom.Inverse();
     // use it to compute the current rotation
     currentRotation = nextQuat * fromInverse;
+    UpdateRotation();
     } // ContinueDrag()
     
 // stop dragging
@@ -79,11 +82,20 @@ void ArcBall::EndDrag(float x, float y)
     // and reset current and base
     baseRotation = currentRotation * baseRotation;
     currentRotation = Quaternion(0, 0, 0, 1);
-
+    UpdateRotation();
     } // EndDrag()
-    
+
+// works out the combined rotation again
+void ArcBall::UpdateRotation()
+    { // UpdateRotation()
+    // one product of quaternions & one matrix, rather than two matrices & their product
+    rotation = currentRotation * baseRotation;
+    rotationMatrix = rotation.GetMatrix();
+    rotationColumns = rotationMatrix.columnMajor();
+    } // UpdateRotation()
+
 // extract the rotation matrix for rendering purposes
-Matrix4 ArcBall::GetRotation()
+const Matrix4 &ArcBall::GetRotation() const
     { // GetRotation()
-    return currentRotation.GetMatrix() * baseRotation.GetMatrix();
+    return rotationMatrix;
     } // GetRotation()
@@ -9,15 +9,20 @@
 //  ------------------------
 //  Cartesian3.h
 //  ------------------------
-//  
+//
 //  A minimal class for a point in Cartesian space
-//  
+//
+//  Everything but the stream I/O is defined inline here, so that the
+//  compiler can fold it into the loops that use it, and what can be is
+//  constexpr, so constant points cost nothing at run time
+//
 ///////////////////////////////////////////////////
 
 #ifndef CARTESIAN3_H
 #define CARTESIAN3_H
 
 #include <iostream>
+#include "math.h"
 
 // the class - we will rely on POD for sending to GPU
 class Cartesian3
@@ -27,37 +32,39 @@ class Cartesian3
     float x, y, z;
 
     // constructors
-    Cartesian3();
-    Cartesian3(float X, float Y, float Z);
-    Cartesian3(const Cartesian3 &other);
-    
+    constexpr Cartesian3();
+    constexpr Cartesian3(float X, float Y, float Z);
+    // a plain copy, so arrays of points can be copied as blocks of memory
+    Cartesian3(const Cartesian3 &other) = default;
+    Cartesian3 &operator =(const Cartesian3 &other) = default;
+
     // equality operator
-    bool operator ==(const Cartesian3 &other) const;
+    constexpr bool operator ==(const Cartesian3 &other) const;
 
     // addition operator
-    Cartesian3 operator +(const Cartesian3 &other) const;
+    constexpr Cartesian3 operator +(const Cartesian3 &other) const;
 
     // subtraction operator
-    Cartesian3 operator -(const Cartesian3 &other) const;
-    
+    constexpr Cartesian3 operator -(const Cartesian3 &other) const;
+
     // multiplication operator
-    Cartesian3 operator *(float factor) const;
+    constexpr Cartesian3 operator *(float factor) const;
 
     // division operator
-    Cartesian3 operator /(float factor) const;
+    constexpr Cartesian3 operator /(float factor) const;
 
     // dot product routine
-    float dot(const Cartesian3 &other) const;
+    constexpr float dot(const Cartesian3 &other) const;
 
     // cross product routine
-    Cartesian3 cross(const Cartesian3 &other) const;
-    
+    constexpr Cartesian3 cross(const Cartesian3 &other) const;
+
     // routine to find the length
     float length() const;
-    
+
     // normalisation routine
     Cartesian3 unit() const;
-    
+
     // operator that allows us to use array indexing instead of variable names
     float &operator [] (const int index);
     const float &operator [] (const int index) const;
@@ -65,12 +72,117 @@ class Cartesian3
     }; // Cartesian3
 
 // multiplication operator
-Cartesian3 operator *(float factor, const Cartesian3 &right);
+constexpr Cartesian3 operator *(float factor, const Cartesian3 &right);
 
 // stream input
 std::istream & operator >> (std::istream &inStream, Cartesian3 &value);
 
 // stream output
 std::ostream & operator << (std::ostream &outStream, const Cartesian3 &value);
-        
-#endif
\ No newline at end of file
+
+// constructors
+constexpr Cartesian3::Cartesian3()
+    : x(0.0), y(0.0), z(0.0)
+    {}
+
+constexpr Cartesian3::Cartesian3(float X, float Y, float Z)
+    : x(X), y(Y), z(Z)
+    {}
+
+// equality operator
+constexpr bool Cartesian3::operator ==(const Cartesian3 &other) const
+    { // Cartesian3::operator ==()
+    return ((x == other.x) && (y == other.y) && (z == other.z));
+    } // Cartesian3::operator ==()
+
+// addition operator
+constexpr Cartesian3 Cartesian3::operator +(const Cartesian3 &other) const
+    { // Cartesian3::operator +()
+    return Cartesian3(x + other.x, y + other.y, z + other.z);
+    } // Cartesian3::operator +()
+
+// subtraction operator
+constexpr Cartesian3 Cartesian3::operator -(const Cartesian3 &other) const
+    { // Cartesian3::operator -()
+    return Cartesian3(x - other.x, y - other.y, z - other.z);
+    } // Cartesian3::operator -()
+
+// multiplication operator
+constexpr Cartesian3 Cartesian3::operator *(float factor) const
+    { // Cartesian3::operator *()
+    return Cartesian3(x * factor, y * factor, z * factor);
+    } // Cartesian3::operator *()
+
+// division operator
+constexpr Cartesian3 Cartesian3::operator /(float factor) const
+    { // Cartesian3::operator /()
+    return Cartesian3(x / factor, y / factor, z / factor);
+    } // Cartesian3::operator /()
+
+// dot product routine
+constexpr float Cartesian3::dot(const Cartesian3 &other) const
+    { // Cartesian3::dot()
+    return x * other.x + y * other.y + z * other.z;
+    } // Cartesian3::dot()
+
+// cross product routine
+constexpr Cartesian3 Cartesian3::cross(const Cartesian3 &other) const
+    { // Cartesian3::cross()
+    return Cartesian3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    } // Cartesian3::cross()
+
+// routine to find the length
+inline float Cartesian3::length() const
+    { // Cartesian3::length()
+    return sqrt(x*x + y*y + z*z);
+    } // Cartesian3::length()
+
+// normalisation routine
+inline Cartesian3 Cartesian3::unit() const
+    { // Cartesian3::unit()
+    float length = sqrt(x*x+y*y+z*z);
+    return Cartesian3(x/length, y/length, z/length);
+    } // Cartesian3::unit()
+
+// operator that allows us to use array indexing instead of variable names
+inline float &Cartesian3::operator [] (const int index)
+    { // operator []
+    // use default to catch out of range indices
+    // we could throw an exception, but will just return the 0th element instead
+    switch (index)
+        { // switch on index
+        case 1:
+            return y;
+        case 2:
+            return z;
+        // 0, and actually the error case
+        default:
+            return x;
+        } // switch on index
+    } // operator []
+
+// operator that allows us to use array indexing instead of variable names
+inline const float &Cartesian3::operator [] (const int index) const
+    { // operator []
+    // use default to catch out of range indices
+    // we could throw an exception, but will just return the 0th element instead
+    switch (index)
+        { // switch on index
+        case 1:
+            return y;
+        case 2:
+            return z;
+        // 0, and actually the error case
+        default:
+            return x;
+        } // switch on index
+    } // operator []
+
+// multiplication operator
+constexpr Cartesian3 operator *(float factor, const Cartesian3 &right)
+    { // operator *
+    // scalar multiplication is commutative, so flip & return
+    return right * factor;
+    } // operator *
+
+#endif
@@ -0,0 +1,591 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  Distributed Render
+//  -----------------------------
+//
+//  Splits a single frame into tiles and traces them on worker
+//  processes over TCP.  The coordinator sends each worker the scene
+//  once (see Raytracer::SaveScene()), then streams tile jobs and
+//  collects the traced pixels.  Tiles held by a worker that drops
+//  out or stops responding are handed to the others.
+//
+//  A worker traces each tile inside its socket handler, so it can't
+//  answer anything until the tile is done.  Instead it writes a
+//  progress message straight to the socket every so often while it
+//  traces, which is what keeps the coordinator from giving up on it.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+#include <QDataStream>
+
+// include the header file
+#include "DistributedRender.h"
+
+//-------------------------------------------------//
+//                                                 //
+// MESSAGE FRAMING                                 //
+//                                                 //
+//-------------------------------------------------//
+
+// writes one framed message to the socket
+void SendTileMessage(QTcpSocket *socket, const QByteArray &message)
+    { // SendTileMessage()
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    headerStream << quint32(message.size());
+
+    socket->write(header);
+    socket->write(message);
+    } // SendTileMessage()
+
+// removes one complete message from the front of the buffer
+bool TakeTileMessage(QByteArray &buffer, QByteArray &message)
+    { // TakeTileMessage()
+    if (buffer.size() < 4)
+        return false;
+
+    quint32 size;
+    QDataStream headerStream(buffer);
+    headerStream >> size;
+
+    // the rest of it hasn't arrived yet
+    if (quint32(buffer.size()) - 4 < size)
+        return false;
+
+    message = buffer.mid(4, size);
+    buffer.remove(0, 4 + size);
+    return true;
+    } // TakeTileMessage()
+
+// true if the message at the front of the buffer is bigger than TILE_MAX_MESSAGE_SIZE
+bool TileMessageTooLarge(const QByteArray &buffer)
+    { // TileMessageTooLarge()
+    if (buffer.size() < 4)
+        return false;
+
+    quint32 size;
+    QDataStream headerStream(buffer);
+    headerStream >> size;
+    return size > TILE_MAX_MESSAGE_SIZE;
+    } // TileMessageTooLarge()
+
+//-------------------------------------------------//
+//                                                 //
+// WORKER                                          //
+//                                                 //
+//-------------------------------------------------//
+
+// destructor
+TileWorkerServer::~TileWorkerServer()
+    { // destructor
+    for (std::map<QTcpSocket *, Connection *>::iterator i = connections.begin(); i != connections.end(); i++)
+        delete i->second;
+    } // destructor
+
+// starts listening, returns false if the port can't be used
+bool TileWorkerServer::Listen(quint16 port)
+    { // TileWorkerServer::Listen()
+    connect(&server, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+    return server.listen(QHostAddress::Any, port);
+    } // TileWorkerServer::Listen()
+
+void TileWorkerServer::NewConnection()
+    { // TileWorkerServer::NewConnection()
+    while (server.hasPendingConnections())
+        { // per connection
+        QTcpSocket *socket = server.nextPendingConnection();
+        // each coordinator gets its own raytracer, as it has its own scene
+        connections[socket] = new Connection;
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(ReadyRead()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(Disconnected()));
+
+        std::cout << "Coordinator connected from " << socket->peerAddress().toString().toStdString() << std::endl;
+        } // per connection
+    } // TileWorkerServer::NewConnection()
+
+// tells the coordinator why, then hangs up on it
+void TileWorkerServer::Refuse(QTcpSocket *socket, const QString &reason)
+    { // TileWorkerServer::Refuse()
+    std::cout << reason.toStdString() << ", dropping the coordinator" << std::endl;
+
+    QByteArray message;
+    QDataStream outStream(&message, QIODevice::WriteOnly);
+    outStream << TILE_MESSAGE_ERROR << reason;
+    SendTileMessage(socket, message);
+
+    // unlike abort(), this lets the reason go out first
+    socket->disconnectFromHost();
+    } // TileWorkerServer::Refuse()
+
+void TileWorkerServer::ReadyRead()
+    { // TileWorkerServer::ReadyRead()
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    std::map<QTcpSocket *, Connection *>::iterator found = connections.find(socket);
+    if (found == connections.end())
+        return;
+    Connection *connection = found->second;
+
+    // anything after we have refused it is thrown away
+    if (socket->state() != QAbstractSocket::ConnectedState)
+        { // hanging up
+        socket->readAll();
+        return;
+        } // hanging up
+
+    connection->buffer.append(socket->readAll());
+
+    QByteArray message;
+    while (TakeTileMessage(connection->buffer, message))
+        { // per message
+        QDataStream inStream(message);
+        quint8 type;
+        inStream >> type;
+
+        if (type == TILE_MESSAGE_SCENE)
+            { // scene
+            QByteArray sceneBytes;
+            inStream >> sceneBytes;
+            std::istringstream sceneStream(std::string(sceneBytes.constData(), sceneBytes.size()));
+            connection->hasScene = connection->raytracer.LoadScene(sceneStream);
+
+            if (!connection->hasScene)
+                { // bad scene
+                Refuse(socket, "Unreadable scene");
+                return;
+                } // bad scene
+
+            std::cout << "Received scene: " << connection->raytracer.triangleVect.size() << " triangles, "
+                      << connection->raytracer.frameBuffer.width << "x" << connection->raytracer.frameBuffer.height << std::endl;
+
+            // the coordinator's stall clock starts now, so tell it straight away
+            QByteArray ready;
+            QDataStream readyStream(&ready, QIODevice::WriteOnly);
+            readyStream << TILE_MESSAGE_READY;
+            SendTileMessage(socket, ready);
+            socket->flush();
+            } // scene
+        else if (type == TILE_MESSAGE_TILE && connection->hasScene)
+            { // tile
+            RenderTile tile;
+            inStream >> tile.id >> tile.x0 >> tile.y0 >> tile.x1 >> tile.y1;
+
+            Raytracer &raytracer = connection->raytracer;
+            if (inStream.status() != QDataStream::Ok ||
+                tile.x0 < 0 || tile.y0 < 0 || tile.x1 > raytracer.frameBuffer.width || tile.y1 > raytracer.frameBuffer.height ||
+                tile.x0 >= tile.x1 || tile.y0 >= tile.y1)
+                { // bad tile
+                Refuse(socket, "Bad tile");
+                return;
+                } // bad tile
+
+            // the event loop is held up until the tile is done, so progress is written out directly
+            raytracer.passInterval = TILE_PROGRESS_MILLISECONDS;
+            raytracer.passComplete = [socket, &tile]()
+                { // progress
+                QByteArray progress;
+                QDataStream progressStream(&progress, QIODevice::WriteOnly);
+                progressStream << TILE_MESSAGE_PROGRESS << tile.id;
+                SendTileMessage(socket, progress);
+                socket->flush();
+                }; // progress
+
+            QElapsedTimer traceTimer;
+            traceTimer.start();
+            raytracer.drawTile(tile.x0, tile.y0, tile.x1, tile.y1);
+            qint64 traceMicroseconds = traceTimer.nsecsElapsed() / 1000;
+            raytracer.passComplete = nullptr;
+
+            // send the pixels back a row at a time
+            QByteArray reply;
+            QDataStream outStream(&reply, QIODevice::WriteOnly);
+            outStream << TILE_MESSAGE_RESULT << tile.id << tile.x0 << tile.y0 << tile.x1 << tile.y1 << traceMicroseconds;
+            for (qint32 y = tile.y0; y < tile.y1; y++)
+                outStream.writeRawData((const char *) &(raytracer.frameBuffer[y][tile.x0]), (tile.x1 - tile.x0) * sizeof(RGBAValue));
+
+            SendTileMessage(socket, reply);
+            } // tile
+        else
+            { // bad message
+            Refuse(socket, "Unexpected message");
+            return;
+            } // bad message
+        } // per message
+
+    // rather than buffering whatever size the header claims
+    if (TileMessageTooLarge(connection->buffer))
+        Refuse(socket, "Message too large");
+    } // TileWorkerServer::ReadyRead()
+
+void TileWorkerServer::Disconnected()
+    { // TileWorkerServer::Disconnected()
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    std::map<QTcpSocket *, Connection *>::iterator found = connections.find(socket);
+    if (found == connections.end())
+        return;
+
+    delete found->second;
+    connections.erase(found);
+    // we may be inside one of the socket's own signals, so let Qt delete it later
+    socket->deleteLater();
+
+    std::cout << "Coordinator disconnected" << std::endl;
+    } // TileWorkerServer::Disconnected()
+
+//-------------------------------------------------//
+//                                                 //
+// COORDINATOR                                     //
+//                                                 //
+//-------------------------------------------------//
+
+// constructor
+TileCoordinator::TileCoordinator(Raytracer *newRaytracer)
+    :
+    raytracer(newRaytracer),
+    tilesRemaining(0),
+    tilesPerWorker(2),
+    stallMilliseconds(60000)
+    { // constructor
+    connect(&stallTimer, SIGNAL(timeout()), this, SLOT(CheckStalls()));
+    } // constructor
+
+// destructor
+TileCoordinator::~TileCoordinator()
+    { // destructor
+    for (size_t i = 0; i < workers.size(); i++)
+        { // per worker
+        // stop the socket telling us about its own destruction
+        disconnect(workers[i]->socket, 0, this, 0);
+        delete workers[i]->socket;
+        delete workers[i];
+        } // per worker
+    } // destructor
+
+// adds a worker to connect to when Render() is called
+void TileCoordinator::AddWorker(const QString &host, quint16 port)
+    { // TileCoordinator::AddWorker()
+    WorkerLink *worker = new WorkerLink;
+    worker->host = host;
+    worker->port = port;
+    worker->socket = new QTcpSocket;
+    worker->alive = false;
+    worker->sceneLoaded = false;
+    worker->tilesDone = 0;
+    worker->pixelsDone = 0;
+    worker->traceMicroseconds = 0;
+    worker->connectedMilliseconds = 0;
+
+    connect(worker->socket, SIGNAL(connected()), this, SLOT(Connected()));
+    connect(worker->socket, SIGNAL(readyRead()), this, SLOT(ReadyRead()));
+    connect(worker->socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), this, SLOT(StateChanged(QAbstractSocket::SocketState)));
+
+    workers.push_back(worker);
+    } // TileCoordinator::AddWorker()
+
+// traces the frame into the raytracer's frame buffer, blocking until done
+bool TileCoordinator::Render(int tileSize)
+    { // TileCoordinator::Render()
+    // the scene is sent once per worker, so serialise it up front
+    std::ostringstream sceneStream;
+    raytracer->SaveScene(sceneStream);
+    std::string sceneString = sceneStream.str();
+
+    scene.clear();
+    QDataStream sceneMessage(&scene, QIODevice::WriteOnly);
+    sceneMessage << TILE_MESSAGE_SCENE << QByteArray(sceneString.data(), sceneString.size());
+
+    if (quint32(scene.size()) > TILE_MAX_MESSAGE_SIZE)
+        { // too big
+        std::cout << "Scene is " << scene.size() << " bytes, more than a worker will take" << std::endl;
+        return false;
+        } // too big
+
+    // cut the frame into tiles
+    pendingTiles.clear();
+    qint32 nTiles = 0;
+    for (qint32 y = 0; y < raytracer->frameBuffer.height; y += tileSize)
+        for (qint32 x = 0; x < raytracer->frameBuffer.width; x += tileSize)
+            { // per tile
+            RenderTile tile;
+            tile.id = nTiles++;
+            tile.x0 = x;
+            tile.y0 = y;
+            tile.x1 = std::min(x + tileSize, (qint32) raytracer->frameBuffer.width);
+            tile.y1 = std::min(y + tileSize, (qint32) raytracer->frameBuffer.height);
+            pendingTiles.push_back(tile);
+            } // per tile
+    tileDone.assign(nTiles, false);
+    tilesRemaining = nTiles;
+
+    if (tilesRemaining == 0)
+        return true;
+    if (workers.empty())
+        return false;
+
+    // the work is handed out as each worker connects
+    for (size_t i = 0; i < workers.size(); i++)
+        { // per worker
+        workers[i]->alive = true;
+        workers[i]->sceneLoaded = false;
+        workers[i]->lastHeard.start();
+        workers[i]->socket->connectToHost(workers[i]->host, workers[i]->port);
+        } // per worker
+
+    stallTimer.start(1000);
+    int result = eventLoop.exec();
+    stallTimer.stop();
+
+    // hang up on the workers that are still with us
+    for (size_t i = 0; i < workers.size(); i++)
+        if (workers[i]->alive)
+            { // still alive
+            if (workers[i]->connectedTime.isValid())
+                workers[i]->connectedMilliseconds = workers[i]->connectedTime.elapsed();
+            workers[i]->alive = false;
+            workers[i]->socket->disconnectFromHost();
+            } // still alive
+
+    return result == 0 && tilesRemaining == 0;
+    } // TileCoordinator::Render()
+
+// prints tiles, pixels & rates for each worker
+void TileCoordinator::ReportThroughput(std::ostream &outStream)
+    { // TileCoordinator::ReportThroughput()
+    long totalPixels = raytracer->frameBuffer.width * raytracer->frameBuffer.height;
+
+    for (size_t i = 0; i < workers.size(); i++)
+        { // per worker
+        WorkerLink *worker = workers[i];
+        outStream << worker->host.toStdString() << ":" << worker->port << "  "
+                  << worker->tilesDone << " tiles, "
+                  << (totalPixels > 0 ? 100.0 * worker->pixelsDone / totalPixels : 0.0) << "% of frame";
+
+        // the trace rate is what the machine can do, the connected rate includes the network
+        if (worker->traceMicroseconds > 0)
+            outStream << ", trace " << worker->pixelsDone / (double) worker->traceMicroseconds << " Mpixel/s";
+        if (worker->connectedMilliseconds > 0)
+            outStream << ", effective " << worker->pixelsDone / (1000.0 * worker->connectedMilliseconds) << " Mpixel/s";
+        if (worker->connectedMilliseconds == 0 && worker->tilesDone == 0)
+            outStream << ", never connected";
+        outStream << std::endl;
+        } // per worker
+    } // TileCoordinator::ReportThroughput()
+
+TileCoordinator::WorkerLink *TileCoordinator::LinkFor(QObject *socket)
+    { // TileCoordinator::LinkFor()
+    for (size_t i = 0; i < workers.size(); i++)
+        if (workers[i]->socket == socket)
+            return workers[i];
+    return NULL;
+    } // TileCoordinator::LinkFor()
+
+// tops up the worker's queue of tiles
+void TileCoordinator::IssueTiles(WorkerLink *worker)
+    { // TileCoordinator::IssueTiles()
+    if (!worker->alive || worker->socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    // the stall clock runs from when it was given something to do
+    if (worker->inFlight.empty())
+        worker->lastHeard.restart();
+
+    while (worker->inFlight.size() < tilesPerWorker && !pendingTiles.empty())
+        { // per tile
+        RenderTile tile = pendingTiles.front();
+        pendingTiles.pop_front();
+        // a tile re-issued after a loss may since have come back from its first worker
+        if (tileDone[tile.id])
+            continue;
+
+        QByteArray message;
+        QDataStream outStream(&message, QIODevice::WriteOnly);
+        outStream << TILE_MESSAGE_TILE << tile.id << tile.x0 << tile.y0 << tile.x1 << tile.y1;
+        SendTileMessage(worker->socket, message);
+
+        worker->inFlight.push_back(tile);
+        } // per tile
+    } // TileCoordinator::IssueTiles()
+
+// puts a lost worker's tiles back on the queue for the others
+void TileCoordinator::LoseWorker(WorkerLink *worker)
+    { // TileCoordinator::LoseWorker()
+    if (worker == NULL || !worker->alive)
+        return;
+    worker->alive = false;
+    if (worker->connectedTime.isValid())
+        worker->connectedMilliseconds = worker->connectedTime.elapsed();
+
+    // nothing left to re-issue once the frame is finished
+    if (tilesRemaining == 0)
+        return;
+
+    std::cout << "Lost worker " << worker->host.toStdString() << ":" << worker->port
+              << ", re-issuing " << worker->inFlight.size() << " tiles" << std::endl;
+
+    // to the front, so that the frame doesn't wait on them at the end
+    for (size_t i = 0; i < worker->inFlight.size(); i++)
+        pendingTiles.push_front(worker->inFlight[i]);
+    worker->inFlight.clear();
+
+    bool anyAlive = false;
+    for (size_t i = 0; i < workers.size(); i++)
+        if (workers[i]->alive)
+            { // survivor
+            anyAlive = true;
+            IssueTiles(workers[i]);
+            } // survivor
+
+    if (!anyAlive)
+        { // everyone lost
+        std::cout << "No workers left, " << tilesRemaining << " tiles were not traced" << std::endl;
+        eventLoop.exit(1);
+        } // everyone lost
+    } // TileCoordinator::LoseWorker()
+
+// copies a returned tile into the frame buffer
+void TileCoordinator::ReceiveResult(WorkerLink *worker, const QByteArray &message)
+    { // TileCoordinator::ReceiveResult()
+    QDataStream inStream(message);
+    quint8 type;
+    RenderTile tile;
+    qint64 traceMicroseconds;
+    inStream >> type >> tile.id >> tile.x0 >> tile.y0 >> tile.x1 >> tile.y1 >> traceMicroseconds;
+
+    // it must be a tile we actually gave this worker
+    std::vector<RenderTile>::iterator sent = worker->inFlight.begin();
+    while (sent != worker->inFlight.end() && sent->id != tile.id)
+        sent++;
+    if (inStream.status() != QDataStream::Ok || sent == worker->inFlight.end() ||
+        sent->x0 != tile.x0 || sent->y0 != tile.y0 || sent->x1 != tile.x1 || sent->y1 != tile.y1)
+        { // bad result
+        std::cout << "Bad result from " << worker->host.toStdString() << ":" << worker->port << std::endl;
+        worker->socket->abort();
+        return;
+        } // bad result
+    worker->inFlight.erase(sent);
+    worker->lastHeard.restart();
+
+    int rowBytes = (tile.x1 - tile.x0) * sizeof(RGBAValue);
+    for (qint32 y = tile.y0; y < tile.y1; y++)
+        if (inStream.readRawData((char *) &(raytracer->frameBuffer[y][tile.x0]), rowBytes) != rowBytes)
+            { // short result
+            std::cout << "Short result from " << worker->host.toStdString() << ":" << worker->port << std::endl;
+            worker->inFlight.push_back(tile);
+            worker->socket->abort();
+            return;
+            } // short result
+
+    worker->tilesDone++;
+    worker->pixelsDone += (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    worker->traceMicroseconds += traceMicroseconds;
+
+    if (!tileDone[tile.id])
+        { // first copy
+        tileDone[tile.id] = true;
+        tilesRemaining--;
+        } // first copy
+
+    if (tilesRemaining == 0)
+        eventLoop.exit(0);
+    else
+        IssueTiles(worker);
+    } // TileCoordinator::ReceiveResult()
+
+void TileCoordinator::Connected()
+    { // TileCoordinator::Connected()
+    WorkerLink *worker = LinkFor(sender());
+    if (worker == NULL || !worker->alive)
+        return;
+
+    std::cout << "Connected to worker " << worker->host.toStdString() << ":" << worker->port << std::endl;
+    worker->connectedTime.start();
+
+    // the scene goes first, then as many tiles as it may hold
+    SendTileMessage(worker->socket, scene);
+    IssueTiles(worker);
+    } // TileCoordinator::Connected()
+
+void TileCoordinator::ReadyRead()
+    { // TileCoordinator::ReadyRead()
+    WorkerLink *worker = LinkFor(sender());
+    if (worker == NULL || !worker->alive)
+        return;
+
+    worker->buffer.append(worker->socket->readAll());
+
+    QByteArray message;
+    while (worker->alive && TakeTileMessage(worker->buffer, message))
+        { // per message
+        if (message.size() > 0 && quint8(message[0]) == TILE_MESSAGE_RESULT)
+            ReceiveResult(worker, message);
+        else if (message.size() > 0 && quint8(message[0]) == TILE_MESSAGE_READY)
+            { // scene loaded
+            worker->sceneLoaded = true;
+            worker->lastHeard.restart();
+            } // scene loaded
+        else if (message.size() > 0 && quint8(message[0]) == TILE_MESSAGE_PROGRESS)
+            { // progress
+            // part way through a tile, so still alive
+            worker->lastHeard.restart();
+            } // progress
+        else if (message.size() > 0 && quint8(message[0]) == TILE_MESSAGE_ERROR)
+            { // refused
+            QDataStream inStream(message);
+            quint8 type;
+            QString reason;
+            inStream >> type >> reason;
+            std::cout << "Worker " << worker->host.toStdString() << ":" << worker->port << " refused us: " << reason.toStdString() << std::endl;
+            worker->socket->abort();
+            } // refused
+        else
+            { // bad message
+            std::cout << "Unexpected message from " << worker->host.toStdString() << ":" << worker->port << std::endl;
+            worker->socket->abort();
+            } // bad message
+        } // per message
+
+    if (worker->alive && TileMessageTooLarge(worker->buffer))
+        { // too big
+        std::cout << "Oversized message from " << worker->host.toStdString() << ":" << worker->port << std::endl;
+        worker->socket->abort();
+        } // too big
+    } // TileCoordinator::ReadyRead()
+
+void TileCoordinator::StateChanged(QAbstractSocket::SocketState state)
+    { // TileCoordinator::StateChanged()
+    // refused connections, dropped connections & our own aborts all end up here
+    if (state == QAbstractSocket::UnconnectedState)
+        LoseWorker(LinkFor(sender()));
+    } // TileCoordinator::StateChanged()
+
+// treats any worker that has gone quiet as lost
+void TileCoordinator::CheckStalls()
+    { // TileCoordinator::CheckStalls()
+    for (size_t i = 0; i < workers.size(); i++)
+        { // per worker
+        WorkerLink *worker = workers[i];
+        if (!worker->alive || worker->lastHeard.elapsed() < stallMilliseconds)
+            continue;
+
+        // either it never finished connecting, or it has the scene & is sitting on tiles -
+        // sending & loading a big scene takes as long as it takes, and a dropped
+        // connection is noticed by StateChanged() anyway
+        bool connected = worker->socket->state() == QAbstractSocket::ConnectedState;
+        if (!connected || (worker->sceneLoaded && !worker->inFlight.empty()))
+            { // stalled
+            std::cout << "Worker " << worker->host.toStdString() << ":" << worker->port << " stopped responding" << std::endl;
+            worker->socket->abort();
+            } // stalled
+        } // per worker
+    } // TileCoordinator::CheckStalls()
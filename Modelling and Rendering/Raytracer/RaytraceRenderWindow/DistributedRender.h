@@ -0,0 +1,192 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  Distributed Render
+//  -----------------------------
+//
+//  Splits a single frame into tiles and traces them on worker
+//  processes over TCP.  The coordinator sends each worker the scene
+//  once (see Raytracer::SaveScene()), then streams tile jobs and
+//  collects the traced pixels.  Tiles held by a worker that drops
+//  out or stops responding are handed to the others.
+//
+//  Every message is a 32-bit byte count followed by a QDataStream
+//  payload whose first field is one of the TILE_MESSAGE constants.
+//  Neither end will buffer one bigger than TILE_MAX_MESSAGE_SIZE.
+//
+////////////////////////////////////////////////////////////////////////
+
+// include guard
+#ifndef _DISTRIBUTED_RENDER_H
+#define _DISTRIBUTED_RENDER_H
+
+// include the relevant QT headers
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <map>
+
+// and include all of our own headers that we need
+#include "Raytracer.h"
+
+// message types
+const quint8 TILE_MESSAGE_SCENE = 1;    // coordinator -> worker: the scene to trace
+const quint8 TILE_MESSAGE_TILE = 2;     // coordinator -> worker: a tile to trace
+const quint8 TILE_MESSAGE_RESULT = 3;   // worker -> coordinator: the traced pixels
+const quint8 TILE_MESSAGE_ERROR = 4;    // worker -> coordinator: why it is hanging up
+const quint8 TILE_MESSAGE_READY = 5;    // worker -> coordinator: the scene is loaded
+const quint8 TILE_MESSAGE_PROGRESS = 6; // worker -> coordinator: still tracing a tile
+
+// how often a worker part way through a tile says it is still alive
+const unsigned int TILE_PROGRESS_MILLISECONDS = 1000;
+
+// the largest message either end will buffer: room for a full size texture & frame
+// and a few hundred thousand triangles - anything bigger ends the connection
+const quint32 TILE_MAX_MESSAGE_SIZE = 256 * 1024 * 1024;
+
+// default port for workers to listen on
+const quint16 TILE_DEFAULT_PORT = 5812;
+
+// a rectangle of the frame, [x0,x1) x [y0,y1)
+class RenderTile
+    { // class RenderTile
+    public:
+    qint32 id;
+    qint32 x0, y0, x1, y1;
+    }; // class RenderTile
+
+// writes one framed message to the socket
+void SendTileMessage(QTcpSocket *socket, const QByteArray &message);
+
+// removes one complete message from the front of the buffer, returns false if there isn't one yet
+bool TakeTileMessage(QByteArray &buffer, QByteArray &message);
+
+// true if the message at the front of the buffer is bigger than TILE_MAX_MESSAGE_SIZE
+bool TileMessageTooLarge(const QByteArray &buffer);
+
+// a worker process: listens for coordinators and traces whatever tiles they send
+class TileWorkerServer : public QObject
+    { // class TileWorkerServer
+    Q_OBJECT
+    private:
+    // per coordinator state - each may send a different scene
+    class Connection
+        { // class Connection
+        public:
+        QByteArray buffer;
+        Raytracer raytracer;
+        bool hasScene = false;
+        }; // class Connection
+
+    QTcpServer server;
+    std::map<QTcpSocket *, Connection *> connections;
+
+    // tells the coordinator why, then hangs up on it
+    void Refuse(QTcpSocket *socket, const QString &reason);
+
+    public:
+    // destructor
+    ~TileWorkerServer();
+
+    // starts listening, returns false if the port can't be used
+    bool Listen(quint16 port);
+
+    private slots:
+    void NewConnection();
+    void ReadyRead();
+    void Disconnected();
+    }; // class TileWorkerServer
+
+// the coordinator: hands out the tiles of one frame and gathers the results
+class TileCoordinator : public QObject
+    { // class TileCoordinator
+    Q_OBJECT
+    public:
+    // what we know about each worker, kept after it is lost for the report
+    class WorkerLink
+        { // class WorkerLink
+        public:
+        QString host;
+        quint16 port;
+        QTcpSocket *socket;
+        QByteArray buffer;
+        // tiles sent but not yet returned
+        std::vector<RenderTile> inFlight;
+        bool alive;
+        // when we last heard from it, for the stall timeout, which only
+        // runs once it has loaded the scene
+        QElapsedTimer lastHeard;
+        bool sceneLoaded;
+        // throughput counters
+        long tilesDone;
+        long pixelsDone;
+        qint64 traceMicroseconds;   // as reported by the worker
+        QElapsedTimer connectedTime;
+        qint64 connectedMilliseconds;
+        }; // class WorkerLink
+
+    private:
+    // the scene, already set up, and whose frame buffer receives the result
+    Raytracer *raytracer;
+    QByteArray scene;
+
+    // tiles not yet handed out, and which tiles are finished
+    std::deque<RenderTile> pendingTiles;
+    std::vector<bool> tileDone;
+    long tilesRemaining;
+
+    std::vector<WorkerLink *> workers;
+    QEventLoop eventLoop;
+    QTimer stallTimer;
+
+    public:
+    // how many tiles each worker may hold at once, so that it never waits on the network
+    unsigned int tilesPerWorker;
+    // a worker holding tiles that sends nothing for this long is treated as lost -
+    // while it traces it reports progress every TILE_PROGRESS_MILLISECONDS
+    int stallMilliseconds;
+
+    // constructor
+    TileCoordinator(Raytracer *newRaytracer);
+
+    // destructor
+    ~TileCoordinator();
+
+    // adds a worker to connect to when Render() is called
+    void AddWorker(const QString &host, quint16 port);
+
+    // traces the frame into the raytracer's frame buffer, blocking until done
+    // returns false if every worker was lost before the frame was complete
+    bool Render(int tileSize);
+
+    // prints tiles, pixels & rates for each worker
+    void ReportThroughput(std::ostream &outStream);
+
+    private:
+    WorkerLink *LinkFor(QObject *socket);
+    void IssueTiles(WorkerLink *worker);
+    void LoseWorker(WorkerLink *worker);
+    void ReceiveResult(WorkerLink *worker, const QByteArray &message);
+
+    private slots:
+    void Connected();
+    void ReadyRead();
+    void StateChanged(QAbstractSocket::SocketState state);
+    void CheckStalls();
+    }; // class TileCoordinator
+
+#endif
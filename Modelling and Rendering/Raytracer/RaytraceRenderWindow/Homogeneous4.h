@@ -9,9 +9,11 @@
 //  ------------------------
 //  Homogeneous4.cpp
 //  ------------------------
-//  
+//
 //  A minimal class for a 3D point in homogeneous coordinates
-//  
+//
+//  As with Cartesian3, everything but the stream I/O is inline
+//
 ///////////////////////////////////////////////////
 
 #ifndef HOMOGENEOUS4_H
@@ -28,28 +30,29 @@ class Homogeneous4
     float x, y, z, w;
 
     // constructors
-    Homogeneous4();
-    Homogeneous4(float X, float Y, float Z, float W = 1.0);
-    Homogeneous4(const Cartesian3 &other);
-    Homogeneous4(const Homogeneous4 &other);
-    
+    constexpr Homogeneous4();
+    constexpr Homogeneous4(float X, float Y, float Z, float W = 1.0);
+    constexpr Homogeneous4(const Cartesian3 &other);
+    Homogeneous4(const Homogeneous4 &other) = default;
+    Homogeneous4 &operator =(const Homogeneous4 &other) = default;
+
     // routine to get a point by perspective division
-    Cartesian3 Point() const;
+    constexpr Cartesian3 Point() const;
 
     // routine to get a vector by dropping w (assumed to be 0)
-    Cartesian3 Vector() const;
+    constexpr Cartesian3 Vector() const;
 
     // addition operator
-    Homogeneous4 operator +(const Homogeneous4 &other) const;
+    constexpr Homogeneous4 operator +(const Homogeneous4 &other) const;
 
     // subtraction operator
-    Homogeneous4 operator -(const Homogeneous4 &other) const;
-    
+    constexpr Homogeneous4 operator -(const Homogeneous4 &other) const;
+
     // multiplication operator
-    Homogeneous4 operator *(float factor) const;
+    constexpr Homogeneous4 operator *(float factor) const;
 
     // division operator
-    Homogeneous4 operator /(float factor) const;
+    constexpr Homogeneous4 operator /(float factor) const;
 
     // operator that allows us to use array indexing instead of variable names
     float &operator [] (const int index);
@@ -58,12 +61,118 @@ class Homogeneous4
     }; // Homogeneous4
 
 // multiplication operator
-Homogeneous4 operator *(float factor, const Homogeneous4 &right);
+constexpr Homogeneous4 operator *(float factor, const Homogeneous4 &right);
 
 // stream input
 std::istream & operator >> (std::istream &inStream, Homogeneous4 &value);
 
 // stream output
 std::ostream & operator << (std::ostream &outStream, const Homogeneous4 &value);
-        
-#endif
\ No newline at end of file
+
+// constructors
+constexpr Homogeneous4::Homogeneous4()
+    :
+    x(0.0),
+    y(0.0),
+    z(0.0),
+    w(0.0)
+    {}
+
+constexpr Homogeneous4::Homogeneous4(float X, float Y, float Z, float W)
+    :
+    x(X),
+    y(Y),
+    z(Z),
+    w(W)
+    {}
+
+constexpr Homogeneous4::Homogeneous4(const Cartesian3 &other)
+    :
+    x(other.x),
+    y(other.y),
+    z(other.z),
+    w(1)
+    {}
+
+// routine to get a point by perspective division
+constexpr Cartesian3 Homogeneous4::Point() const
+    { // Homogeneous4::Point()
+    return Cartesian3(x/w, y/w, z/w);
+    } // Homogeneous4::Point()
+
+// routine to get a vector by dropping w (assumed to be 0)
+constexpr Cartesian3 Homogeneous4::Vector() const
+    { // Homogeneous4::Vector()
+    return Cartesian3(x, y, z);
+    } // Homogeneous4::Vector()
+
+// addition operator
+constexpr Homogeneous4 Homogeneous4::operator +(const Homogeneous4 &other) const
+    { // Homogeneous4::operator +()
+    return Homogeneous4(x + other.x, y + other.y, z + other.z, w + other.w);
+    } // Homogeneous4::operator +()
+
+// subtraction operator
+constexpr Homogeneous4 Homogeneous4::operator -(const Homogeneous4 &other) const
+    { // Homogeneous4::operator -()
+    return Homogeneous4(x - other.x, y - other.y, z - other.z, w - other.w);
+    } // Homogeneous4::operator -()
+
+// multiplication operator
+constexpr Homogeneous4 Homogeneous4::operator *(float factor) const
+    { // Homogeneous4::operator *()
+    return Homogeneous4(x * factor, y * factor, z * factor, w * factor);
+    } // Homogeneous4::operator *()
+
+// division operator
+constexpr Homogeneous4 Homogeneous4::operator /(float factor) const
+    { // Homogeneous4::operator /()
+    return Homogeneous4(x / factor, y / factor, z / factor, w / factor);
+    } // Homogeneous4::operator /()
+
+// operator that allows us to use array indexing instead of variable names
+inline float &Homogeneous4::operator [] (const int index)
+    { // operator []
+    // use default to catch out of range indices
+    // we could throw an exception, but will just return the 0th element instead
+    switch (index)
+        { // switch on index
+        case 1:
+            return y;
+        case 2:
+            return z;
+        case 3:
+            return w;
+        // 0, and actually the error case
+        default:
+            return x;
+        } // switch on index
+    } // operator []
+
+// operator that allows us to use array indexing instead of variable names
+inline const float &Homogeneous4::operator [] (const int index) const
+    { // operator []
+    // use default to catch out of range indices
+    // we could throw an exception, but will just return the 0th element instead
+    switch (index)
+        { // switch on index
+        case 1:
+            return y;
+        case 2:
+            return z;
+        case 3:
+            return w;
+        // 0, and actually the error case
+        default:
+            return x;
+        } // switch on index
+    } // operator []
+
+// multiplication operator
+constexpr Homogeneous4 operator *(float factor, const Homogeneous4 &right)
+    { // operator *
+    // scalar multiplication is commutative, so flip & return
+    return right * factor;
+    } // operator *
+
+#endif
@@ -12,12 +12,16 @@
 //  
 //  A class representing a quaternion
 //  
+//  The arithmetic is inline, after the class: what needs the whole of
+//  Matrix4, and the angle & axis, are out of line in Quaternion.cpp
+//  
 ///////////////////////////////////////////////////
 
 #ifndef __QUATERNION_H__
 #define __QUATERNION_H__ 1
 
 #include <stdio.h>
+#include <math.h>
 #include "Cartesian3.h"
 #include "Homogeneous4.h"
 
@@ -34,19 +38,19 @@ class Quaternion
     Homogeneous4 coords;
 
     // constructor: sets the quaternion to (0, 0, 0, 1)
-    Quaternion();
+    constexpr Quaternion();
 
     // constructor: sets the quaternion to (x, y, z, w)
-    Quaternion(float x, float y, float z, float w);
+    constexpr Quaternion(float x, float y, float z, float w);
 
     // Set to a pure scalar value
-    Quaternion(float scalar);
+    constexpr Quaternion(float scalar);
 
     // Set to a pure vector value
-    Quaternion(const Cartesian3 &vector);
+    constexpr Quaternion(const Cartesian3 &vector);
     
     // Set to a homogeneous point
-    Quaternion(const Homogeneous4 &point);
+    constexpr Quaternion(const Homogeneous4 &point);
     
     // Set to a rotation defined by a rotation matrix
     // WARNING: MATRIX MUST BE A VALID ROTATION MATRIX
@@ -56,7 +60,8 @@ class Quaternion
     Quaternion(const Cartesian3 &axis, float theta);
 
     // Copy another Quaternion & return self
-    Quaternion &operator = (const Quaternion &other);
+    Quaternion(const Quaternion &other) = default;
+    Quaternion &operator = (const Quaternion &other) = default;
     
     // Computes the norm (sum of squares)
     float Norm() const;
@@ -111,6 +116,171 @@ std::istream & operator >> (std::istream &inStream, Quaternion &quat);
 // stream output
 std::ostream & operator << (std::ostream &outStream, const Quaternion &quat);
 
+// constructor
+constexpr Quaternion::Quaternion()
+    : coords(0.0, 0.0, 0.0, 1.0)
+    { // constructor
+    } // constructor
+
+// constructor: sets the quaternion to (x, y, z, w)
+constexpr Quaternion::Quaternion(float x, float y, float z, float w)
+    : coords(x, y, z, w)
+    { // constructor
+    } // constructor
+
+// Set to a pure scalar value
+constexpr Quaternion::Quaternion(float scalar)
+    : coords(0.0, 0.0, 0.0, scalar)
+    { // copy scalar
+    } // copy scalar
+
+// Set to a pure vector value
+constexpr Quaternion::Quaternion(const Cartesian3 &vector)
+    : coords(vector.x, vector.y, vector.z, 0.0)
+    { // copy vector
+    } // copy vector
+
+// Set to a homogeneous point
+constexpr Quaternion::Quaternion(const Homogeneous4 &point)
+    : coords(point)
+    { // copy point
+    } // copy point
+
+// Set to a rotation defined by an axis and angle
+inline Quaternion::Quaternion(const Cartesian3 &axis, float theta)
+    { // Quaternion()
+    // convert the axis to a unit vector and multiply by sin theta
+    // then add cos theta as a scalar
+    (*this) = Quaternion(axis.unit() * sin(theta)) + Quaternion(cos(theta));
+    } // Quaternion()
+
+// Computes the norm (sum of squares)
+inline float Quaternion::Norm() const
+    { // Norm()
+    return (coords[0]*coords[0]+coords[1]*coords[1]+
+        coords[2]*coords[2]+coords[3]*coords[3]);
+    } // Norm()
+    
+// Reduce to unit quaternion
+inline Quaternion Quaternion::Unit() const
+    { // Unit()
+    Quaternion result;
+    // get the square root of the norm
+    float sqrtNorm = sqrt(Norm());
+    // now divide by it
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = coords[i] / sqrtNorm;
+    return result;
+    } // Unit()
+    
+// Conjugate the quaternion
+inline Quaternion Quaternion::Conjugate() const
+    { // Conjugate()
+    Quaternion result;
+    for (int i = 0; i < 3; i++)
+        result.coords[i] = coords[i] * -1;
+    result.coords[3] = coords[3];
+    return result;
+    } // Conjugate()
+    
+// Invert the quaternion
+inline Quaternion Quaternion::Inverse() const
+    { // Invert()
+    Quaternion result = Conjugate() / Norm();
+    return result;
+    } // Invert()
+
+// Scalar left-multiplication
+inline Quaternion operator *(float scalar, const Quaternion &quat)
+    { // scalar left-multiplication
+    Quaternion result;
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = scalar * quat.coords[i];
+    return result;
+    } // scalar left-multiplication
+
+// Scalar right-multiplication
+inline Quaternion Quaternion::operator *(float scalar) const
+    { // scalar right-multiplication
+    Quaternion result;
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = coords[i] * scalar;
+    return result;
+    } // scalar right-multiplication
+    
+// Scalar right-division
+inline Quaternion Quaternion::operator /(float scalar) const
+    { // scalar right-division
+    Quaternion result;
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = coords[i] / scalar;
+    return result;
+    } // scalar right-division
+
+// Adds two quaternions together
+inline Quaternion Quaternion::operator +(const Quaternion &other) const
+    { // addition
+    Quaternion result;
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = coords[i] + other.coords[i];
+    return result;
+    } // addition
+
+// Subtracts one quaternion from another
+inline Quaternion Quaternion::operator -(const Quaternion &other) const
+    { // subtraction
+    Quaternion result;
+    for (int i = 0; i < 4; i++)
+        result.coords[i] = coords[i] - other.coords[i];
+    return result;
+    } // subtraction
+
+// Multiplies two quaternions together
+inline Quaternion Quaternion::operator *(const Quaternion &other) const
+    { // multiplication
+    Quaternion result;
+    // and compute each set of coords   
+    result.coords[0] =  + coords[0] * other.coords[3]  // i 1
+                        + coords[1] * other.coords[2]  // j k
+                        - coords[2] * other.coords[1]  // k j 
+                        + coords[3] * other.coords[0]; // 1 i
+                
+    result.coords[1] =  - coords[0] * other.coords[2]  // i k
+                        + coords[1] * other.coords[3]  // j 1
+                        + coords[2] * other.coords[0]  // k i 
+                        + coords[3] * other.coords[1]; // 1 j
+    
+    result.coords[2] =  + coords[0] * other.coords[1]  // i j
+                        - coords[1] * other.coords[0]  // j i
+                        + coords[2] * other.coords[3]  // k 1 
+                        + coords[3] * other.coords[2]; // 1 k
+
+    result.coords[3] =  - coords[0] * other.coords[0]  // i i
+                        - coords[1] * other.coords[1]  // j j
+                        - coords[2] * other.coords[2]  // k k 
+                        + coords[3] * other.coords[3]; // 1 1
+    return result;
+    } // multiplication
+
+// Acts on a vector
+inline Cartesian3 Quaternion::Act(const Cartesian3 &vector) const
+    { // Act()
+    // compute the result
+    Quaternion resultQuat = Inverse() * Quaternion(vector) * (*this);
+    Cartesian3 resultVector(resultQuat.coords[0], resultQuat.coords[1], 
+        resultQuat.coords[2]);
+    // and return the vector
+    return resultVector;
+    } // Act()
 
+// Acts on a homogeneous point
+inline Homogeneous4 Quaternion::Act(const Homogeneous4 &point) const
+    { // Act()
+    Quaternion resultQuat = Inverse() * Quaternion(point) * (*this);
+    Homogeneous4 resultPoint(resultQuat.coords[0], resultQuat.coords[1], 
+        resultQuat.coords[2], resultQuat.coords[3]);
+    // and return the point
+    return resultPoint;
+    } // Act()
 
 #endif
@@ -16,7 +16,9 @@
  
 #include "Raytracer.h"
 #include <math.h>
+#include <stdint.h>
 #include <algorithm>
+#include <chrono>
 
 //-------------------------------------------------//
 //                                                 //
@@ -47,34 +49,53 @@ void Raytracer::Begin()
     { // Begin()
         // Clear the queues incase too many vertices were listed in the previous Begin & End call pair
         vertexQueue.clear();
+        queuePositions.clear();
+        queueNormals.clear();
     } // Begin()
 
 // ends a sequence of geometric primitives
 void Raytracer::End()
     { // End()
+        // Convert the queued positions & normals to VCS in one batch each
+        const Matrix4 &modelView = mvMatrixStack.top();
+        modelView.TransformPoints(queuePositions.data(), queuePositions.data(), queuePositions.size());
+        // the normals have always gone through the whole matrix as points do, translation & all,
+        // and the reference images depend on it, so they still do
+        modelView.TransformPoints(queueNormals.data(), queueNormals.data(), queueNormals.size());
+
     // Convert Vertex queue to triangles
+        size_t queued = 0;
         while (vertexQueue.size() > 2)
         {
             eyeSpaceTriangle t;
-            vertexVect.push_back(vertexQueue.front());
-            t.v1 = &(vertexVect.back());
-            vertexQueue.pop_front();
-
-            vertexVect.push_back(vertexQueue.front());
-            t.v2 = &(vertexVect.back());
-            vertexQueue.pop_front();
-
-            vertexVect.push_back(vertexQueue.front());
-            t.v3 = &(vertexVect.back());
-            vertexQueue.pop_front();
-
+            // The vertex pointers are filled in below, as pushing may move the vector
+            t.impulse = vertexQueue.front().impulse;
             t.textured = textureEnabled;
 
-            t.impulse = t.v1->impulse;
+            for (int v = 0; v < 3; v++)
+            {
+                vertexVect.push_back(vertexQueue.front());
+                vertexVect.back().position = queuePositions[queued];
+                vertexVect.back().normal = queueNormals[queued];
+                queued++;
+                vertexQueue.pop_front();
+            }
 
             triangleVect.push_back(t);
         }
-        
+
+        // Every triangle owns three consecutive vertices, so point each one at its own
+        for (size_t i = 0; i < triangleVect.size(); i++)
+        {
+            triangleVect[i].v1 = &(vertexVect[3*i]);
+            triangleVect[i].v2 = &(vertexVect[3*i + 1]);
+            triangleVect[i].v3 = &(vertexVect[3*i + 2]);
+        }
+
+        // anything left over is less than a triangle, and has been transformed already
+        vertexQueue.clear();
+        queuePositions.clear();
+        queueNormals.clear();
     } // End()
 
 //-------------------------------------------------//
@@ -216,7 +237,8 @@ void Raytracer::Materialfv(unsigned int parameterName, const float *parameterVal
 // sets the normal vector
 void Raytracer::Normal3f(float x, float y, float z)
     { // Normal3f()
-        normal = mvMatrixStack.top() * Cartesian3(x,y,z);
+        // it goes to VCS with the vertices, in End()
+        normal = Cartesian3(x,y,z);
     } // Normal3f()
 
 // sets the texture coordinates
@@ -230,12 +252,11 @@ void Raytracer::Vertex3f(float x, float y, float z)
     { // Vertex3f()
         // Generate a new vertex with the properties filled by the current state of the FakeGL instance
         vertexWithAttributes newVert;
-        newVert.position = mvMatrixStack.top() * Cartesian3(x,y,z);
+        // the position & normal are filled in by End(), in VCS
         newVert.colour.red = drawColor.red;
         newVert.colour.green = drawColor.green;
         newVert.colour.blue = drawColor.blue;
         newVert.colour.alpha = drawColor.alpha;
-        newVert.normal = normal;
         newVert.impulse = impulseVert;
 
         newVert.material = matCol;
@@ -244,6 +265,8 @@ void Raytracer::Vertex3f(float x, float y, float z)
 
         // Add it to the vertex queue
         vertexQueue.push_back(newVert);
+        queuePositions.push_back(Cartesian3(x,y,z));
+        queueNormals.push_back(normal);
     } // Vertex3f()
 
 
@@ -382,6 +405,198 @@ void Raytracer::ClearColor(float red, float green, float blue, float alpha)
         fbClearColor.alpha = alpha;
     } // ClearColor()
 
+//-------------------------------------------------//
+//                                                 //
+// SCENE TRANSFER ROUTINES                         //
+//                                                 //
+//-------------------------------------------------//
+
+// Identifies a scene stream, and the version of its layout
+static const char sceneMagic[4] = {'R','T','S','1'};
+
+// Values are written field by field so that padding never ends up in the stream
+static void WriteFloats(std::ostream &outStream, const float *values, int count) {
+    outStream.write((const char *)values, count * sizeof(float));
+}
+
+static bool ReadFloats(std::istream &inStream, float *values, int count) {
+    inStream.read((char *)values, count * sizeof(float));
+    return inStream.good();
+}
+
+static void WriteInt(std::ostream &outStream, int value) {
+    outStream.write((const char *)&value, sizeof(int));
+}
+
+static bool ReadInt(std::istream &inStream, int &value) {
+    inStream.read((char *)&value, sizeof(int));
+    return inStream.good();
+}
+
+static void WriteMaterial(std::ostream &outStream, const Material &material) {
+    WriteFloats(outStream, material.ambient.data, 4);
+    WriteFloats(outStream, material.specular.data, 4);
+    WriteFloats(outStream, material.diffuse.data, 4);
+    WriteFloats(outStream, material.emission.data, 4);
+    WriteFloats(outStream, &material.shininess, 1);
+}
+
+static bool ReadMaterial(std::istream &inStream, Material &material) {
+    return ReadFloats(inStream, material.ambient.data, 4) and
+           ReadFloats(inStream, material.specular.data, 4) and
+           ReadFloats(inStream, material.diffuse.data, 4) and
+           ReadFloats(inStream, material.emission.data, 4) and
+           ReadFloats(inStream, &material.shininess, 1);
+}
+
+static void WriteVertex(std::ostream &outStream, const vertexWithAttributes &vertex) {
+    WriteFloats(outStream, &vertex.position.x, 3);
+    WriteFloats(outStream, &vertex.colour.red, 4);
+    WriteFloats(outStream, &vertex.normal.x, 3);
+    WriteMaterial(outStream, vertex.material);
+    WriteFloats(outStream, &vertex.texCoord.x, 3);
+    outStream.put(vertex.impulse);
+}
+
+static bool ReadVertex(std::istream &inStream, vertexWithAttributes &vertex) {
+    if (!(ReadFloats(inStream, &vertex.position.x, 3) and
+          ReadFloats(inStream, &vertex.colour.red, 4) and
+          ReadFloats(inStream, &vertex.normal.x, 3) and
+          ReadMaterial(inStream, vertex.material) and
+          ReadFloats(inStream, &vertex.texCoord.x, 3)))
+        return false;
+    vertex.impulse = inStream.get() != 0;
+    return inStream.good();
+}
+
+// What WriteVertex() puts in the stream for each vertex & each triangle, so that
+// counts read back can be checked against the bytes actually there
+static const size_t sceneVertexBytes = (3 + 4 + 3 + 17 + 3) * sizeof(float) + 1;
+static const size_t sceneTriangleBytes = 2 + 3 * sceneVertexBytes;
+
+// how much of a seekable stream is still to be read, or 0 if that can't be told
+static size_t BytesLeft(std::istream &inStream) {
+    std::streampos here = inStream.tellg();
+    if (here < 0)
+        return 0;
+    inStream.seekg(0, std::ios::end);
+    std::streampos end = inStream.tellg();
+    inStream.seekg(here);
+    return (end > here) ? size_t(end - here) : 0;
+}
+
+// writes everything needed to trace the current scene
+void Raytracer::SaveScene(std::ostream &outStream)
+    { // SaveScene()
+        outStream.write(sceneMagic, 4);
+
+        WriteInt(outStream, frameBuffer.width);
+        WriteInt(outStream, frameBuffer.height);
+        WriteFloats(outStream, &fbClearColor.red, 4);
+
+        // Lighting & feature state
+        outStream.put(lightingEnabled);
+        outStream.put(shadowsEnabled);
+        outStream.put(impulseEnabled);
+        WriteInt(outStream, texMode);
+        WriteFloats(outStream, &lightPosition.x, 4);
+        WriteMaterial(outStream, lightMat);
+
+        // Triangles already own three consecutive vertices each, so only the flags need writing
+        WriteInt(outStream, triangleVect.size());
+        for (size_t i = 0; i < triangleVect.size(); i++)
+        {
+            outStream.put(triangleVect[i].textured);
+            outStream.put(triangleVect[i].impulse);
+            WriteVertex(outStream, *triangleVect[i].v1);
+            WriteVertex(outStream, *triangleVect[i].v2);
+            WriteVertex(outStream, *triangleVect[i].v3);
+        }
+
+        // The texture goes last, and only if a triangle will actually look it up
+        bool anyTextured = false;
+        for (size_t i = 0; i < triangleVect.size(); i++)
+            anyTextured = anyTextured or triangleVect[i].textured;
+
+        if (anyTextured and texture != NULL) {
+            WriteInt(outStream, texture->width);
+            WriteInt(outStream, texture->height);
+            outStream.write((const char *)texture->block, texture->width * texture->height * sizeof(RGBAValue));
+        } else {
+            WriteInt(outStream, 0);
+            WriteInt(outStream, 0);
+        }
+    } // SaveScene()
+
+// replaces the current scene with one written by SaveScene()
+bool Raytracer::LoadScene(std::istream &inStream)
+    { // LoadScene()
+        char magic[4];
+        inStream.read(magic, 4);
+        if (!inStream.good() or !std::equal(magic, magic + 4, sceneMagic))
+            return false;
+
+        int width, height;
+        if (!ReadInt(inStream, width) or !ReadInt(inStream, height) or width <= 0 or height <= 0)
+            return false;
+        if (!frameBuffer.Resize(width, height) or !depthBuffer.Resize(width, height))
+            return false;
+
+        if (!ReadFloats(inStream, &fbClearColor.red, 4))
+            return false;
+        // This also empties the triangle & vertex lists
+        Clear(RT_COLOR_BUFFER_BIT | RT_DEPTH_BUFFER_BIT);
+        texture = NULL;
+
+        lightingEnabled = inStream.get() != 0;
+        shadowsEnabled = inStream.get() != 0;
+        impulseEnabled = inStream.get() != 0;
+        int mode;
+        if (!ReadInt(inStream, mode) or !ReadFloats(inStream, &lightPosition.x, 4) or !ReadMaterial(inStream, lightMat))
+            return false;
+        texMode = mode;
+
+        // The counts come from whoever sent the scene, so nothing is allocated for more than the stream holds
+        int nTriangles;
+        if (!ReadInt(inStream, nTriangles) or nTriangles < 0 or size_t(nTriangles) > BytesLeft(inStream) / sceneTriangleBytes)
+            return false;
+
+        // Reserve up front so that the triangles' vertex pointers stay put
+        vertexVect.resize(3 * size_t(nTriangles));
+        triangleVect.resize(nTriangles);
+        for (int i = 0; i < nTriangles; i++)
+        {
+            eyeSpaceTriangle &t = triangleVect[i];
+            t.textured = inStream.get() != 0;
+            t.impulse = inStream.get() != 0;
+            t.v1 = &(vertexVect[3*i]);
+            t.v2 = &(vertexVect[3*i + 1]);
+            t.v3 = &(vertexVect[3*i + 2]);
+            if (!ReadVertex(inStream, *t.v1) or !ReadVertex(inStream, *t.v2) or !ReadVertex(inStream, *t.v3))
+                return false;
+        }
+
+        int texWidth, texHeight;
+        if (!ReadInt(inStream, texWidth) or !ReadInt(inStream, texHeight))
+            return false;
+        if (texWidth == 0 and texHeight == 0) {
+            // Nothing to look up, so no triangle can be drawn textured
+            for (size_t i = 0; i < triangleVect.size(); i++)
+                triangleVect[i].textured = false;
+            return true;
+        }
+        if (texWidth <= 0 or texHeight <= 0 or size_t(texWidth) > SIZE_MAX / sizeof(RGBAValue) / size_t(texHeight))
+            return false;
+        size_t texBytes = size_t(texWidth) * size_t(texHeight) * sizeof(RGBAValue);
+        if (texBytes > BytesLeft(inStream) or !loadedTexture.Resize(texWidth, texHeight))
+            return false;
+        inStream.read((char *)loadedTexture.block, texBytes);
+        if (!inStream.good() or size_t(inStream.gcount()) != texBytes)
+            return false;
+        texture = &loadedTexture;
+        return true;
+    } // LoadScene()
+
 //-------------------------------------------------//
 //                                                 //
 // MAJOR PROCESSING ROUTINES                       //
@@ -390,7 +605,8 @@ void Raytracer::ClearColor(float red, float green, float blue, float alpha)
 
 // casts a ray in the world and returns pointer to the first triangle it interescts
 // Null pointer if no triangle intersection
-surfel Raytracer::RayCast(ray r) {
+surfel Raytracer::RayCast(ray r, unsigned int bounces) {
+    raysCast++;
     float minD = MAXFLOAT;
     surfel closest;
     surfel intersec(NULL,0,0,0,0);
@@ -398,14 +614,14 @@ surfel Raytracer::RayCast(ray r) {
     {
         if (RayTriIntersectTest(r, &(triangleVect[i]), intersec)) {
             if (intersec.distance >= 0 and intersec.distance < minD) {
-                if (intersec.tri->impulse and impulseEnabled) {
+                if (intersec.tri->impulse and impulseEnabled and bounces < RT_MAX_BOUNCES) {
                     ray r1;
                     r1.dir = reflectVector(r.dir, intersec.getNorm());
                     r1.origin = intersec.getPos() + 0.001*r1.dir;
 
                     float oldD = intersec.distance;
 
-                    intersec = RayCast(r1);
+                    intersec = RayCast(r1, bounces + 1);
                     intersec.distance = oldD;
                 }
                 minD = intersec.distance;
@@ -432,7 +648,7 @@ surfel Raytracer::RayCast(ray r, eyeSpaceTriangle *tri) {
 
                 float oldD = intersec.distance;
 
-                intersec = RayCast(r1);
+                intersec = RayCast(r1, 1u);
                 intersec.distance = oldD;
             }
             return intersec;
@@ -483,16 +699,26 @@ void Raytracer::getBarycentric(Cartesian3 p, Cartesian3 a, Cartesian3 b, Cartesi
     alpha = 1.f - beta - gamma;
 }
 
+// true if the owner has asked for a newer frame than the one being rendered
+bool Raytracer::Cancelled() const {
+    return latestGeneration != NULL and latestGeneration->load() != renderGeneration;
+}
+
 // Draw screen by looping triangles then pixels
-void Raytracer::drawScreenByTri() {
+bool Raytracer::drawScreenByTri() {
     float pWidth = 2.f/(float)frameBuffer.width;
     float pHeight = 2.f/(float)frameBuffer.height;
 
     ray r;
     r.dir = Cartesian3(0.f,0.f,-1.f);
 
+    std::chrono::steady_clock::time_point lastPass = std::chrono::steady_clock::now();
+
     for (size_t i = 0; i < triangleVect.size(); i++) 
     {
+        // Every triangle is a full pass over the screen, so this is a cheap place to stop
+        if (Cancelled()) return false;
+
         eyeSpaceTriangle *tri = &(triangleVect[i]);
 
         // For each pixel
@@ -517,36 +743,77 @@ void Raytracer::drawScreenByTri() {
                 }
             }
         }
+
+        // The triangles drawn so far are a valid partial image, so hand it on if enough time has passed
+        if (passComplete and std::chrono::steady_clock::now() - lastPass > std::chrono::milliseconds(passInterval)) {
+            passComplete();
+            lastPass = std::chrono::steady_clock::now();
+        }
     }
-    
+    return true;
 }
 
 // Draw screen by looping pixels then triangles
-void Raytracer::drawScreenByPix() {
-    float pWidth = 2.f/(float)frameBuffer.width;
-    float pHeight = 2.f/(float)frameBuffer.height;
-
-    ray r;
-    r.dir = Cartesian3(0.f,0.f,-1.f);
+bool Raytracer::drawScreenByPix() {
+    std::chrono::steady_clock::time_point lastPass = std::chrono::steady_clock::now();
 
     // For each pixel
     for (size_t x = 0; x < frameBuffer.width; x++)
     {
-        float xOff = -1.f + (x*pWidth) + (pWidth/2.);
+        if (Cancelled()) return false;
+
         for (size_t y = 0; y < frameBuffer.height; y++)
-        {
-            float yOff = -1.f + (y*pHeight) + (pHeight/2.);
+            TracePixel(x, y);
+
+        // Completed columns are final, so they can be shown while the rest are traced
+        if (passComplete and std::chrono::steady_clock::now() - lastPass > std::chrono::milliseconds(passInterval)) {
+            passComplete();
+            lastPass = std::chrono::steady_clock::now();
+        }
+    }
+    return true;
+}
 
-            // Cast the orthogonal ray
-            r.origin = Cartesian3(xOff,yOff,1.f);
-            surfel intersec = RayCast(r);
+// Draw a rectangle of the screen by looping pixels then triangles
+// Every pixel is independent, so tiles can be traced separately & in any order
+bool Raytracer::drawTile(long x0, long y0, long x1, long y1) {
+    x0 = std::max(x0, 0L);
+    y0 = std::max(y0, 0L);
+    x1 = std::min(x1, frameBuffer.width);
+    y1 = std::min(y1, frameBuffer.height);
+    std::chrono::steady_clock::time_point lastPass = std::chrono::steady_clock::now();
 
-            // If the ray intersects a triangle
-            if (intersec.tri != NULL) {
-                RenderIntersec(intersec, x, y);
-            }
+    for (long y = y0; y < y1; y++)
+    {
+        if (Cancelled()) return false;
+
+        for (long x = x0; x < x1; x++)
+            TracePixel(x, y);
+
+        // A tile of a big scene can take a long time, so say how it is getting on a row at a time
+        if (passComplete and std::chrono::steady_clock::now() - lastPass > std::chrono::milliseconds(passInterval)) {
+            passComplete();
+            lastPass = std::chrono::steady_clock::now();
         }
     }
+    return true;
+}
+
+// Cast the ray through the centre of a pixel & shade whatever it hits first
+void Raytracer::TracePixel(size_t x, size_t y) {
+    float pWidth = 2.f/(float)frameBuffer.width;
+    float pHeight = 2.f/(float)frameBuffer.height;
+
+    // Cast the orthogonal ray
+    ray r;
+    r.dir = Cartesian3(0.f,0.f,-1.f);
+    r.origin = Cartesian3(-1.f + (x*pWidth) + (pWidth/2.), -1.f + (y*pHeight) + (pHeight/2.), 1.f);
+    surfel intersec = RayCast(r);
+
+    // If the ray intersects a triangle
+    if (intersec.tri != NULL) {
+        RenderIntersec(intersec, x, y);
+    }
 }
 
 void Raytracer::RenderIntersec(surfel inter, size_t x, size_t y) {
@@ -20,6 +20,36 @@
 // include the header file
 #include "RaytraceRenderWidget.h"
 
+// returns true if two sets of parameters would produce the same ray traced image
+// the transforms are the same if they are the same version, without comparing matrices
+static bool SameParameters(const RenderParameters &a, const RenderParameters &b)
+    { // SameParameters()
+    for (int i = 0; i < 4; i++)
+        if (a.lightPosition[i] != b.lightPosition[i])
+            return false;
+
+    return  a.xTranslate            == b.xTranslate             &&
+            a.yTranslate            == b.yTranslate             &&
+            a.zoomScale             == b.zoomScale              &&
+            a.modelTransform.version == b.modelTransform.version &&
+            a.lightTransform.version == b.lightTransform.version &&
+            a.emissiveLight         == b.emissiveLight          &&
+            a.ambientLight          == b.ambientLight           &&
+            a.diffuseLight          == b.diffuseLight           &&
+            a.specularLight         == b.specularLight          &&
+            a.specularExponent      == b.specularExponent       &&
+            a.useLighting           == b.useLighting            &&
+            a.texturedRendering     == b.texturedRendering      &&
+            a.textureModulation     == b.textureModulation      &&
+            a.shadowsOn             == b.shadowsOn              &&
+            a.impulseReflectionOn   == b.impulseReflectionOn    &&
+            a.renderRT              == b.renderRT               &&
+            a.showObject            == b.showObject             &&
+            a.centreObject          == b.centreObject           &&
+            a.scaleObject           == b.scaleObject            &&
+            a.mapUVWToRGB           == b.mapUVWToRGB;
+    } // SameParameters()
+
 // constructor
 RaytraceRenderWidget::RaytraceRenderWidget
         (   
@@ -37,116 +67,131 @@ RaytraceRenderWidget::RaytraceRenderWidget
     QOpenGLWidget(parent),
     // then store the pointers that were passed in
     texturedObject(newTexturedObject),
-    renderParameters(newRenderParameters)
+    renderParameters(newRenderParameters),
+    requestedWidth(0),
+    requestedHeight(0),
+    frameRequested(false),
+    widgetWidth(0),
+    widgetHeight(0),
+    drawBuffer(0),
+    drawWidth(0),
+    drawHeight(0),
+    frameWaiting(false)
     { // constructor
-    // leaves nothing to put into the constructor body
+    pixelBuffers[0] = pixelBuffers[1] = NULL;
+
+    // the worker takes a copy of the assets, then lives on its own thread
+    raytraceWorker = new RaytraceWorker(texturedObject);
+    raytraceWorker->moveToThread(&workerThread);
 
+    // the signal crosses threads, so Qt queues it onto ours
+    connect(raytraceWorker, SIGNAL(FrameReady(bool)), this, SLOT(FrameReady(bool)));
+
+    workerThread.start();
     } // constructor    
 
 // destructor
 RaytraceRenderWidget::~RaytraceRenderWidget()
     { // destructor
-    // empty (for now)
-    // all of our pointers are to data owned by another class
-    // so we have no responsibility for destruction
-    // and OpenGL cleanup is taken care of by Qt
+    // stop any render in flight, then wait for the thread to wind down
+    raytraceWorker->Cancel();
+    workerThread.quit();
+    workerThread.wait();
+    delete raytraceWorker;
+
+    // the pixel buffers belong to our context, so it must be current to free them
+    makeCurrent();
+    for (int i = 0; i < 2; i++)
+        delete pixelBuffers[i];
+    doneCurrent();
     } // destructor                                                                 
 
 // called when OpenGL context is set up
 void RaytraceRenderWidget::initializeGL()
     { // RaytraceRenderWidget::initializeGL()
-	// this should remain empty
-
-    texturedObject->TransferAssetsToRaytracer(&raytracer);
+    // set up the pixel buffers we upload frames through
+    for (int i = 0; i < 2; i++)
+        { // per buffer
+        pixelBuffers[i] = new QOpenGLBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+        pixelBuffers[i]->setUsagePattern(QOpenGLBuffer::StreamDraw);
+        pixelBuffers[i]->create();
+        } // per buffer
     } // RaytraceRenderWidget::initializeGL()
 
 // called every time the widget is resized
 void RaytraceRenderWidget::resizeGL(int w, int h)
     { // RaytraceRenderWidget::resizeGL()
-    // resize the render image
-    raytracer.frameBuffer.Resize(w, h);
-    raytracer.depthBuffer.Resize(w, h);
+    // the worker resizes its own image when the next frame is requested
+    widgetWidth = w;
+    widgetHeight = h;
     } // RaytraceRenderWidget::resizeGL()
     
 // called every time the widget needs painting
 void RaytraceRenderWidget::paintGL()
     { // RaytraceRenderWidget::paintGL()
-    // set background colour to white
+    // painting never waits on the raytracer: it just asks for a new frame
+    // if the view has changed, and shows the latest one that has arrived
+    RequestFrameIfChanged();
 
-    Raytrace();
+    if (frameWaiting)
+        UploadFrame();
 
+    // set background colour to the raytracer's clear colour until the first frame arrives
+    glClearColor(0.8, 0.8, 0.6, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    // and display the image
-    glDrawPixels(raytracer.frameBuffer.width, raytracer.frameBuffer.height, GL_RGBA, GL_UNSIGNED_BYTE, raytracer.frameBuffer.block);
+    if (drawWidth == 0 || drawHeight == 0)
+        return;
+
+    // and display the image straight from the pixel buffer
+    pixelBuffers[drawBuffer]->bind();
+    glDrawPixels(drawWidth, drawHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    pixelBuffers[drawBuffer]->release();
     } // RaytraceRenderWidget::paintGL()
-    
-    // routine that generates the image
-void RaytraceRenderWidget::Raytrace()
-    { // RaytraceRenderWidget::Raytrace()
-	// This is where you will invoke your raytracing
-
-    raytracer.ClearColor(0.8, 0.8, 0.6, 1.0);
-    raytracer.Clear(RT_COLOR_BUFFER_BIT | RT_DEPTH_BUFFER_BIT);
-    raytracer.LoadIdentity();
-
-    raytracer.Disable(RT_LIGHTING);
-    raytracer.Disable(RT_SHADOWS);
-    raytracer.Disable(RT_IMPULSE_REFLECTION);
-
-    if (renderParameters->shadowsOn) {
-        raytracer.Enable(RT_SHADOWS);
-    }
-
-    if (renderParameters->impulseReflectionOn) {
-        raytracer.Enable(RT_IMPULSE_REFLECTION);
-    }
-
-    // if lighting is turned on
-    if (renderParameters->useLighting)
-    { // use lighting
-        // make sure lighting is on
-        raytracer.Enable(RT_LIGHTING);
-
-        // set light position first, pushing/popping matrix so that it the transformation does
-        // not affect the position of the geometric object
-        raytracer.PushMatrix();
-        raytracer.MultMatrixf(renderParameters->lightMatrix.columnMajor().coordinates);
-        raytracer.Light(RT_POSITION, renderParameters->lightPosition);
-        raytracer.PopMatrix();
-        
-        // now set the lighting parameters (assuming all light is white)
-        float ambientColour[4];
-        float diffuseColour[4];
-        float specularColour[4];
-        
-        // now copy the parameters
-        ambientColour[0]    = ambientColour[1]  = ambientColour[2]  = renderParameters->ambientLight;
-        diffuseColour[0]    = diffuseColour[1]  = diffuseColour[2]  = renderParameters->diffuseLight;
-        specularColour[0]   = specularColour[1] = specularColour[2] = renderParameters->specularLight;
-        ambientColour[3]    = diffuseColour[3]  = specularColour[3] = 1.0; // don't forget alpha
-
-        // and set them in OpenGL
-        raytracer.Light(RT_AMBIENT,    ambientColour);
-        raytracer.Light(RT_DIFFUSE,    diffuseColour);
-        raytracer.Light(RT_SPECULAR,   specularColour);
-    }
-
-    // translate by the visual translation
-    raytracer.Translatef(renderParameters->xTranslate, renderParameters->yTranslate, 0.0f);
-
-    // apply rotation matrix from arcball
-    raytracer.MultMatrixf(renderParameters->rotationMatrix.columnMajor().coordinates);
-
-    if (renderParameters->showObject) {
-        texturedObject->RenderRT(renderParameters,&raytracer);
-    }
-
-    if (renderParameters->renderRT) {
-        raytracer.drawScreenByTri();
-    }
-
-
-    } // RaytraceRenderWidget::Raytrace()
+
+// asks the worker for a new frame if the view has changed
+void RaytraceRenderWidget::RequestFrameIfChanged()
+    { // RaytraceRenderWidget::RequestFrameIfChanged()
+    if (frameRequested &&
+        requestedWidth == widgetWidth && requestedHeight == widgetHeight &&
+        SameParameters(requestedParameters, *renderParameters))
+        return;
+
+    requestedParameters = *renderParameters;
+    requestedWidth = widgetWidth;
+    requestedHeight = widgetHeight;
+    frameRequested = true;
+
+    // this also cancels whatever the worker is currently tracing
+    raytraceWorker->RequestFrame(requestedParameters, requestedWidth, requestedHeight);
+    } // RaytraceRenderWidget::RequestFrameIfChanged()
+
+// copies the worker's latest frame into the next pixel buffer
+void RaytraceRenderWidget::UploadFrame()
+    { // RaytraceRenderWidget::UploadFrame()
+    int nextBuffer = 1 - drawBuffer;
+
+    const RGBAImage &frame = raytraceWorker->LockFrontBuffer();
+    pixelBuffers[nextBuffer]->bind();
+    // allocating afresh lets the driver orphan the old storage rather than stall
+    pixelBuffers[nextBuffer]->allocate(frame.block, frame.width * frame.height * sizeof(RGBAValue));
+    pixelBuffers[nextBuffer]->release();
+    drawWidth = frame.width;
+    drawHeight = frame.height;
+    raytraceWorker->UnlockFrontBuffer();
+
+    drawBuffer = nextBuffer;
+    frameWaiting = false;
+    } // RaytraceRenderWidget::UploadFrame()
+
+// called when the worker has a new frame or partial pass
+void RaytraceRenderWidget::FrameReady(bool complete)
+    { // RaytraceRenderWidget::FrameReady()
+    // partial passes are shown the same way as complete frames
+    Q_UNUSED(complete);
+    frameWaiting = true;
+    update();
+    } // RaytraceRenderWidget::FrameReady()
     
 // mouse-handling
 void RaytraceRenderWidget::mousePressEvent(QMouseEvent *event)
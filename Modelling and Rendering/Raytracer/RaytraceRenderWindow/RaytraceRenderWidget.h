@@ -22,11 +22,14 @@
 // include the relevant QT headers
 #include <QOpenGLWidget>
 #include <QMouseEvent>
+#include <QThread>
+#include <QOpenGLBuffer>
 
 // and include all of our own headers that we need
 #include "TexturedObject.h"
 #include "RenderParameters.h"
 #include "Raytracer.h"
+#include "RaytraceWorker.h"
 
 // class for a render widget with arcball linked to an external arcball widget
 class RaytraceRenderWidget : public QOpenGLWidget										
@@ -39,7 +42,26 @@ class RaytraceRenderWidget : public QOpenGLWidget
 	// the render parameters to use
 	RenderParameters *renderParameters;
 
-	Raytracer raytracer;
+	// the raytracer runs on its own thread so that painting never waits for it
+	RaytraceWorker *raytraceWorker;
+	QThread workerThread;
+
+	// the parameters & size of the last frame we asked for
+	RenderParameters requestedParameters;
+	long requestedWidth, requestedHeight;
+	bool frameRequested;
+
+	// the widget size, as given to resizeGL()
+	long widgetWidth, widgetHeight;
+
+	// frames are uploaded to alternating pixel buffers, so that a new upload
+	// never has to wait for the previous draw to finish reading
+	QOpenGLBuffer *pixelBuffers[2];
+	int drawBuffer;
+	long drawWidth, drawHeight;
+
+	// set when the worker has a frame we have not uploaded yet
+	bool frameWaiting;
 
 	public:
 	// constructor
@@ -64,14 +86,20 @@ class RaytraceRenderWidget : public QOpenGLWidget
 	// called every time the widget needs painting
 	void paintGL();
 	
-    // routine that generates the image
-    void Raytrace();
+	// asks the worker for a new frame if the view has changed
+	void RequestFrameIfChanged();
+	// copies the worker's latest frame into the next pixel buffer
+	void UploadFrame();
 
 	// mouse-handling
 	virtual void mousePressEvent(QMouseEvent *event);
 	virtual void mouseMoveEvent(QMouseEvent *event);
 	virtual void mouseReleaseEvent(QMouseEvent *event);
 
+	private slots:
+	// called (on the GUI thread) when the worker has a new frame or partial pass
+	void FrameReady(bool complete);
+
 	// these signals are needed to support shared arcball control
 	public:
 	signals:
@@ -0,0 +1,149 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  Raytrace Worker
+//  -----------------------------
+//
+//  Owns the raytracer and runs it on a background thread so that
+//  the GUI never waits on a render.  Finished frames and partial
+//  passes are copied into one of two presentation buffers and the
+//  widget is signalled to pick them up.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include <QMetaObject>
+#include <QMutexLocker>
+
+// include the header file
+#include "RaytraceWorker.h"
+
+// constructor
+RaytraceWorker::RaytraceWorker(TexturedObject *newTexturedObject)
+    :
+    texturedObject(newTexturedObject),
+    requestedWidth(0),
+    requestedHeight(0),
+    latestGeneration(0),
+    handledGeneration(0),
+    frontBuffer(0)
+    { // constructor
+    // the assets only need transferring once, and the object is not changed afterwards
+    texturedObject->TransferAssetsToRaytracer(&raytracer);
+
+    // let the raytracer check for newer requests & hand back partial passes
+    raytracer.latestGeneration = &latestGeneration;
+    raytracer.passComplete = [this]()
+        { // passComplete()
+        // a stale pass would flash the old view over the new one
+        if (!raytracer.Cancelled())
+            Present(false);
+        }; // passComplete()
+    } // constructor
+
+// asks for a new frame, abandoning any render in flight
+void RaytraceWorker::RequestFrame(const RenderParameters &parameters, long width, long height)
+    { // RaytraceWorker::RequestFrame()
+    { // locked
+    QMutexLocker locker(&requestMutex);
+    requestedParameters = parameters;
+    requestedWidth = width;
+    requestedHeight = height;
+    // bumping the generation is what makes the raytracer give up on the old frame
+    latestGeneration++;
+    } // locked
+
+    // queue the work on our own thread - if several requests arrive while
+    // a render is in flight, only the latest is acted upon
+    QMetaObject::invokeMethod(this, "ProcessRequest", Qt::QueuedConnection);
+    } // RaytraceWorker::RequestFrame()
+
+// abandons any render in flight without asking for another
+void RaytraceWorker::Cancel()
+    { // RaytraceWorker::Cancel()
+    QMutexLocker locker(&requestMutex);
+    latestGeneration++;
+    // mark it handled so that a queued ProcessRequest() does nothing
+    handledGeneration = latestGeneration.load();
+    } // RaytraceWorker::Cancel()
+
+// locks and returns the most recently presented image
+const RGBAImage &RaytraceWorker::LockFrontBuffer()
+    { // RaytraceWorker::LockFrontBuffer()
+    presentMutex.lock();
+    return presentBuffers[frontBuffer];
+    } // RaytraceWorker::LockFrontBuffer()
+
+void RaytraceWorker::UnlockFrontBuffer()
+    { // RaytraceWorker::UnlockFrontBuffer()
+    presentMutex.unlock();
+    } // RaytraceWorker::UnlockFrontBuffer()
+
+// picks up the latest request and renders it
+void RaytraceWorker::ProcessRequest()
+    { // RaytraceWorker::ProcessRequest()
+    RenderParameters parameters;
+    long width, height;
+    unsigned int generation;
+    { // locked
+    QMutexLocker locker(&requestMutex);
+    // earlier queued calls find that a later one already took their request
+    if (latestGeneration.load() == handledGeneration)
+        return;
+    generation = handledGeneration = latestGeneration.load();
+    parameters = requestedParameters;
+    width = requestedWidth;
+    height = requestedHeight;
+    } // locked
+
+    raytracer.renderGeneration = generation;
+
+    // resize the render image if the widget has changed size
+    if (raytracer.frameBuffer.width != width || raytracer.frameBuffer.height != height)
+        { // resize
+        raytracer.frameBuffer.Resize(width, height);
+        raytracer.depthBuffer.Resize(width, height);
+        } // resize
+
+    // only present the frame if nobody asked for another in the meantime
+    if (Raytrace(parameters) && !raytracer.Cancelled())
+        Present(true);
+    } // RaytraceWorker::ProcessRequest()
+
+// sets up the raytracer from the parameters & traces the scene
+bool RaytraceWorker::Raytrace(const RenderParameters &renderParameters)
+    { // RaytraceWorker::Raytrace()
+    // RenderRT() only reads the parameters, but takes a non-const pointer
+    RenderParameters parameters = renderParameters;
+    texturedObject->SetUpRaytraceScene(&parameters, &raytracer);
+
+    if (renderParameters.renderRT) {
+        return raytracer.drawScreenByTri();
+    }
+
+    return true;
+    } // RaytraceWorker::Raytrace()
+
+// copies the raytracer's frame buffer to the back buffer and swaps
+void RaytraceWorker::Present(bool complete)
+    { // RaytraceWorker::Present()
+    // the GUI thread only ever reads the front buffer, so the back one is ours
+    RGBAImage &backBuffer = presentBuffers[1 - frontBuffer];
+    if (backBuffer.width != raytracer.frameBuffer.width || backBuffer.height != raytracer.frameBuffer.height)
+        backBuffer.Resize(raytracer.frameBuffer.width, raytracer.frameBuffer.height);
+    memcpy(backBuffer.block, raytracer.frameBuffer.block, backBuffer.width * backBuffer.height * sizeof(RGBAValue));
+
+    { // locked
+    QMutexLocker locker(&presentMutex);
+    frontBuffer = 1 - frontBuffer;
+    } // locked
+
+    emit FrameReady(complete);
+    } // RaytraceWorker::Present()
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  University of Leeds
+//  COMP 5812M Foundations of Modelling & Rendering
+//  User Interface for Coursework
+//
+//  September, 2020
+//
+//  -----------------------------
+//  Raytrace Worker
+//  -----------------------------
+//
+//  Owns the raytracer and runs it on a background thread so that
+//  the GUI never waits on a render.  Finished frames and partial
+//  passes are copied into one of two presentation buffers and the
+//  widget is signalled to pick them up.
+//
+////////////////////////////////////////////////////////////////////////
+
+// include guard
+#ifndef _RAYTRACE_WORKER_H
+#define _RAYTRACE_WORKER_H
+
+// include the relevant QT headers
+#include <QObject>
+#include <QMutex>
+
+#include <atomic>
+
+// and include all of our own headers that we need
+#include "TexturedObject.h"
+#include "RenderParameters.h"
+#include "Raytracer.h"
+
+// class for a raytracer living on its own thread
+class RaytraceWorker : public QObject
+    { // class RaytraceWorker
+    Q_OBJECT
+    private:
+    // the geometric object to be rendered (read only while rendering)
+    TexturedObject *texturedObject;
+
+    // the raytracer itself - only ever touched on the worker thread
+    Raytracer raytracer;
+
+    // the most recent request from the GUI thread
+    QMutex requestMutex;
+    RenderParameters requestedParameters;
+    long requestedWidth, requestedHeight;
+
+    // bumped on every request so that a render in flight can tell it is stale
+    std::atomic<unsigned int> latestGeneration;
+    // the last generation the worker started on
+    unsigned int handledGeneration;
+
+    // the GUI reads the front buffer while the worker fills the back one
+    QMutex presentMutex;
+    RGBAImage presentBuffers[2];
+    int frontBuffer;
+
+    public:
+    // constructor
+    RaytraceWorker(TexturedObject *newTexturedObject);
+
+    // asks for a new frame, abandoning any render in flight
+    // safe to call from any thread
+    void RequestFrame(const RenderParameters &parameters, long width, long height);
+
+    // abandons any render in flight without asking for another
+    void Cancel();
+
+    // locks and returns the most recently presented image
+    // must be followed by UnlockFrontBuffer()
+    const RGBAImage &LockFrontBuffer();
+    void UnlockFrontBuffer();
+
+    public slots:
+    // picks up the latest request and renders it (runs on the worker thread)
+    void ProcessRequest();
+
+    signals:
+    // emitted whenever the front buffer changes, complete is false for partial passes
+    void FrameReady(bool complete);
+
+    private:
+    // sets up the raytracer from the parameters & traces the scene
+    // returns false if the render was cancelled
+    bool Raytrace(const RenderParameters &renderParameters);
+
+    // copies the raytracer's frame buffer to the back buffer and swaps
+    void Present(bool complete);
+    }; // class RaytraceWorker
+
+#endif
@@ -9,6 +9,9 @@
 #include <vector>
 #include <deque>
 #include <stack>
+#include <iostream>
+#include <atomic>
+#include <functional>
 
 // class constants
 // bitflag constants for Clear()
@@ -34,6 +37,9 @@ const unsigned int RT_PROJECTION = 2;
 // constants for texture operations
 const unsigned int RT_MODULATE = 1;
 const unsigned int RT_REPLACE = 2;
+// how many times a ray is reflected before the mirror it reaches is drawn as it is
+// (a ray between two facing mirrors would otherwise never stop)
+const unsigned int RT_MAX_BOUNCES = 8;
 
 class MatComponent {
     public:
@@ -219,10 +225,16 @@ class Raytracer
     // we want a queue of vertices with attributes for passing to the rasteriser
     std::deque<vertexWithAttributes> vertexQueue;
 
+    // and their positions & normals, still in OCS: End() takes the whole lot to VCS
+    // together, as the matrix can't change between Begin() & End()
+    std::vector<Cartesian3> queuePositions;
+    std::vector<Cartesian3> queueNormals;
+
     //-----------------------------
     // TRANSFORM/LIGHTING STATE
     //-----------------------------
 
+    // the current normal, in OCS
     Cartesian3 normal;
 
     bool lightingEnabled = false;
@@ -252,6 +264,9 @@ class Raytracer
     Cartesian3 texCoord;
     const RGBAImage *texture;
 
+    // a texture of our own, used when the scene was loaded from a stream
+    RGBAImage loadedTexture;
+
     //-----------------------------
     // FRAMEBUFFER STATE
     // OUTPUT FROM FRAGMENT STAGE
@@ -265,6 +280,26 @@ class Raytracer
      
     // Depth buffer is currently unusued
     RGBAImage depthBuffer;
+
+    //-----------------------------
+    // ASYNCHRONOUS RENDER STATE
+    //-----------------------------
+
+    // if set, the render is abandoned as soon as this no longer matches renderGeneration
+    const std::atomic<unsigned int> *latestGeneration = NULL;
+    unsigned int renderGeneration = 0;
+
+    // if set, called with the partially complete frame buffer every passInterval milliseconds
+    std::function<void()> passComplete;
+    unsigned int passInterval = 100;
+
+    //-----------------------------
+    // STATISTICS
+    //-----------------------------
+
+    // rays cast against the whole scene: primary rays from drawScreenByPix()
+    // & drawTile(), plus shadow and reflection rays
+    unsigned long long raysCast = 0;
     
     //-------------------------------------------------//
     //                                                 //
@@ -402,6 +437,21 @@ class Raytracer
     // sets the clear colour for the frame buffer
     void ClearColor(float red, float green, float blue, float alpha);
 
+    //-------------------------------------------------//
+    //                                                 //
+    // SCENE TRANSFER ROUTINES                         //
+    //                                                 //
+    //-------------------------------------------------//
+
+    // writes everything needed to trace the current scene (triangles,
+    // light, flags, texture & frame size) in a compact binary form
+    void SaveScene(std::ostream &outStream);
+
+    // replaces the current scene with one written by SaveScene()
+    // returns false, leaving nothing fit to trace, if the stream is malformed or
+    // claims more than it holds - which needs it to be seekable, as a string stream is
+    bool LoadScene(std::istream &inStream);
+
     //-------------------------------------------------//
     //                                                 //
     // MAJOR PROCESSING ROUTINES                       //
@@ -411,12 +461,22 @@ class Raytracer
     // Will include a ray tracer
     // Render ruitine
 
-    void drawScreenByPix();
-    surfel RayCast(ray r);
+    bool drawScreenByPix();
+    surfel RayCast(ray r, unsigned int bounces = 0);
 
-    void drawScreenByTri();
+    // both return false if the render was cancelled part way through
+    bool drawScreenByTri();
     surfel RayCast(ray r, eyeSpaceTriangle *triangle);
 
+    // traces the pixels in [x0,x1) x [y0,y1), returns false if cancelled
+    bool drawTile(long x0, long y0, long x1, long y1);
+
+    // casts the ray for a single pixel and shades it
+    void TracePixel(size_t x, size_t y);
+
+    // true if the owner has asked for a newer frame than the one being rendered
+    bool Cancelled() const;
+
     bool RayTriIntersectTest(ray r, eyeSpaceTriangle* tri, surfel &intersec);
 
     void getBarycentric(Cartesian3 p, Cartesian3 a, Cartesian3 b, Cartesian3 c, float &alpha, float &beta, float &gamma);
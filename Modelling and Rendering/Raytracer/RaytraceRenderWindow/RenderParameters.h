@@ -19,7 +19,81 @@
 #ifndef _RENDER_PARAMETERS_H
 #define _RENDER_PARAMETERS_H
 
+#include <atomic>
 #include "Matrix4.h"
+#include "Quaternion.h"
+
+// hands out the versions of CachedTransforms, each one only once
+inline unsigned long NextTransformVersion()
+    { // NextTransformVersion()
+    static std::atomic<unsigned long> lastVersion(0);
+    return ++lastVersion;
+    } // NextTransformVersion()
+
+// a rotation followed by a translation, kept as a quaternion & a vector, with the matrix
+// & the column-major copy OpenGL wants worked out only when it changes, not every frame
+class CachedTransform
+    { // class CachedTransform
+    public:
+    // the rotation & the translation
+    Quaternion rotation;
+    Cartesian3 translation;
+
+    // the same as a matrix, and in column-major form
+    Matrix4 matrix;
+    columnMajorMatrix columnMajor;
+
+    // a new version on every change, never given to any other transform, so whatever
+    // is set up from the transform can keep the version to tell if it is out of date
+    unsigned long version;
+
+    // constructor - no rotation or translation
+    CachedTransform()
+        :
+        translation(0.0, 0.0, 0.0)
+        { // constructor
+        Matrix4 identity;
+        identity.SetIdentity();
+        Update(identity);
+        } // constructor
+
+    // sets the rotation from a quaternion
+    void SetRotation(const Quaternion &newRotation)
+        { // SetRotation()
+        if (newRotation.coords.x == rotation.coords.x && newRotation.coords.y == rotation.coords.y &&
+            newRotation.coords.z == rotation.coords.z && newRotation.coords.w == rotation.coords.w)
+            return;
+        rotation = newRotation;
+        Update(rotation.GetMatrix());
+        } // SetRotation()
+
+    // or from a rotation matrix, which the matrix keeps exactly as it is
+    void SetRotation(const Matrix4 &rotationMatrix)
+        { // SetRotation()
+        rotation = Quaternion(rotationMatrix);
+        Update(rotationMatrix);
+        } // SetRotation()
+
+    // sets the translation
+    void SetTranslation(const Cartesian3 &newTranslation)
+        { // SetTranslation()
+        if (newTranslation == translation)
+            return;
+        translation = newTranslation;
+        // the rotation part of the matrix is the same as before
+        Update(matrix);
+        } // SetTranslation()
+
+    // works out the matrices from the rotation as a matrix & the translation
+    void Update(const Matrix4 &rotationMatrix)
+        { // Update()
+        matrix = rotationMatrix;
+        for (int row = 0; row < 3; row++)
+            matrix.coordinates[row][3] = translation[row];
+        columnMajor = matrix.columnMajor();
+        version = NextTransformVersion();
+        } // Update()
+    }; // class CachedTransform
 
 // class for the render parameters
 class RenderParameters
@@ -38,10 +112,11 @@ class RenderParameters
     // we have the position of the light
     float lightPosition[4];
     
-    // we will want two homogeneous matrices holding the rotations for the
-    // model and the light.
-    Matrix4 rotationMatrix;
-    Matrix4 lightMatrix;
+    // we will want two transforms: the model's is the arcball's rotation & then
+    // the translation above, kept up to date by the controller, and the light's
+    // is only a rotation
+    CachedTransform modelTransform;
+    CachedTransform lightTransform;
     
     // and the various lighting parameters
     float emissiveLight;
@@ -91,10 +166,6 @@ class RenderParameters
         lightPosition[1] = 0.0;
         lightPosition[2] = 1.0;
         lightPosition[3] = 0.0;
-
-        // because we are paranoid, we will initialise the matrices to the identity
-        rotationMatrix.SetIdentity();
-        lightMatrix.SetIdentity();
         } // constructor
 
     // accessor for scaledXTranslate
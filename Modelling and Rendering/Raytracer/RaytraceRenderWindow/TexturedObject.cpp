@@ -32,6 +32,7 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <limits>
 
 // include the Cartesian 3- vector class
 #include "Cartesian3.h"
@@ -240,6 +241,14 @@ bool TexturedObject::ReadObjectStream(std::istream &geometryStream, std::istream
 
             } // switch on first character
 
+        // a value that >> can't read (some exporters write "nan") leaves the stream failed
+        // but not at eof, so every get() after it would fail too: skip the rest of the line
+        // the value has already been stored, with zero for whatever couldn't be read
+        if (geometryStream.fail() && !geometryStream.eof())
+            { // unreadable value
+            geometryStream.clear();
+            geometryStream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            } // unreadable value
         } // not eof
 
     // compute centre of gravity
@@ -611,4 +620,61 @@ void TexturedObject::RenderRT(RenderParameters *renderParameters, Raytracer* ray
     // if we have texturing enabled, turn texturing back off 
     if (renderParameters->texturedRendering)
         raytracer->Disable(RT_TEXTURE_2D);
-    } // FakeGLRender()
\ No newline at end of file
+    } // FakeGLRender()
+
+// clears the raytracer, sets up lights & view from the parameters, then adds the object
+void TexturedObject::SetUpRaytraceScene(RenderParameters *renderParameters, Raytracer *raytracer)
+    { // SetUpRaytraceScene()
+    raytracer->ClearColor(0.8, 0.8, 0.6, 1.0);
+    raytracer->Clear(RT_COLOR_BUFFER_BIT | RT_DEPTH_BUFFER_BIT);
+    raytracer->LoadIdentity();
+
+    raytracer->Disable(RT_LIGHTING);
+    raytracer->Disable(RT_SHADOWS);
+    raytracer->Disable(RT_IMPULSE_REFLECTION);
+
+    if (renderParameters->shadowsOn) {
+        raytracer->Enable(RT_SHADOWS);
+    }
+
+    if (renderParameters->impulseReflectionOn) {
+        raytracer->Enable(RT_IMPULSE_REFLECTION);
+    }
+
+    // if lighting is turned on
+    if (renderParameters->useLighting)
+    { // use lighting
+        // make sure lighting is on
+        raytracer->Enable(RT_LIGHTING);
+
+        // set light position first, pushing/popping matrix so that it the transformation does
+        // not affect the position of the geometric object
+        raytracer->PushMatrix();
+        raytracer->MultMatrixf(renderParameters->lightTransform.columnMajor.coordinates);
+        raytracer->Light(RT_POSITION, renderParameters->lightPosition);
+        raytracer->PopMatrix();
+
+        // now set the lighting parameters (assuming all light is white)
+        float ambientColour[4];
+        float diffuseColour[4];
+        float specularColour[4];
+
+        // now copy the parameters
+        ambientColour[0]    = ambientColour[1]  = ambientColour[2]  = renderParameters->ambientLight;
+        diffuseColour[0]    = diffuseColour[1]  = diffuseColour[2]  = renderParameters->diffuseLight;
+        specularColour[0]   = specularColour[1] = specularColour[2] = renderParameters->specularLight;
+        ambientColour[3]    = diffuseColour[3]  = specularColour[3] = 1.0; // don't forget alpha
+
+        // and set them in OpenGL
+        raytracer->Light(RT_AMBIENT,    ambientColour);
+        raytracer->Light(RT_DIFFUSE,    diffuseColour);
+        raytracer->Light(RT_SPECULAR,   specularColour);
+    }
+
+    // apply the rotation from the arcball & the visual translation, as one matrix
+    raytracer->MultMatrixf(renderParameters->modelTransform.columnMajor.coordinates);
+
+    if (renderParameters->showObject) {
+        RenderRT(renderParameters, raytracer);
+    }
+    } // SetUpRaytraceScene()
@@ -102,6 +102,10 @@ class TexturedObject
 
     void RenderRT(RenderParameters *renderParameters, Raytracer *raytracer);
 
+    // clears the raytracer, sets up lights & view from the parameters, then adds the object
+    // (tracing is left to the caller)
+    void SetUpRaytraceScene(RenderParameters *renderParameters, Raytracer *raytracer);
+
     }; // class TexturedObject
 
 // end of include guard for TexturedObject
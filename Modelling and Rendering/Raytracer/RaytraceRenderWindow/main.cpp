@@ -12,25 +12,157 @@
 //  
 //  Loads assets, then passes them to the render window. This is very far
 //  from the only way of doing it.
+//
+//  Also provides two headless modes for distributed rendering:
+//      RaytracerWindow --worker [port]
+//      RaytracerWindow --coordinator [--tile n] [--stall seconds]
+//                      geometry texture output.ppm width height host[:port] ...
 //  
 ////////////////////////////////////////////////////////////////////////
 
 // system libraries
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <stdlib.h>
+#include <limits.h>
 
 // QT
 #include <QApplication>
+#include <QCoreApplication>
+#include <QElapsedTimer>
 
 // local includes
 #include "RenderWindow.h"
 #include "TexturedObject.h"
 #include "RenderParameters.h"
 #include "RenderController.h"
+#include "DistributedRender.h"
+
+// runs as a worker, tracing tiles for any coordinator that connects
+static int RunTileWorker(int argc, char **argv)
+    { // RunTileWorker()
+    // no window is needed, so don't ask for a display
+    QCoreApplication workerApp(argc, argv);
+
+    quint16 port = (argc > 2) ? atoi(argv[2]) : TILE_DEFAULT_PORT;
+
+    TileWorkerServer server;
+    if (!server.Listen(port))
+        { // listen failed
+        std::cout << "Could not listen on port " << port << std::endl;
+        return 1;
+        } // listen failed
+
+    std::cout << "Tile worker listening on port " << port << std::endl;
+    return workerApp.exec();
+    } // RunTileWorker()
+
+// renders one final quality frame across a set of workers
+static int RunTileCoordinator(int argc, char **argv)
+    { // RunTileCoordinator()
+    QCoreApplication coordinatorApp(argc, argv);
+
+    // the options come first: the tile size & how long a worker may say nothing
+    int tileSize = 64;
+    int stallSeconds = 60;
+    int arg = 2;
+    while (arg + 1 < argc && (std::string(argv[arg]) == "--tile" || std::string(argv[arg]) == "--stall"))
+        { // per option
+        if (std::string(argv[arg]) == "--tile")
+            tileSize = atoi(argv[arg + 1]);
+        else
+            stallSeconds = atoi(argv[arg + 1]);
+        arg += 2;
+        } // per option
+
+    if (argc - arg < 6 || tileSize <= 0 || stallSeconds <= 0 || stallSeconds > INT_MAX / 1000)
+        { // bad args
+        std::cout << "Usage: " << argv[0] << " --coordinator [--tile n] [--stall seconds] geometry texture output.ppm width height host[:port] ..." << std::endl;
+        return 1;
+        } // bad args
+    char *geometryName = argv[arg];
+    char *textureName = argv[arg + 1];
+    char *outputName = argv[arg + 2];
+    char *widthString = argv[arg + 3];
+    char *heightString = argv[arg + 4];
+    int firstWorker = arg + 5;
+
+    TexturedObject texturedObject;
+    std::ifstream geometryFile(geometryName);
+    std::ifstream textureFile(textureName);
+    if (!(geometryFile.good()) || !(textureFile.good()) || (!texturedObject.ReadObjectStream(geometryFile, textureFile)))
+        { // object read failed
+        std::cout << "Read failed for object " << geometryName << " or texture " << textureName << std::endl;
+        return 1;
+        } // object read failed
+
+    int width = atoi(widthString);
+    int height = atoi(heightString);
+    if (width <= 0 || height <= 0)
+        { // bad size
+        std::cout << "Bad image size " << widthString << "x" << heightString << std::endl;
+        return 1;
+        } // bad size
+
+    // final quality: everything the raytracer can do
+    RenderParameters renderParameters;
+    renderParameters.useLighting = true;
+    renderParameters.texturedRendering = true;
+    renderParameters.shadowsOn = true;
+    renderParameters.impulseReflectionOn = true;
+    renderParameters.renderRT = true;
+    renderParameters.showObject = true;
+    renderParameters.centreObject = true;
+    renderParameters.scaleObject = true;
+
+    // the scene is set up here, then shipped to the workers as it stands
+    Raytracer raytracer;
+    texturedObject.TransferAssetsToRaytracer(&raytracer);
+    raytracer.frameBuffer.Resize(width, height);
+    raytracer.depthBuffer.Resize(width, height);
+    texturedObject.SetUpRaytraceScene(&renderParameters, &raytracer);
+
+    TileCoordinator coordinator(&raytracer);
+    coordinator.stallMilliseconds = stallSeconds * 1000;
+    for (int worker = firstWorker; worker < argc; worker++)
+        { // per worker
+        QString address(argv[worker]);
+        int colon = address.lastIndexOf(':');
+        if (colon < 0)
+            coordinator.AddWorker(address, TILE_DEFAULT_PORT);
+        else
+            coordinator.AddWorker(address.left(colon), address.mid(colon + 1).toUShort());
+        } // per worker
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    bool complete = coordinator.Render(tileSize);
+    qint64 frameMilliseconds = frameTimer.elapsed();
+
+    coordinator.ReportThroughput(std::cout);
+    if (!complete)
+        { // render failed
+        std::cout << "Render incomplete" << std::endl;
+        return 1;
+        } // render failed
+
+    std::cout << "Frame traced in " << frameMilliseconds << " ms" << std::endl;
+
+    std::ofstream outputFile(outputName);
+    raytracer.frameBuffer.WritePPM(outputFile);
+    return 0;
+    } // RunTileCoordinator()
 
 // main routine
 int main(int argc, char **argv)
     { // main()
+    // the distributed modes are headless, so they must start before the GUI does
+    if (argc > 1 && std::string(argv[1]) == "--worker")
+        return RunTileWorker(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--coordinator")
+        return RunTileCoordinator(argc, argv);
+
     // initialize QT
     QApplication renderApp(argc, argv);
 